@@ -8,7 +8,12 @@
 
 #include "btree.h"
 
+#include <algorithm>
 #include <climits>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <vector>
 
 #include "exceptions/bad_index_info_exception.h"
@@ -21,131 +26,451 @@
 #include "exceptions/scan_not_initialized_exception.h"
 #include "filescan.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 //#define DEBUG
 
 namespace badgerdb {
 
+// Number of used slots in a node. Used slots are packed at the front of the
+// key array and EMPTY_KEY sorts after every real key, so a binary search for
+// the first empty slot gives the count.
+static int usedSlots(const NormalizedKey *keyArray, const int occupancy) {
+  return std::lower_bound(keyArray, keyArray + occupancy, EMPTY_KEY) -
+         keyArray;
+}
+
+// Piece of a split non-leaf node whose key range holds the key: 0 for the
+// node itself and i for the sibling at newSiblings[i - 1]. The siblings are
+// in key order.
+static std::size_t coveringPiece(
+    const std::vector<PageKeyPair<NormalizedKey> > &newSiblings,
+    const NormalizedKey key) {
+  std::size_t piece = 0;
+  while (piece < newSiblings.size() && key >= newSiblings[piece].key) {
+    piece++;
+  }
+  return piece;
+}
+
+// True if the range selects a single key.
+static bool isPointRange(const NormalizedRange &range) {
+  return range.lowOp == GTE && range.highOp == LTE && range.low == range.high;
+}
+
+// True if the key lies beyond the high end of the scan range.
+static bool pastHighBound(const NormalizedKey key, const NormalizedKey highKey,
+                          const Operator highOp) {
+  return highOp == LT ? key >= highKey : key > highKey;
+}
+
+// Record id packed into one integer, for use as a map key.
+static std::uint64_t packRid(const RecordId &rid) {
+  return (static_cast<std::uint64_t>(rid.page_number) << 16) | rid.slot_number;
+}
+
+// Number of bits needed to store the value.
+static int bitWidth(std::uint64_t value) {
+  int bits = 0;
+  for (; value != 0; value >>= 1) {
+    bits++;
+  }
+  return bits;
+}
+
+// Store the low bits of the value at the given bit position, least
+// significant bit first. The bits must still be zero.
+static void packBits(std::uint8_t *data, std::size_t bitPos,
+                     std::uint64_t value, int bits) {
+  while (bits > 0) {
+    int shift = bitPos % 8;
+    int take = std::min(8 - shift, bits);
+    data[bitPos / 8] |=
+        static_cast<std::uint8_t>((value & ((1u << take) - 1)) << shift);
+    value >>= take;
+    bitPos += take;
+    bits -= take;
+  }
+}
+
+// Little-endian word at p, whatever the byte order of the host. Compilers
+// turn this into a single load.
+static std::uint64_t loadWord(const std::uint8_t *p) {
+  std::uint64_t word = 0;
+  for (int i = 7; i >= 0; i--) {
+    word = (word << 8) | p[i];
+  }
+  return word;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+// Widest values the AVX2 unpack handles: a value and the shift to its first
+// bit must fit one 32-bit word.
+static const int AVX2UNPACKMAXBITS = 25;
+
+// True if the CPU running this can execute AVX2 code.
+static bool cpuHasAvx2() {
+  static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+  return hasAvx2;
+}
+
+// Store eight unpacked values, adding base to each, as the field type.
+__attribute__((target("avx2"))) static void storeLanes(
+    __m256i values, std::uint64_t base, std::uint64_t *out) {
+  const __m256i wideBase = _mm256_set1_epi64x(base);
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i *>(out),
+      _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(values)),
+                       wideBase));
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i *>(out + 4),
+      _mm256_add_epi64(
+          _mm256_cvtepu32_epi64(_mm256_extracti128_si256(values, 1)),
+          wideBase));
+}
+
+__attribute__((target("avx2"))) static void storeLanes(
+    __m256i values, std::uint64_t base, std::uint32_t *out) {
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i *>(out),
+      _mm256_add_epi32(values,
+                       _mm256_set1_epi32(static_cast<std::uint32_t>(base))));
+}
+
+__attribute__((target("avx2"))) static void storeLanes(
+    __m256i values, std::uint64_t base, std::uint16_t *out) {
+  __m128i narrow = _mm_packus_epi32(_mm256_castsi256_si128(values),
+                                    _mm256_extracti128_si256(values, 1));
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i *>(out),
+      _mm_add_epi16(narrow,
+                    _mm_set1_epi16(static_cast<std::uint16_t>(base))));
+}
+
+// Unpack values eight at a time: each lane gathers the 32-bit word holding
+// its value and shifts it into place. The width must be at most
+// AVX2UNPACKMAXBITS. Returns how many values were unpacked, a multiple of
+// eight; the rest are left to the scalar loop.
+template <class T>
+__attribute__((target("avx2"))) static int unpackBitsAvx2(
+    const std::uint8_t *data, std::size_t bitPos, int bits, int count,
+    std::uint64_t base, T *out) {
+  const __m256i mask = _mm256_set1_epi32((1u << bits) - 1);
+  const __m256i byteBits = _mm256_set1_epi32(7);
+  const __m256i step = _mm256_set1_epi32(8 * bits);
+  __m256i pos = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(bitPos)),
+      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                         _mm256_set1_epi32(bits)));
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i words = _mm256_i32gather_epi32(
+        reinterpret_cast<const int *>(data), _mm256_srli_epi32(pos, 3), 1);
+    __m256i values = _mm256_and_si256(
+        _mm256_srlv_epi32(words, _mm256_and_si256(pos, byteBits)), mask);
+    storeLanes(values, base, out + i);
+    pos = _mm256_add_epi32(pos, step);
+  }
+  return i;
+}
+#endif
+
+// Unpack count values of the given width stored from bitPos on, adding base
+// to each. A value is read with one word load and a shift; only values wider
+// than 56 bits can straddle a ninth byte. On CPUs with AVX2, narrow fields
+// are unpacked eight values at a time first.
+template <class T>
+static void unpackBits(const std::uint8_t *data, std::size_t bitPos, int bits,
+                       int count, std::uint64_t base, T *out) {
+  if (bits == 0) {
+    std::fill(out, out + count, static_cast<T>(base));
+    return;
+  }
+  int i = 0;
+#if defined(__GNUC__) && defined(__x86_64__)
+  if (bits <= AVX2UNPACKMAXBITS && cpuHasAvx2()) {
+    i = unpackBitsAvx2(data, bitPos, bits, count, base, out);
+    bitPos += static_cast<std::size_t>(i) * bits;
+  }
+#endif
+  std::uint64_t mask = bits == 64 ? ~std::uint64_t(0)
+                                  : (std::uint64_t(1) << bits) - 1;
+  for (; i < count; i++, bitPos += bits) {
+    const std::uint8_t *p = data + bitPos / 8;
+    int shift = bitPos % 8;
+    std::uint64_t value = loadWord(p) >> shift;
+    if (shift + bits > 64) {
+      value |= static_cast<std::uint64_t>(p[8]) << (64 - shift);
+    }
+    out[i] = static_cast<T>(base + (value & mask));
+  }
+}
+
+// Write the entries to the page as a compressed leaf. Returns false, leaving
+// the page untouched, if they do not fit.
+static bool encodeLeaf(Page *page, const NormalizedKey *keys,
+                       const RecordId *rids, int count,
+                       PageId rightSibPageNo) {
+  if (count > COMPRESSEDLEAFMAXSIZE) {
+    return false;
+  }
+
+  NormalizedKey baseKey = count > 0 ? keys[0] : 0;
+  PageId basePageNo = count > 0 ? rids[0].page_number : 0;
+  PageId maxPageNo = basePageNo;
+  SlotId maxSlot = 0;
+  for (int i = 0; i < count; i++) {
+    basePageNo = std::min(basePageNo, rids[i].page_number);
+    maxPageNo = std::max(maxPageNo, rids[i].page_number);
+    maxSlot = std::max(maxSlot, rids[i].slot_number);
+  }
+  int keyBits = count > 0 ? bitWidth(keys[count - 1] - baseKey) : 0;
+  int pageBits = bitWidth(maxPageNo - basePageNo);
+  int slotBits = bitWidth(maxSlot);
+
+  std::size_t bytes =
+      (static_cast<std::size_t>(count) * (keyBits + pageBits + slotBits) + 7) /
+      8;
+  if (bytes + 8 > static_cast<std::size_t>(COMPRESSEDLEAFDATASIZE)) {
+    return false;
+  }
+
+  CompressedLeafNodeInt *node = reinterpret_cast<CompressedLeafNodeInt *>(page);
+  node->count = count;
+  node->keyBits = keyBits;
+  node->pageBits = pageBits;
+  node->slotBits = slotBits;
+  node->padding = 0;
+  node->baseKey = baseKey;
+  node->basePageNo = basePageNo;
+  node->rightSibPageNo = rightSibPageNo;
+  std::memset(node->data, 0, bytes + 8);
+
+  std::size_t bitPos = 0;
+  for (int i = 0; i < count; i++, bitPos += keyBits) {
+    packBits(node->data, bitPos, keys[i] - baseKey, keyBits);
+  }
+  for (int i = 0; i < count; i++, bitPos += pageBits) {
+    packBits(node->data, bitPos, rids[i].page_number - basePageNo, pageBits);
+  }
+  for (int i = 0; i < count; i++, bitPos += slotBits) {
+    packBits(node->data, bitPos, rids[i].slot_number, slotBits);
+  }
+  return true;
+}
+
+// Decode a compressed leaf, one field at a time.
+static void decodeLeaf(const Page *page, DecodedLeaf &decoded) {
+  const CompressedLeafNodeInt *node =
+      reinterpret_cast<const CompressedLeafNodeInt *>(page);
+  int count = node->count;
+  decoded.keyArray.resize(count);
+  decoded.ridArray.resize(count);
+  decoded.rightSibPageNo = node->rightSibPageNo;
+  if (count == 0) {
+    return;
+  }
+
+  std::vector<PageId> pages(count);
+  std::vector<SlotId> slots(count);
+  std::size_t bitPos = 0;
+  unpackBits(node->data, bitPos, node->keyBits, count, node->baseKey,
+             &decoded.keyArray[0]);
+  bitPos += static_cast<std::size_t>(count) * node->keyBits;
+  unpackBits(node->data, bitPos, node->pageBits, count, node->basePageNo,
+             &pages[0]);
+  bitPos += static_cast<std::size_t>(count) * node->pageBits;
+  unpackBits(node->data, bitPos, node->slotBits, count, 0, &slots[0]);
+
+  for (int i = 0; i < count; i++) {
+    decoded.ridArray[i].page_number = pages[i];
+    decoded.ridArray[i].slot_number = slots[i];
+    decoded.ridArray[i].padding = 0;
+  }
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
 
 BTreeIndex::BTreeIndex(const std::string &relationName,
                        std::string &outIndexName, BufMgr *bufMgrIn,
-                       const int attrByteOffset, const Datatype attrType) {
+                       const int attrByteOffset, const Datatype attrType,
+                       const BTreeOptions &options) {
   std::ostringstream idxStr;
   idxStr << relationName << '.' << attrByteOffset;
   std::string indexName = idxStr.str();
   outIndexName = indexName;
 
+  // Only the leaves keep the rest of a STRING key, so its entries cannot wait
+  // in a buffer or be packed into a compressed leaf
+  if (attrType == STRING &&
+      (options.deltaBufferCapacity > 0 || options.useMessageBuffers ||
+       options.compressLeaves)) {
+    throw BadIndexInfoException(outIndexName);
+  }
+
   this->bufMgr = bufMgrIn;
   this->attributeType = attrType;
   this->attrByteOffset = attrByteOffset;
-  this->leafOccupancy = badgerdb::INTARRAYLEAFSIZE;
+  this->leafOccupancy = attrType == STRING ? badgerdb::STRINGARRAYLEAFSIZE
+                                           : badgerdb::INTARRAYLEAFSIZE;
   this->nodeOccupancy = badgerdb::INTARRAYNONLEAFSIZE;
+  this->useLeafFilters = options.useLeafFilters;
+  this->swizzleChildren = options.swizzleChildren;
+  this->rootFrame = NOFRAME;
+  this->deltaBufferCapacity = options.deltaBufferCapacity;
+  this->deltaPos = this->deltaBuffer.end();
+  this->scanDelta = &this->deltaBuffer;
+  this->learnedMaxError = options.learnedLayerMaxError;
+  this->learnedMaxObserved = 0;
+  this->learnedMeanError = 0.0;
+  this->learnedPredictions = 0;
+  this->learnedFallbacks = 0;
+  this->treeExhausted = false;
+  this->leafInsertDeferred = false;
+  this->deltaLogName = indexName + ".delta";
+  std::memset(this->insertSuffix, 0, sizeof(this->insertSuffix));
 
   // Scanning related memebers
   scanExecuting = false;
+  this->scanGeneration = 0;
   this->nextEntry = INT_MAX;
 
-  this->currentPageNum = Page::INVALID_NUMBER;
-  this->currentPageData = nullptr;
+  this->currentLeaf.used = 0;
   this->lowValInt = 0;
   this->lowValDouble = 0.0;
   this->lowValString = "";
   this->highValInt = 0;
   this->highValDouble = 0.0;
   this->highValString = "";
+  this->lowValKey = 0;
+  this->highValKey = 0;
   this->lowOp = badgerdb::Operator::LTE;
   this->highOp = badgerdb::Operator::GTE;
-  std::cout << "start constructor" << std::endl;
+  this->currentRange = 0;
+  this->currentFenceKey = 0;
 
   try {
-    File *file = new BlobFile(outIndexName, false);
-
-    this->file = file;
+    this->file = new BlobFile(outIndexName, false);
     this->headerPageNum = file->getFirstPageNo();
 
     // Read the first page which contains the meta info
-    badgerdb::Page *metaPage;  // headerpage
-    this->bufMgr->readPage(file, this->headerPageNum, metaPage);
-    badgerdb::IndexMetaInfo *meta = reinterpret_cast<IndexMetaInfo *>(metaPage);
+    PageGuard metaPage = this->bufMgr->fetchPage(file, this->headerPageNum);
+    badgerdb::IndexMetaInfo *meta =
+        reinterpret_cast<IndexMetaInfo *>(metaPage.get());
+
+    // Keys are stored normalized for their type, so the existing index is
+    // only usable if it was built over the same attribute.
+    bool matches =
+        strncmp(meta->relationName, relationName.c_str(),
+                sizeof(meta->relationName) - 1) == 0 &&
+        meta->attrByteOffset == attrByteOffset && meta->attrType == attrType;
 
-    // Read root page number from the head (second page)
     this->rootPageNum = meta->rootPageNo;
+    this->ifRootIsLeaf = meta->ifRootIsLeaf;
+    this->useMessageBuffers = meta->messageBuffers;
+    if (this->useMessageBuffers) {
+      this->nodeOccupancy = badgerdb::BUFFEREDNONLEAFSIZE;
+    }
+    this->compressedLeaves = meta->compressedLeaves;
     // Unpin the page after reading
-    this->bufMgr->unPinPage(file, this->headerPageNum, false);
-    std::cout << "start constructor 2" << std::endl;
-  } catch (const badgerdb::FileNotFoundException &e) {
-    // build the index
-    File *file = new BlobFile(outIndexName, true);
-    this->file = file;
+    metaPage.release();
 
-    PageId headPageNum;
-    PageId rootPageNum;
-    Page *headPage;
-    Page *rootPage;
+    if (!matches) {
+      delete this->file;
+      throw BadIndexInfoException(outIndexName);
+    }
+
+    // The leaf filters are not stored in the file
+    if (this->useLeafFilters) {
+      buildLeafFilters();
+    }
 
-    this->bufMgr->allocPage(file, headPageNum, headPage);
-    this->bufMgr->allocPage(file, rootPageNum, rootPage);
+    // Entries buffered when the index was last open may not have reached
+    // the tree
+    replayDeltaLog();
+  } catch (const badgerdb::FileNotFoundException &e) {
+    // build the index
+    this->file = new BlobFile(outIndexName, true);
 
-    this->headerPageNum = headPageNum;
+    WritePageGuard headPage = this->bufMgr->newPage(file, this->headerPageNum);
+    WritePageGuard rootPage = this->bufMgr->newPage(file, this->rootPageNum);
 
     badgerdb::IndexMetaInfo *metaInfo =
-        reinterpret_cast<IndexMetaInfo *>(&headPage);
+        reinterpret_cast<IndexMetaInfo *>(headPage.get());
 
-    strcpy(metaInfo->relationName, relationName.c_str());
+    strncpy(metaInfo->relationName, relationName.c_str(),
+            sizeof(metaInfo->relationName) - 1);
+    metaInfo->relationName[sizeof(metaInfo->relationName) - 1] = '\0';
     metaInfo->attrByteOffset = attrByteOffset;
     metaInfo->attrType = attrType;
-    metaInfo->rootPageNo = rootPageNum;
+    metaInfo->rootPageNo = this->rootPageNum;
+    metaInfo->ifRootIsLeaf = true;
+    metaInfo->messageBuffers = options.useMessageBuffers;
+    this->useMessageBuffers = options.useMessageBuffers;
+    if (this->useMessageBuffers) {
+      this->nodeOccupancy = badgerdb::BUFFEREDNONLEAFSIZE;
+    }
+    metaInfo->compressedLeaves = options.compressLeaves;
+    this->compressedLeaves = options.compressLeaves;
+
+    headPage.release();
+
+    // Root node starts as an empty leaf node
+    if (this->compressedLeaves) {
+      encodeLeaf(rootPage.get(), NULL, NULL, 0, Page::INVALID_NUMBER);
+    } else {
+      NormalizedKey *keyArray;
+      RecordId *ridArray;
+      char *suffixArray;
+      PageId *rightSibPageNo;
+      leafArrays(rootPage.get(), keyArray, ridArray, suffixArray,
+                 rightSibPageNo);
+      std::fill(keyArray, keyArray + this->leafOccupancy, EMPTY_KEY);
+      *rightSibPageNo = Page::INVALID_NUMBER;
+    }
+    this->ifRootIsLeaf = true;
+    if (this->useLeafFilters) {
+      buildLeafFilter(this->rootPageNum, NULL, 0);
+    }
 
-    this->bufMgr->unPinPage(this->file, headPageNum, true);
+    rootPage.release();
 
     // Insert and start to build the index
     // Scan the relation
-    FileScan *scanner = new FileScan(relationName, this->bufMgr);
-    std::cout << "start constructor3" << std::endl;
+    FileScan scanner(relationName, this->bufMgr);
     try {
-      // Read a record from the relation
-      RecordId rid;
-      scanner->scanNext(rid);
-
-      std::string recordStr = scanner->getRecord();
-      const char *record = recordStr.c_str();
-      int key = *((int *)(record + attrByteOffset));
-
-      // Root node starts as a leaf node
-      badgerdb::LeafNodeInt *rootNode =
-          reinterpret_cast<LeafNodeInt *>(&rootPage);
-      this->ifRootIsLeaf = true;
-      // initialzie the key and rid array
-      size_t len = sizeof(rootNode->keyArray) / sizeof(rootNode->keyArray[0]);
-      for (size_t i = 0; i < len; i++) {
-        rootNode->keyArray[i] = INT_MAX;
-      }
-
-      // Assign key and rid for root
-      rootNode->keyArray[0] = key;
-      rootNode->ridArray[0] = rid;
-      rootNode->rightSibPageNo = Page::INVALID_NUMBER;
-
-      this->bufMgr->unPinPage(this->file, rootPageNum, true);
-      this->bufMgr->flushFile(this->file);
-
       // THIS IS DANGEROUS, We Can do it only becuase scanner will
       // throw EndOfFileException when we reached the end of
       // the relation file
-      std::cout << "before insert" << std::endl;
+      RecordId rid;
       while (1) {
-        scanner->scanNext(rid);
-        recordStr = scanner->getRecord();
-        const char *recordChar = recordStr.c_str();
-        int key = *((int *)(recordChar + attrByteOffset));
-        this->insertEntry(&key, rid);
+        scanner.scanNext(rid);
+        std::string recordStr = scanner.getRecord();
+        this->insertEntry(recordStr.c_str() + attrByteOffset, rid);
       }
-      std::cout << "after insert" << std::endl;
     } catch (const EndOfFileException &e) {
       // Finish inserting all the records
     }
+
+    // A log left behind by an earlier index of the same name is stale, and
+    // the entries buffered during the build are in the relation already
+    std::remove(this->deltaLogName.c_str());
+    if (!this->deltaBuffer.empty()) {
+      drainDeltaBuffer();
+    }
+  }
+
+  if (this->deltaBufferCapacity > 0 && options.logDeltaBuffer) {
+    this->deltaLog.open(this->deltaLogName.c_str(),
+                        std::ios::out | std::ios::binary | std::ios::trunc);
+  }
+
+  if (options.useLearnedLayer) {
+    trainLearnedLayer();
   }
 }
 
@@ -154,11 +479,26 @@ BTreeIndex::BTreeIndex(const std::string &relationName,
 // -----------------------------------------------------------------------------
 
 BTreeIndex::~BTreeIndex() {
-  if (scanExecuting) {
-    endScan();
+  try {
+    if (scanExecuting) {
+      endScan();
+    }
+    this->currentPage.release();
+    if (!this->deltaBuffer.empty()) {
+      drainDeltaBuffer();
+    }
+    this->bufMgr->flushFile(this->file);
+  } catch (const BadgerDbException &e) {
+    // Destructor must not throw
   }
-  // !!! Need all other pages closed
-  this->bufMgr->flushFile(this->file);
+  // Every buffered entry is in the tree now, unless the drain failed
+  if (this->deltaLog.is_open()) {
+    this->deltaLog.close();
+    if (this->deltaBuffer.empty()) {
+      std::remove(this->deltaLogName.c_str());
+    }
+  }
+  delete this->file;
 }
 
 // -----------------------------------------------------------------------------
@@ -166,431 +506,1780 @@ BTreeIndex::~BTreeIndex() {
 // -----------------------------------------------------------------------------
 
 void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
-  const int *constIntKey = static_cast<const int *>(key);
-  int intKey = *const_cast<int *>(constIntKey);
-
-  RIDKeyPair<int> entry;
-  entry.set(rid, intKey);
-  PageKeyPair<int> *childEntry;
+  RIDKeyPair<NormalizedKey> entry;
+  entry.set(rid, normalizeKey(key, this->attributeType));
+  if (this->attributeType == STRING) {
+    const char *str = static_cast<const char *>(key);
+    std::size_t length = strnlen(str, STRINGKEYSIZE);
+    std::memset(this->insertSuffix, 0, sizeof(this->insertSuffix));
+    if (length > static_cast<std::size_t>(STRINGPREFIXSIZE)) {
+      std::memcpy(this->insertSuffix, str + STRINGPREFIXSIZE,
+                  length - STRINGPREFIXSIZE);
+    }
+  }
 
-  // Read the root page
-  Page *rootNode;
-  this->bufMgr->readPage(this->file, this->rootPageNum, rootNode);
+  if (this->deltaBufferCapacity > 0) {
+    bufferEntry(entry);
+    return;
+  }
 
-  if (this->ifRootIsLeaf) {
-    insertHelper(rootNode, entry, childEntry, 0, true);
-  } else {
-    insertHelper(rootNode, entry, childEntry, 1, true);
+  BufferMessage message;
+  message.set(INSERT_MESSAGE, entry.rid, entry.key);
+  applyMessage(message);
+  // Buffered messages are meant to collect in nodes that stay in the pool;
+  // the destructor writes them out
+  if (!this->useMessageBuffers) {
+    this->bufMgr->flushFile(this->file);
   }
-  this->bufMgr->unPinPage(this->file, this->rootPageNum, true);
-  this->bufMgr->flushFile(this->file);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertHelper()
+// BTreeIndex::deleteEntry
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::insertHelper(Page *pagePointer, RIDKeyPair<int> entry,
-                              PageKeyPair<int> *childEntry, int pageLevel,
-                              bool isRoot) {
-  if (pageLevel > 0) {  // non-leaf node
-    NonLeafNodeInt *node = (NonLeafNodeInt *)pagePointer;
-    int index = 0;
-    for (int i = 0; i < this->nodeOccupancy - 1; i++) {
-      if (entry.key < node->keyArray[i]) {
-        index = 0;
-      } else if (entry.key >= node->keyArray[i] &&
-                 entry.key < node->keyArray[i + 1]) {
-        index = i;
+void BTreeIndex::deleteEntry(const void *key, const RecordId rid) {
+  BufferMessage message;
+  message.set(DELETE_MESSAGE, rid, normalizeKey(key, this->attributeType));
+
+  // An entry still in the delta buffer has not reached the tree
+  std::pair<std::multimap<NormalizedKey, RecordId>::iterator,
+            std::multimap<NormalizedKey, RecordId>::iterator>
+      buffered = this->deltaBuffer.equal_range(message.key);
+  for (std::multimap<NormalizedKey, RecordId>::iterator it = buffered.first;
+       it != buffered.second; ++it) {
+    if (it->second == rid) {
+      if (scanExecuting && this->scanDelta == &this->deltaBuffer &&
+          this->deltaPos == it) {
+        ++this->deltaPos;
       }
+      this->deltaBuffer.erase(it);
+      logMessage(message);
+      return;
     }
-    if (index == 0 && entry.key >= node->keyArray[this->nodeOccupancy - 1]) {
-      index = this->nodeOccupancy;
-    }
-    Page *child;
-    this->bufMgr->readPage(file, node->keyArray[index], child);
-    insertHelper(child, entry, childEntry, node->level - 1, false);
-    this->bufMgr->unPinPage(file, node->keyArray[index], true);
+  }
 
-    if (childEntry == nullptr) {
-      return;
-    } else {
-      if (node->keyArray[this->nodeOccupancy - 1] == INT_MAX) {  // space left
-        // simply insert
-        int insertIndex = this->nodeOccupancy - 1;
-        while (insertIndex > 0 &&
-               node->keyArray[insertIndex - 1] > childEntry->key) {
-          node->keyArray[insertIndex] = node->keyArray[insertIndex - 1];
-          node->pageNoArray[insertIndex + 1] = node->pageNoArray[insertIndex];
-          insertIndex--;
-        }
-        node->keyArray[insertIndex] = childEntry->key;
-        node->pageNoArray[insertIndex + 1] = node->pageNoArray[insertIndex];
-        node->pageNoArray[insertIndex] = childEntry->pageNo;
-        childEntry = nullptr;
-      } else {  // no space left, need to split
-        int leftSize = (this->nodeOccupancy + 1) / 2;
-        int rightSize = this->nodeOccupancy + 1 - leftSize;
-
-        PageId newPID;
-        Page *newPage;
-        this->bufMgr->allocPage(this->file, newPID, newPage);
-        badgerdb::NonLeafNodeInt *newNode =
-            reinterpret_cast<NonLeafNodeInt *>(newPage);
-
-        // NonLeafNodeInt *newNode =
-        // (NonLeafNodeInt *)malloc(sizeof(NonLeafNodeInt));
-        if (node->keyArray[leftSize - 1] >
-            childEntry->key) {  // child key belongs to left
-          for (int i = 0; i < rightSize; i++) {
-            newNode->keyArray[i] = node->keyArray[leftSize - 1 + i];
-            newNode->pageNoArray[i] = node->pageNoArray[leftSize - 1 + i];
-          }
-          newNode->pageNoArray[rightSize] =
-              node->pageNoArray[this->nodeOccupancy];
-          for (int i = this->nodeOccupancy - 1; i >= leftSize - 1; i--) {
-            node->keyArray[i] = INT_MAX;
-            node->pageNoArray[i] = Page::INVALID_NUMBER;
-          }
-          node->pageNoArray[this->nodeOccupancy] = Page::INVALID_NUMBER;
-          int insertIndex = leftSize - 1;
-          while (insertIndex > 0 &&
-                 node->keyArray[insertIndex - 1] > childEntry->key) {
-            node->keyArray[insertIndex] = node->keyArray[insertIndex - 1];
-            node->pageNoArray[insertIndex] = node->pageNoArray[insertIndex - 1];
-            insertIndex--;
-          }
-          node->keyArray[insertIndex] = childEntry->key;
-          node->pageNoArray[insertIndex] = childEntry->pageNo;
-        } else {  // child key belongs to right;
+  applyMessage(message);
+  // Buffered messages are meant to collect in nodes that stay in the pool;
+  // the destructor writes them out
+  if (!this->useMessageBuffers) {
+    this->bufMgr->flushFile(this->file);
+  }
+}
 
-          for (int i = 0; i < rightSize - 1; i++) {  // left one space for child
-            newNode->keyArray[i] = node->keyArray[leftSize + i];
-            newNode->pageNoArray[i] = node->pageNoArray[leftSize + i];
-          }
-          newNode->pageNoArray[rightSize - 1] =
-              node->pageNoArray[this->nodeOccupancy];
-          for (int i = this->nodeOccupancy - 1; i > leftSize - 1; i--) {
-            node->keyArray[i] = INT_MAX;
-            node->pageNoArray[i] = Page::INVALID_NUMBER;
-          }
-          node->pageNoArray[this->nodeOccupancy] = Page::INVALID_NUMBER;
-          int insertIndex = rightSize - 1;
-          while (insertIndex > 0 &&
-                 node->keyArray[insertIndex - 1] > childEntry->key) {
-            newNode->keyArray[insertIndex] = newNode->keyArray[insertIndex - 1];
-            newNode->pageNoArray[insertIndex] =
-                newNode->pageNoArray[insertIndex - 1];
-            insertIndex--;
-          }
-          newNode->keyArray[insertIndex] = childEntry->key;
-          newNode->pageNoArray[insertIndex] =
-              newNode->pageNoArray[insertIndex - 1];
-          newNode->pageNoArray[insertIndex] = childEntry->pageNo;
-        }
-        childEntry->set(newNode->pageNoArray[0], newNode->keyArray[0]);
-        newNode->level = node->level;
-        // set to default
-        for (int i = rightSize; i < this->nodeOccupancy; i++) {
-          newNode->keyArray[i] = INT_MAX;
-          newNode->pageNoArray[i + 1] = Page::INVALID_NUMBER;
-        }
+// -----------------------------------------------------------------------------
+// BTreeIndex::applyMessage()
+// -----------------------------------------------------------------------------
 
-        if (isRoot) {
-          PageId rootPID;
-          Page *newRootPage;
-          this->bufMgr->allocPage(this->file, rootPID, newRootPage);
-          badgerdb::NonLeafNodeInt *newRootNode =
-              reinterpret_cast<NonLeafNodeInt *>(newRootPage);
-
-          newRootNode->pageNoArray[0] = node->pageNoArray[0];
-          newRootNode->pageNoArray[1] = childEntry->pageNo;
-          newRootNode->keyArray[0] = childEntry->key;
-          newRootNode->level = node->level + 1;
-          this->rootPageNum = rootPID;
-          this->ifRootIsLeaf = false;
-          badgerdb::Page *metaPage;  // headerpage
-          this->bufMgr->readPage(file, this->headerPageNum, metaPage);
-          badgerdb::IndexMetaInfo *meta =
-              reinterpret_cast<IndexMetaInfo *>(metaPage);
-
-          meta->ifRootIsLeaf = false;
-          // Unpin the page after reading
-          this->bufMgr->unPinPage(file, this->headerPageNum, true);
-          return;
+void BTreeIndex::applyMessage(const BufferMessage &message) {
+  // A full compressed leaf splits before it takes an insert, which then
+  // descends again
+  do {
+    this->leafInsertDeferred = false;
+    PageKeyPair<NormalizedKey> childEntry;
+    bool split;
+    if (this->ifRootIsLeaf) {
+      split = applyToLeaf(this->rootPageNum, message, childEntry);
+    } else if (this->useMessageBuffers) {
+      std::vector<PageKeyPair<NormalizedKey> > newSiblings;
+      pushMessage(this->rootPageNum, message, newSiblings);
+      // A root that split more than once keeps growing until one node covers
+      // all of its pieces
+      while (!newSiblings.empty()) {
+        growRoot(newSiblings[0]);
+        std::vector<PageKeyPair<NormalizedKey> > rootSiblings;
+        WritePageGuard rootPage =
+            this->bufMgr->fetchPageForWrite(this->file, this->rootPageNum);
+        for (std::size_t i = 1; i < newSiblings.size(); i++) {
+          insertSeparator(rootPage.get(), newSiblings[i], rootSiblings);
         }
-
-        this->bufMgr->unPinPage(this->file, newPID, newPage);
+        newSiblings.swap(rootSiblings);
       }
+      split = false;
+    } else if (message.op == INSERT_MESSAGE) {
+      RIDKeyPair<NormalizedKey> entry;
+      entry.set(message.rid, message.key);
+      split = insertHelper(this->rootPageNum, fetchRoot(), false, entry,
+                           childEntry);
+    } else {
+      RIDKeyPair<NormalizedKey> entry;
+      entry.set(message.rid, message.key);
+      removeEntry(entry);
+      split = false;
     }
 
-  } else {  // leaf node
-    badgerdb::LeafNodeInt *node = reinterpret_cast<LeafNodeInt *>(pagePointer);
+    if (split) {
+      growRoot(childEntry);
+    }
+  } while (this->leafInsertDeferred);
+}
 
-    if (node->keyArray[this->leafOccupancy - 1] == INT_MAX) {  // space left
-      int insertIndex = this->leafOccupancy - 1;
-      while (insertIndex > 0 &&
-             node->keyArray[insertIndex - 1] > childEntry->key) {
-        node->keyArray[insertIndex] = node->keyArray[insertIndex - 1];
-        node->ridArray[insertIndex] = node->ridArray[insertIndex - 1];
-        insertIndex--;
-      }
-      node->keyArray[insertIndex] = entry.key;
-      node->ridArray[insertIndex] = entry.rid;
-      childEntry = nullptr;
-      return;
-    } else {  // need to split
-      int leftSize = (this->leafOccupancy + 1) / 2;
-      int rightSize = this->leafOccupancy + 1 - leftSize;
-
-      PageId newPID;
-      Page *newPage;
-      this->bufMgr->allocPage(this->file, newPID, newPage);
-      badgerdb::LeafNodeInt *newNode = reinterpret_cast<LeafNodeInt *>(newPage);
-
-      if (node->keyArray[leftSize - 1] > entry.key) {  // key belongs to left
-        for (int i = 0; i < rightSize; i++) {
-          newNode->keyArray[i] = node->keyArray[leftSize - 1 + i];
-          newNode->ridArray[i] = node->ridArray[leftSize - 1 + i];
-        }
-        for (int i = this->leafOccupancy - 1; i >= leftSize - 1; i--) {
-          node->keyArray[i] = INT_MAX;
-          // We can leave the RID array uninitialized, just use key array to
-          // check if that slot is valid node->ridArray[i] = nullptr;
-        }
-        int insertIndex = leftSize - 1;
-        while (insertIndex > 0 && node->keyArray[insertIndex - 1] > entry.key) {
-          node->keyArray[insertIndex] = node->keyArray[insertIndex - 1];
-          node->ridArray[insertIndex] = node->ridArray[insertIndex - 1];
-          insertIndex--;
-        }
-        node->keyArray[insertIndex] = entry.key;
-        node->ridArray[insertIndex] = entry.rid;
-      } else {  // child key belongs to right;
+// -----------------------------------------------------------------------------
+// BTreeIndex::applyToLeaf()
+// -----------------------------------------------------------------------------
 
-        for (int i = 0; i < rightSize - 1; i++) {  // left one space for child
-          newNode->keyArray[i] = node->keyArray[leftSize + i];
-          newNode->ridArray[i] = node->ridArray[leftSize + i];
-        }
+bool BTreeIndex::applyToLeaf(PageId pageNo, const BufferMessage &message,
+                             PageKeyPair<NormalizedKey> &childEntry) {
+  RIDKeyPair<NormalizedKey> entry;
+  entry.set(message.rid, message.key);
+  if (message.op == INSERT_MESSAGE) {
+    return insertHelper(pageNo, this->bufMgr->fetchPage(this->file, pageNo),
+                        true, entry, childEntry);
+  }
+  removeEntry(entry);
+  return false;
+}
 
-        for (int i = this->leafOccupancy - 1; i > leftSize - 1; i--) {
-          node->keyArray[i] = INT_MAX;
-          // node->ridArray[i] = nullptr;
-        }
-        int insertIndex = rightSize - 1;
-        while (insertIndex > 0 && node->keyArray[insertIndex - 1] > entry.key) {
-          newNode->keyArray[insertIndex] = newNode->keyArray[insertIndex - 1];
-          newNode->ridArray[insertIndex] = newNode->ridArray[insertIndex - 1];
-          insertIndex--;
+// -----------------------------------------------------------------------------
+// BTreeIndex::removeEntry()
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::removeEntry(const RIDKeyPair<NormalizedKey> &entry) {
+  PageId pageNo = this->rootPageNum;
+  PageGuard leafPage;
+  if (!this->ifRootIsLeaf) {
+    std::vector<PageId> path;
+    NormalizedKey fence = EMPTY_KEY;
+    leafPage = search(pageNo, entry.key, path, fence);
+  }
+
+  while (pageNo != Page::INVALID_NUMBER) {
+    // The first leaf is pinned by the descent
+    PageGuard page = std::move(leafPage);
+    if (!page) {
+      page = this->bufMgr->fetchPage(this->file, pageNo);
+    }
+    if (this->compressedLeaves) {
+      DecodedLeaf leaf;
+      decodeLeaf(page.get(), leaf);
+      int used = leaf.keyArray.size();
+      int pos = std::lower_bound(leaf.keyArray.begin(), leaf.keyArray.end(),
+                                 entry.key) -
+                leaf.keyArray.begin();
+      for (; pos < used && leaf.keyArray[pos] == entry.key; pos++) {
+        if (leaf.ridArray[pos] == entry.rid) {
+          // A subset of the entries always fits
+          leaf.keyArray.erase(leaf.keyArray.begin() + pos);
+          leaf.ridArray.erase(leaf.ridArray.begin() + pos);
+          encodeLeaf(page.get(), leaf.keyArray.data(), leaf.ridArray.data(),
+                     used - 1, leaf.rightSibPageNo);
+          page.markDirty();
+          invalidateLearnedLeaf(pageNo);
+          return true;
         }
-        node->keyArray[insertIndex] = entry.key;
-        node->ridArray[insertIndex] = entry.rid;
       }
-      /// TODO: Leaf node has no pageNoArray
-      childEntry->set(newNode->keyArray[0], newPID);
-      // set to default
-      for (int i = rightSize; i < this->leafOccupancy; i++) {
-        newNode->keyArray[i] = INT_MAX;
-        // newNode->ridArray[i + 1] = nullptr;
+      if (pos < used) {
+        return false;
       }
-      newNode->rightSibPageNo = node->rightSibPageNo;
-      node->rightSibPageNo = newPID;
-      this->bufMgr->unPinPage(this->file, newPID, true);
-      return;
+      pageNo = leaf.rightSibPageNo;
+      continue;
+    }
+
+    NormalizedKey *keyArray;
+    RecordId *ridArray;
+    char *suffixArray;
+    PageId *rightSibPageNo;
+    leafArrays(page.get(), keyArray, ridArray, suffixArray, rightSibPageNo);
+    int used = usedSlots(keyArray, this->leafOccupancy);
+    int pos =
+        std::lower_bound(keyArray, keyArray + used, entry.key) - keyArray;
+
+    for (; pos < used && keyArray[pos] == entry.key; pos++) {
+      if (ridArray[pos] == entry.rid) {
+        // Close the gap. The leaf filter keeps the key, which only costs a
+        // false positive.
+        std::copy(keyArray + pos + 1, keyArray + used, keyArray + pos);
+        std::copy(ridArray + pos + 1, ridArray + used, ridArray + pos);
+        if (suffixArray != NULL) {
+          std::memmove(suffixArray + pos * STRINGSUFFIXSIZE,
+                       suffixArray + (pos + 1) * STRINGSUFFIXSIZE,
+                       (used - pos - 1) * STRINGSUFFIXSIZE);
+        }
+        keyArray[used - 1] = EMPTY_KEY;
+        page.markDirty();
+        invalidateLearnedLeaf(pageNo);
+        return true;
+      }
+    }
+
+    PageId nextPageNo = *rightSibPageNo;
+    if (pos < used) {
+      // Passed the last copy of the key
+      return false;
     }
+    pageNo = nextPageNo;
   }
+  return false;
 }
 
-void BTreeIndex::search(PageId &foundPageID, PageId currPageId, const void *key,
-                        std::vector<PageId> &path) {
-  Page *currPage;
-  this->bufMgr->readPage(file, currPageId, currPage);
-  NonLeafNodeInt *currNode = (NonLeafNodeInt *)currPage;
-
-  int idx = 0;
-  int keyC = *(int *)key;
+// -----------------------------------------------------------------------------
+// BTreeIndex::pushMessage()
+// -----------------------------------------------------------------------------
 
-  // while (idx < currNode->numOfKey && currNode->keyArray[idx] <= keyC) {
-  //   idx++;
-  // }
+bool BTreeIndex::pushMessage(
+    PageId pageNo, const BufferMessage &message,
+    std::vector<PageKeyPair<NormalizedKey> > &newSiblings) {
+  WritePageGuard page = this->bufMgr->fetchPageForWrite(this->file, pageNo);
+  BufferedNonLeafNodeInt *node =
+      reinterpret_cast<BufferedNonLeafNodeInt *>(page.get());
 
-  for (int i = 0; i < this->nodeOccupancy; i++) {
-    if (currNode->keyArray[i] > keyC) {
-      idx = i;
-      break;
-    }
+  if (node->messageCount == MESSAGEBUFFERSIZE) {
+    flushMessages(page.get(), newSiblings);
   }
 
-  if (currNode->level == 1) {
-    foundPageID = currNode->pageNoArray[idx];
-    path.push_back(currPageId);
+  // The message belongs to whichever piece of the node covers its key now
+  std::size_t piece = coveringPiece(newSiblings, message.key);
+  if (piece > 0) {
+    WritePageGuard sibPage = this->bufMgr->fetchPageForWrite(
+        this->file, newSiblings[piece - 1].pageNo);
+    BufferedNonLeafNodeInt *sibNode =
+        reinterpret_cast<BufferedNonLeafNodeInt *>(sibPage.get());
+    sibNode->messages[sibNode->messageCount++] = message;
   } else {
-    path.push_back(currPageId);
-    search(foundPageID, currNode->pageNoArray[idx], key, path);
+    node->messages[node->messageCount++] = message;
   }
+  return !newSiblings.empty();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeIndex::flushMessages()
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::startScan(const void *lowValParm, const Operator lowOpParm,
-                           const void *highValParm, const Operator highOpParm) {
-  
-  if (highOpParm != LT && highOpParm != LTE) {
-    throw BadOpcodesException();
+bool BTreeIndex::flushMessages(
+    Page *page, std::vector<PageKeyPair<NormalizedKey> > &newSiblings) {
+  BufferedNonLeafNodeInt *node =
+      reinterpret_cast<BufferedNonLeafNodeInt *>(page);
+  const bool leafChildren = node->level == 1;
+
+  // Pick the child with the most pending messages
+  int used = usedSlots(node->keyArray, this->nodeOccupancy);
+  std::vector<int> childOf(node->messageCount);
+  std::vector<int> counts(used + 1, 0);
+  for (int i = 0; i < node->messageCount; i++) {
+    childOf[i] = std::upper_bound(node->keyArray, node->keyArray + used,
+                                  node->messages[i].key) -
+                 node->keyArray;
+    counts[childOf[i]]++;
   }
-  
-  if (lowOpParm != GT && lowOpParm != GTE) {
-    throw BadOpcodesException();
+  int target = std::max_element(counts.begin(), counts.end()) - counts.begin();
+
+  // Take its messages out of the buffer, keeping arrival order. None of them
+  // comes back, so the buffer has a free slot afterwards, in whichever piece
+  // of the node a key falls into.
+  std::vector<BufferMessage> batch;
+  batch.reserve(counts[target]);
+  int kept = 0;
+  for (int i = 0; i < node->messageCount; i++) {
+    if (childOf[i] == target) {
+      batch.push_back(node->messages[i]);
+    } else {
+      node->messages[kept++] = node->messages[i];
+    }
   }
+  node->messageCount = kept;
+
+  std::size_t next = 0;
+  while (next < batch.size()) {
+    const BufferMessage &message = batch[next];
+
+    // Route the message again: the child, or this node, may have split
+    std::size_t piece = coveringPiece(newSiblings, message.key);
+    WritePageGuard sibPage;
+    BufferedNonLeafNodeInt *pieceNode = node;
+    if (piece > 0) {
+      sibPage = this->bufMgr->fetchPageForWrite(
+          this->file, newSiblings[piece - 1].pageNo);
+      pieceNode = reinterpret_cast<BufferedNonLeafNodeInt *>(sibPage.get());
+    }
+    used = usedSlots(pieceNode->keyArray, this->nodeOccupancy);
+    int idx = std::upper_bound(pieceNode->keyArray,
+                               pieceNode->keyArray + used, message.key) -
+              pieceNode->keyArray;
+    PageId childPageNo = pieceNode->pageNoArray[idx];
+    sibPage.release();
+
+    std::vector<PageKeyPair<NormalizedKey> > childSiblings;
+    if (leafChildren) {
+      PageKeyPair<NormalizedKey> leafEntry;
+      if (applyToLeaf(childPageNo, message, leafEntry)) {
+        childSiblings.push_back(leafEntry);
+      }
+    } else {
+      pushMessage(childPageNo, message, childSiblings);
+    }
 
-  if (!scanExecuting) {
-    endScan();
+    // A compressed leaf that split instead of taking the message gets it
+    // again once the split is recorded
+    bool retry = this->leafInsertDeferred;
+    this->leafInsertDeferred = false;
+    for (std::size_t i = 0; i < childSiblings.size(); i++) {
+      insertSeparator(page, childSiblings[i], newSiblings);
+    }
+    if (!retry) {
+      next++;
+    }
   }
+  return !newSiblings.empty();
+}
 
-  // initilizing fields
-  lowValInt = *((int *)lowValParm);
-  highValInt = *((int *)highValParm);
-  lowOp = lowOpParm;
-  highOp = highOpParm;
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertSeparator()
+// -----------------------------------------------------------------------------
 
-  if (highValInt < lowValInt) {
-    throw BadScanrangeException();
+void BTreeIndex::insertSeparator(
+    Page *page, const PageKeyPair<NormalizedKey> &entry,
+    std::vector<PageKeyPair<NormalizedKey> > &newSiblings) {
+  std::size_t piece = coveringPiece(newSiblings, entry.key);
+  PageKeyPair<NormalizedKey> splitEntry;
+  bool split;
+  if (piece > 0) {
+    WritePageGuard sibPage = this->bufMgr->fetchPageForWrite(
+        this->file, newSiblings[piece - 1].pageNo);
+    split = insertNonLeaf(sibPage.get(), entry, splitEntry);
+  } else {
+    split = insertNonLeaf(page, entry, splitEntry);
   }
 
-  PageId fid;
-  std::vector<PageId> path;
-
-  if (this->ifRootIsLeaf) {
-    fid = rootPageNum;
-  } else {
-    search(fid, rootPageNum, lowValParm, path);
+  // The new piece starts inside the one that split, so the separators stay
+  // in order
+  if (split) {
+    newSiblings.insert(newSiblings.begin() + piece, splitEntry);
   }
+}
 
-  Page *fpage;
-  bufMgr->readPage(file, fid, fpage);
-  LeafNodeInt *fnode = (LeafNodeInt *)fpage;
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectMessages()
+// -----------------------------------------------------------------------------
 
-  int idx = -1;
-  for (int i = 0; i < this->leafOccupancy; i++) {
-    if (lowValInt <= foundNode->keyArray[i]) {
-      idx = i;
-      break;
+void BTreeIndex::collectMessages(PageId pageNo, NormalizedKey low,
+                                 NormalizedKey high) {
+  PageGuard page = this->bufMgr->fetchPage(this->file, pageNo);
+  BufferedNonLeafNodeInt *node =
+      reinterpret_cast<BufferedNonLeafNodeInt *>(page.get());
+
+  // Entries are assumed to be inserted at most once and deleted only while
+  // present, so the order of the messages for one entry does not matter
+  for (int i = 0; i < node->messageCount; i++) {
+    const BufferMessage &message = node->messages[i];
+    if (message.key < low || message.key > high) {
+      continue;
+    }
+    if (message.op == INSERT_MESSAGE) {
+      // A pending insert cancels a pending delete of the same entry
+      std::map<std::pair<NormalizedKey, std::uint64_t>, int>::iterator it =
+          scanDeletes.find(std::make_pair(message.key, packRid(message.rid)));
+      if (it != scanDeletes.end()) {
+        if (--it->second == 0) {
+          scanDeletes.erase(it);
+        }
+      } else {
+        scanOverlay.insert(std::make_pair(message.key, message.rid));
+      }
+    } else {
+      bool cancelled = false;
+      std::pair<std::multimap<NormalizedKey, RecordId>::iterator,
+                std::multimap<NormalizedKey, RecordId>::iterator>
+          pending = scanOverlay.equal_range(message.key);
+      for (std::multimap<NormalizedKey, RecordId>::iterator it = pending.first;
+           it != pending.second; ++it) {
+        if (it->second == message.rid) {
+          scanOverlay.erase(it);
+          cancelled = true;
+          break;
+        }
+      }
+      if (!cancelled) {
+        scanDeletes[std::make_pair(message.key, packRid(message.rid))]++;
+      }
     }
   }
 
-  while (idx == -1 && fnode->rightSibPageNo != Page::INVALID_NUMBER) {
-    bufMgr->readPage(file, fnode->rightSibPageNo, fpage);
-    bufMgr->unPinPage(file, fid, false);
-    fid = fnode->rightSibPageNo;
-    fnode = (LeafNodeInt *)foundPage;
-    // bufMgr->unPinPage(file, fnode->rightSibPageNo, false);
+  // Visit every child whose key range overlaps [low, high]
+  int used = usedSlots(node->keyArray, this->nodeOccupancy);
+  int first = std::lower_bound(node->keyArray, node->keyArray + used, low) -
+              node->keyArray;
+  int last = std::upper_bound(node->keyArray, node->keyArray + used, high) -
+             node->keyArray;
+  std::vector<PageId> children;
+  if (node->level != 1) {
+    children.assign(node->pageNoArray + first, node->pageNoArray + last + 1);
+  }
+  page.release();
 
-    for (int i = 0; i < this->leafOccupancy; i++) {
-      if (lowValInt <= fnode->keyArray[i]) {
-        idx = i;
-        break;
-      }
-    }
+  for (std::size_t i = 0; i < children.size(); i++) {
+    collectMessages(children[i], low, high);
   }
+}
 
-  if (idx == -1) {
-    bufMgr->unPinPage(file, fnode->rightSibPageNo, false);
-    throw NoSuchKeyFoundException();
+// -----------------------------------------------------------------------------
+// BTreeIndex::nonLeafArrays()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::nonLeafArrays(Page *page, int *&level,
+                               NormalizedKey *&keyArray,
+                               PageId *&pageNoArray) {
+  if (this->useMessageBuffers) {
+    BufferedNonLeafNodeInt *node =
+        reinterpret_cast<BufferedNonLeafNodeInt *>(page);
+    level = &node->level;
+    keyArray = node->keyArray;
+    pageNoArray = node->pageNoArray;
+  } else {
+    NonLeafNodeInt *node = reinterpret_cast<NonLeafNodeInt *>(page);
+    level = &node->level;
+    keyArray = node->keyArray;
+    pageNoArray = node->pageNoArray;
   }
+}
 
-  if (lowOpParm == GT) {
-    if (fnode->keyArray[idx] > lowValInt) {
-      currentPageData = fpage;
-      currentPageNum = fid;
-      nextEntry = idx;
-    } else {
-      if (idx <= this->leafOccupancy - 2) {
-        currentPageData = foundPage;
-        currentPageNum = fid;
-        nextEntry = idx + 1;
-      } else {
-        if (foundNode->rightSibPageNo != Page::INVALID_NUMBER) {
-          currentPageData = foundPage;
-          currentPageNum = foundNode->rightSibPageNo;
-          nextEntry = 0;
-        } else {
-          // bufMgr->unPinPage(file, foundNode->rightSibPageNo, false);
-          throw NoSuchKeyFoundException();
-        }
-      }
-    }
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafArrays()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::leafArrays(Page *page, NormalizedKey *&keyArray,
+                            RecordId *&ridArray, char *&suffixArray,
+                            PageId *&rightSibPageNo) const {
+  if (this->attributeType == STRING) {
+    StringLeafNode *node = reinterpret_cast<StringLeafNode *>(page);
+    keyArray = node->keyArray;
+    ridArray = node->ridArray;
+    suffixArray = node->suffixArray[0];
+    rightSibPageNo = &node->rightSibPageNo;
   } else {
-    currentPageData = foundPage;
-    currentPageNum = fid;
-    nextEntry = idx;
+    LeafNodeInt *node = reinterpret_cast<LeafNodeInt *>(page);
+    keyArray = node->keyArray;
+    ridArray = node->ridArray;
+    suffixArray = NULL;
+    rightSibPageNo = &node->rightSibPageNo;
   }
-  scanExecuting = true;
-  bufMgr->unPinPage(file, foundNode->rightSibPageNo, false);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::logMessage()
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::scanNext(RecordId &outRid) {
-  if (scanExecuting == false) {
-    throw ScanNotInitializedException();
+void BTreeIndex::logMessage(const BufferMessage &message) {
+  if (this->deltaLog.is_open()) {
+    this->deltaLog.write(reinterpret_cast<const char *>(&message),
+                         sizeof(message));
+    this->deltaLog.flush();
   }
+}
 
-  bufMgr->readPage(file, currentPageNum, currentPageData);
-  LeafNodeInt *currPage = NULL;
-  if (currentPageData != NULL) {
-    currPage = (LeafNodeInt *)currentPageData;
-    int currKey = currPage->keyArray[nextEntry];
-    outRid = currPage->ridArray[nextEntry];
+// -----------------------------------------------------------------------------
+// BTreeIndex::bufferEntry()
+// -----------------------------------------------------------------------------
 
-    if ((currKey > highValInt && (highOp == LTE || highOp == LT)) ||
-        (currKey == highValInt && highOp == LT)) {
-      bufMgr->unPinPage(file, currentPageNum, false);
-      throw IndexScanCompletedException();
-    }
+void BTreeIndex::bufferEntry(const RIDKeyPair<NormalizedKey> &entry) {
+  BufferMessage message;
+  message.set(INSERT_MESSAGE, entry.rid, entry.key);
+  logMessage(message);
+  this->deltaBuffer.insert(std::make_pair(entry.key, entry.rid));
 
-    int end = this->leafOccupancy - 1;
-    if (nextEntry < end) {
-      nextEntry = nextEntry + 1;
-    } else {
-      if (currPage->rightSibPageNo == Page::INVALID_NUMBER) {
-        bufMgr->unPinPage(file, currentPageNum, false);
-        throw IndexScanCompletedException();
-      }
-      currentPageNum = currPage->rightSibPageNo;
-      nextEntry = 0;
-    }
+  if (this->deltaBuffer.size() >= this->deltaBufferCapacity && !scanExecuting) {
+    drainDeltaBuffer();
+  }
+}
 
-  } else {
-    endScan();
+// -----------------------------------------------------------------------------
+// BTreeIndex::drainDeltaBuffer()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::drainDeltaBuffer() {
+  // Entries go in in key order, so consecutive inserts mostly land in the
+  // leaf that is still in the buffer pool
+  std::multimap<NormalizedKey, RecordId>::const_iterator it;
+  for (it = this->deltaBuffer.begin(); it != this->deltaBuffer.end(); ++it) {
+    BufferMessage message;
+    message.set(INSERT_MESSAGE, it->second, it->first);
+    applyMessage(message);
+  }
+  this->bufMgr->flushFile(this->file);
+  this->deltaBuffer.clear();
+  this->deltaPos = this->deltaBuffer.end();
+
+  if (this->deltaLog.is_open()) {
+    this->deltaLog.close();
+    this->deltaLog.open(this->deltaLogName.c_str(),
+                        std::ios::out | std::ios::binary | std::ios::trunc);
   }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeIndex::replayDeltaLog()
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::endScan() {
-  if (scanExecuting == false) {
-    throw ScanNotInitializedException();
+
+void BTreeIndex::replayDeltaLog() {
+  std::ifstream log(this->deltaLogName.c_str(), std::ios::in | std::ios::binary);
+  if (!log.is_open()) {
+    return;
   }
 
-  scanExecuting = false;
+  // A torn record at the end of the log is ignored
+  BufferMessage message;
+  while (log.read(reinterpret_cast<char *>(&message), sizeof(message))) {
+    applyMessage(message);
+  }
+  log.close();
+
+  this->bufMgr->flushFile(this->file);
+  std::remove(this->deltaLogName.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertHelper()
+// -----------------------------------------------------------------------------
 
-  if (currentPageNum != Page::INVALID_NUMBER) {
-    bufMgr->unPinPage(file, currentPageNum, false);
+bool BTreeIndex::insertHelper(PageId pageNo, PageGuard page, bool isLeaf,
+                              const RIDKeyPair<NormalizedKey> &entry,
+                              PageKeyPair<NormalizedKey> &childEntry) {
+  bool split = false;
+  if (isLeaf) {
+    if (this->compressedLeaves) {
+      split = insertCompressedLeaf(pageNo, page.get(), entry, childEntry);
+    } else {
+      split = insertLeaf(pageNo, page.get(), entry, childEntry);
+    }
+    page.markDirty();
+  } else {
+    int *level;
+    NormalizedKey *keyArray;
+    PageId *pageNoArray;
+    nonLeafArrays(page.get(), level, keyArray, pageNoArray);
+    int used = usedSlots(keyArray, this->nodeOccupancy);
+    int idx = std::upper_bound(keyArray, keyArray + used, entry.key) - keyArray;
+
+    PageKeyPair<NormalizedKey> newChild;
+    if (insertHelper(pageNoArray[idx], fetchChild(page, idx, pageNoArray[idx]),
+                     *level == 1, entry, newChild)) {
+      split = insertNonLeaf(page.get(), newChild, childEntry);
+      page.markDirty();
+    }
   }
+  return split;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertLeaf()
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::insertLeaf(PageId pageNo, Page *page,
+                            const RIDKeyPair<NormalizedKey> &entry,
+                            PageKeyPair<NormalizedKey> &childEntry) {
+  NormalizedKey *keyArray;
+  RecordId *ridArray;
+  char *suffixArray;
+  PageId *rightSibPageNo;
+  leafArrays(page, keyArray, ridArray, suffixArray, rightSibPageNo);
+  int used = usedSlots(keyArray, this->leafOccupancy);
+  int pos =
+      std::upper_bound(keyArray, keyArray + used, entry.key) - keyArray;
+
+  invalidateLearnedLeaf(pageNo);
+
+  if (used < this->leafOccupancy) {  // space left, simply insert
+    for (int i = used; i > pos; i--) {
+      keyArray[i] = keyArray[i - 1];
+      ridArray[i] = ridArray[i - 1];
+    }
+    keyArray[pos] = entry.key;
+    ridArray[pos] = entry.rid;
+    if (suffixArray != NULL) {
+      std::memmove(suffixArray + (pos + 1) * STRINGSUFFIXSIZE,
+                   suffixArray + pos * STRINGSUFFIXSIZE,
+                   (used - pos) * STRINGSUFFIXSIZE);
+      std::memcpy(suffixArray + pos * STRINGSUFFIXSIZE, this->insertSuffix,
+                  STRINGSUFFIXSIZE);
+    }
+    if (this->useLeafFilters) {
+      LeafFilter &filter = leafFilter(pageNo);
+      if (filter.built) {
+        filter.add(entry.key);
+      }
+    }
+    return false;
+  }
+
+  // No space left: merge the new entry in order, keep the lower half here and
+  // move the upper half to a new right sibling. A STRING leaf holds fewer
+  // entries than an INTEGER one.
+  NormalizedKey keys[INTARRAYLEAFSIZE + 1];
+  RecordId rids[INTARRAYLEAFSIZE + 1];
+  char suffixes[(STRINGARRAYLEAFSIZE + 1) * STRINGSUFFIXSIZE];
+  std::copy(keyArray, keyArray + pos, keys);
+  std::copy(ridArray, ridArray + pos, rids);
+  keys[pos] = entry.key;
+  rids[pos] = entry.rid;
+  std::copy(keyArray + pos, keyArray + used, keys + pos + 1);
+  std::copy(ridArray + pos, ridArray + used, rids + pos + 1);
+  if (suffixArray != NULL) {
+    std::memcpy(suffixes, suffixArray, pos * STRINGSUFFIXSIZE);
+    std::memcpy(suffixes + pos * STRINGSUFFIXSIZE, this->insertSuffix,
+                STRINGSUFFIXSIZE);
+    std::memcpy(suffixes + (pos + 1) * STRINGSUFFIXSIZE,
+                suffixArray + pos * STRINGSUFFIXSIZE,
+                (used - pos) * STRINGSUFFIXSIZE);
+  }
+
+  int leftSize = (this->leafOccupancy + 1) / 2;
+  int rightSize = this->leafOccupancy + 1 - leftSize;
+
+  PageId newPID;
+  WritePageGuard newPage = this->bufMgr->newPage(this->file, newPID);
+  NormalizedKey *newKeyArray;
+  RecordId *newRidArray;
+  char *newSuffixArray;
+  PageId *newRightSibPageNo;
+  leafArrays(newPage.get(), newKeyArray, newRidArray, newSuffixArray,
+             newRightSibPageNo);
+
+  std::copy(keys, keys + leftSize, keyArray);
+  std::copy(rids, rids + leftSize, ridArray);
+  std::fill(keyArray + leftSize, keyArray + this->leafOccupancy, EMPTY_KEY);
+
+  std::copy(keys + leftSize, keys + leftSize + rightSize, newKeyArray);
+  std::copy(rids + leftSize, rids + leftSize + rightSize, newRidArray);
+  std::fill(newKeyArray + rightSize, newKeyArray + this->leafOccupancy,
+            EMPTY_KEY);
+
+  if (suffixArray != NULL) {
+    std::memcpy(suffixArray, suffixes, leftSize * STRINGSUFFIXSIZE);
+    std::memcpy(newSuffixArray, suffixes + leftSize * STRINGSUFFIXSIZE,
+                rightSize * STRINGSUFFIXSIZE);
+  }
+
+  *newRightSibPageNo = *rightSibPageNo;
+  *rightSibPageNo = newPID;
+
+  if (this->useLeafFilters) {
+    buildLeafFilter(pageNo, keyArray, leftSize);
+    buildLeafFilter(newPID, newKeyArray, rightSize);
+  }
+
+  childEntry.set(newPID, newKeyArray[0]);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertCompressedLeaf()
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::insertCompressedLeaf(PageId pageNo, Page *page,
+                                      const RIDKeyPair<NormalizedKey> &entry,
+                                      PageKeyPair<NormalizedKey> &childEntry) {
+  DecodedLeaf leaf;
+  decodeLeaf(page, leaf);
+  int used = leaf.keyArray.size();
+  int pos = std::upper_bound(leaf.keyArray.begin(), leaf.keyArray.end(),
+                             entry.key) -
+            leaf.keyArray.begin();
+
+  invalidateLearnedLeaf(pageNo);
+
+  leaf.keyArray.insert(leaf.keyArray.begin() + pos, entry.key);
+  leaf.ridArray.insert(leaf.ridArray.begin() + pos, entry.rid);
+  if (encodeLeaf(page, leaf.keyArray.data(), leaf.ridArray.data(), used + 1,
+                 leaf.rightSibPageNo)) {
+    if (this->useLeafFilters) {
+      LeafFilter &filter = leafFilter(pageNo);
+      if (filter.built) {
+        filter.add(entry.key);
+      }
+    }
+    return false;
+  }
+
+  // The entry would widen the fields too much. Split the old entries in
+  // two, which always fit, and let the entry descend again.
+  leaf.keyArray.erase(leaf.keyArray.begin() + pos);
+  leaf.ridArray.erase(leaf.ridArray.begin() + pos);
+  int leftSize = (used + 1) / 2;
+  int rightSize = used - leftSize;
+
+  PageId newPID;
+  WritePageGuard newPage = this->bufMgr->newPage(this->file, newPID);
+  encodeLeaf(newPage.get(), leaf.keyArray.data() + leftSize,
+             leaf.ridArray.data() + leftSize, rightSize, leaf.rightSibPageNo);
+  encodeLeaf(page, leaf.keyArray.data(), leaf.ridArray.data(), leftSize,
+             newPID);
+
+  if (this->useLeafFilters) {
+    buildLeafFilter(pageNo, leaf.keyArray.data(), leftSize);
+    buildLeafFilter(newPID, leaf.keyArray.data() + leftSize, rightSize);
+  }
+
+  this->leafInsertDeferred = true;
+  childEntry.set(newPID, leaf.keyArray[leftSize]);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readLeaf()
+// -----------------------------------------------------------------------------
+
+LeafView BTreeIndex::readLeaf(const Page *page, DecodedLeaf &decoded) const {
+  LeafView view;
+  if (this->compressedLeaves) {
+    decodeLeaf(page, decoded);
+    view.keyArray = decoded.keyArray.data();
+    view.ridArray = decoded.ridArray.data();
+    view.used = decoded.keyArray.size();
+    view.rightSibPageNo = decoded.rightSibPageNo;
+    view.suffixArray = NULL;
+  } else {
+    NormalizedKey *keyArray;
+    RecordId *ridArray;
+    char *suffixArray;
+    PageId *rightSibPageNo;
+    leafArrays(const_cast<Page *>(page), keyArray, ridArray, suffixArray,
+               rightSibPageNo);
+    view.keyArray = keyArray;
+    view.ridArray = ridArray;
+    view.suffixArray = suffixArray;
+    view.used = usedSlots(keyArray, this->leafOccupancy);
+    view.rightSibPageNo = *rightSibPageNo;
+  }
+  return view;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertNonLeaf()
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::insertNonLeaf(Page *page,
+                               const PageKeyPair<NormalizedKey> &entry,
+                               PageKeyPair<NormalizedKey> &childEntry) {
+  int *level;
+  NormalizedKey *keyArray;
+  PageId *pageNoArray;
+  nonLeafArrays(page, level, keyArray, pageNoArray);
+
+  int used = usedSlots(keyArray, this->nodeOccupancy);
+  int pos = std::upper_bound(keyArray, keyArray + used, entry.key) - keyArray;
+
+  if (used < this->nodeOccupancy) {  // space left, simply insert
+    for (int i = used; i > pos; i--) {
+      keyArray[i] = keyArray[i - 1];
+      pageNoArray[i + 1] = pageNoArray[i];
+    }
+    keyArray[pos] = entry.key;
+    pageNoArray[pos + 1] = entry.pageNo;
+    return false;
+  }
+
+  // No space left: merge the new separator in order, then push the middle key
+  // up and move everything right of it to a new sibling.
+  NormalizedKey keys[INTARRAYNONLEAFSIZE + 1];
+  PageId pages[INTARRAYNONLEAFSIZE + 2];
+  std::copy(keyArray, keyArray + pos, keys);
+  keys[pos] = entry.key;
+  std::copy(keyArray + pos, keyArray + used, keys + pos + 1);
+  std::copy(pageNoArray, pageNoArray + pos + 1, pages);
+  pages[pos + 1] = entry.pageNo;
+  std::copy(pageNoArray + pos + 1, pageNoArray + used + 1, pages + pos + 2);
+
+  int leftSize = (this->nodeOccupancy + 1) / 2;
+  int rightSize = this->nodeOccupancy - leftSize;
+
+  PageId newPID;
+  WritePageGuard newPage = this->bufMgr->newPage(this->file, newPID);
+  int *newLevel;
+  NormalizedKey *newKeyArray;
+  PageId *newPageNoArray;
+  nonLeafArrays(newPage.get(), newLevel, newKeyArray, newPageNoArray);
+  *newLevel = *level;
+
+  std::copy(keys, keys + leftSize, keyArray);
+  std::copy(pages, pages + leftSize + 1, pageNoArray);
+  std::fill(keyArray + leftSize, keyArray + this->nodeOccupancy, EMPTY_KEY);
+  std::fill(pageNoArray + leftSize + 1, pageNoArray + this->nodeOccupancy + 1,
+            static_cast<PageId>(Page::INVALID_NUMBER));
+
+  std::copy(keys + leftSize + 1, keys + leftSize + 1 + rightSize, newKeyArray);
+  std::copy(pages + leftSize + 1, pages + leftSize + 2 + rightSize,
+            newPageNoArray);
+  std::fill(newKeyArray + rightSize, newKeyArray + this->nodeOccupancy,
+            EMPTY_KEY);
+  std::fill(newPageNoArray + rightSize + 1,
+            newPageNoArray + this->nodeOccupancy + 1,
+            static_cast<PageId>(Page::INVALID_NUMBER));
+
+  if (this->useMessageBuffers) {
+    // Messages follow their keys: those at or above the pushed up key now
+    // descend through the new sibling
+    BufferedNonLeafNodeInt *node =
+        reinterpret_cast<BufferedNonLeafNodeInt *>(page);
+    BufferedNonLeafNodeInt *newNode =
+        reinterpret_cast<BufferedNonLeafNodeInt *>(newPage.get());
+    int kept = 0;
+    newNode->messageCount = 0;
+    for (int i = 0; i < node->messageCount; i++) {
+      if (node->messages[i].key >= keys[leftSize]) {
+        newNode->messages[newNode->messageCount++] = node->messages[i];
+      } else {
+        node->messages[kept++] = node->messages[i];
+      }
+    }
+    node->messageCount = kept;
+  }
+
+  childEntry.set(newPID, keys[leftSize]);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::growRoot()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::growRoot(const PageKeyPair<NormalizedKey> &childEntry) {
+  PageId rootPID;
+  WritePageGuard newRootPage = this->bufMgr->newPage(this->file, rootPID);
+  int *level;
+  NormalizedKey *keyArray;
+  PageId *pageNoArray;
+  nonLeafArrays(newRootPage.get(), level, keyArray, pageNoArray);
+
+  *level = this->ifRootIsLeaf ? 1 : 0;
+  std::fill(keyArray, keyArray + this->nodeOccupancy, EMPTY_KEY);
+  std::fill(pageNoArray, pageNoArray + this->nodeOccupancy + 1,
+            static_cast<PageId>(Page::INVALID_NUMBER));
+  keyArray[0] = childEntry.key;
+  pageNoArray[0] = this->rootPageNum;
+  pageNoArray[1] = childEntry.pageNo;
+  if (this->useMessageBuffers) {
+    reinterpret_cast<BufferedNonLeafNodeInt *>(newRootPage.get())
+        ->messageCount = 0;
+  }
+  newRootPage.release();
+
+  this->rootPageNum = rootPID;
+  this->ifRootIsLeaf = false;
+
+  WritePageGuard metaPage =
+      this->bufMgr->fetchPageForWrite(this->file, this->headerPageNum);
+  badgerdb::IndexMetaInfo *meta =
+      reinterpret_cast<IndexMetaInfo *>(metaPage.get());
+  meta->rootPageNo = this->rootPageNum;
+  meta->ifRootIsLeaf = false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::search()
+// -----------------------------------------------------------------------------
+
+PageGuard BTreeIndex::search(PageId &foundPageID, NormalizedKey key,
+                             std::vector<PageId> &path,
+                             NormalizedKey &fenceKey) {
+  PageId currPageId = this->rootPageNum;
+  PageGuard currPage = fetchRoot();
+  for (;;) {
+    int *level;
+    NormalizedKey *keyArray;
+    PageId *pageNoArray;
+    nonLeafArrays(currPage.get(), level, keyArray, pageNoArray);
+
+    // Take the leftmost child that may hold the key: a run of duplicates can
+    // straddle a leaf split, leaving copies of the separator in the left
+    // child.
+    int used = usedSlots(keyArray, this->nodeOccupancy);
+    int idx = std::lower_bound(keyArray, keyArray + used, key) - keyArray;
+    PageId childPageId = pageNoArray[idx];
+    bool childIsLeaf = *level == 1;
+    if (idx < used) {
+      fenceKey = std::min(fenceKey, keyArray[idx]);
+    }
+    path.push_back(currPageId);
+
+    // The child is pinned before the parent is let go
+    currPage = fetchChild(currPage, idx, childPageId);
+    currPageId = childPageId;
+    if (childIsLeaf) {
+      foundPageID = childPageId;
+      return currPage;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::fetchRoot()
+// -----------------------------------------------------------------------------
+
+PageGuard BTreeIndex::fetchRoot() {
+  if (this->swizzleChildren) {
+    return this->bufMgr->fetchPageAt(this->file, this->rootPageNum,
+                                     this->rootFrame);
+  }
+  return this->bufMgr->fetchPage(this->file, this->rootPageNum);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::fetchChild()
+// -----------------------------------------------------------------------------
+
+PageGuard BTreeIndex::fetchChild(const PageGuard &parent, int slot,
+                                 PageId pageNo) {
+  if (this->swizzleChildren) {
+    return this->bufMgr->fetchChild(parent, slot, this->file, pageNo);
+  }
+  return this->bufMgr->fetchPage(this->file, pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafFilter()
+// -----------------------------------------------------------------------------
+
+LeafFilter &BTreeIndex::leafFilter(PageId pageNo) {
+  return this->leafFilters[pageNo];
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildLeafFilter()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::buildLeafFilter(PageId pageNo, const NormalizedKey *keys,
+                                 int used) {
+  LeafFilter &filter = leafFilter(pageNo);
+  filter.clear();
+  for (int i = 0; i < used; i++) {
+    filter.add(keys[i]);
+  }
+  filter.built = true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildLeafFilters()
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::buildLeafFilters() {
+  this->leafFilters.clear();
+
+  // Start from the leftmost leaf
+  PageId pageNo = this->rootPageNum;
+  if (!this->ifRootIsLeaf) {
+    std::vector<PageId> path;
+    NormalizedKey fence = EMPTY_KEY;
+    search(pageNo, 0, path, fence);
+  }
+
+  while (pageNo != Page::INVALID_NUMBER) {
+    PageGuard page = this->bufMgr->fetchPage(this->file, pageNo);
+    DecodedLeaf decoded;
+    LeafView leaf = readLeaf(page.get(), decoded);
+    buildLeafFilter(pageNo, leaf.keyArray, leaf.used);
+    pageNo = leaf.rightSibPageNo;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafMayContain()
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::leafMayContain(NormalizedKey key) {
+  PageId pageNo = this->rootPageNum;
+  if (this->ifRootIsLeaf) {
+    return leafFilter(pageNo).mayContain(key);
+  }
+
+  // Copies of a key may sit on both sides of a separator equal to it, and
+  // deletes can leave them only on the left, so every leaf back to the first
+  // one that may hold the key is consulted. The leaves are not read.
+  PageGuard page = fetchRoot();
+  bool fenceIsKey = false;
+  for (;;) {
+    int *level;
+    NormalizedKey *keyArray;
+    PageId *pageNoArray;
+    nonLeafArrays(page.get(), level, keyArray, pageNoArray);
+    int used = usedSlots(keyArray, this->nodeOccupancy);
+    int idx = std::upper_bound(keyArray, keyArray + used, key) - keyArray;
+    if (*level == 1) {
+      for (; idx > 0 && keyArray[idx - 1] == key; idx--) {
+        if (leafFilter(pageNoArray[idx]).mayContain(key)) {
+          return true;
+        }
+      }
+      if (idx == 0 && fenceIsKey) {
+        // The copies continue under the node to the left
+        return true;
+      }
+      return leafFilter(pageNoArray[idx]).mayContain(key);
+    }
+    if (idx > 0) {
+      fenceIsKey = keyArray[idx - 1] == key;
+    }
+    pageNo = pageNoArray[idx];
+    page = fetchChild(page, idx, pageNo);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::trainLearnedLayer
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::trainLearnedLayer() {
+  learnedSegments.clear();
+  learnedLeafSegments.clear();
+  learnedMaxObserved = 0;
+  learnedMeanError = 0.0;
+  double errorSum = 0.0;
+  std::size_t trainedKeys = 0;
+
+  // Start from the leftmost leaf
+  PageId pageNo = this->rootPageNum;
+  if (!this->ifRootIsLeaf) {
+    std::vector<PageId> path;
+    NormalizedKey fence = EMPTY_KEY;
+    search(pageNo, 0, path, fence);
+  }
+
+  while (pageNo != Page::INVALID_NUMBER) {
+    PageGuard page = this->bufMgr->fetchPage(this->file, pageNo);
+    DecodedLeaf decoded;
+    LeafView leaf = readLeaf(page.get(), decoded);
+    const LeafView *node = &leaf;
+    int used = leaf.used;
+
+    if (pageNo >= learnedLeafSegments.size()) {
+      learnedLeafSegments.resize(pageNo + 1);
+    }
+    learnedLeafSegments[pageNo] =
+        std::make_pair(learnedSegments.size(), used > 0 ? 0 : 1);
+
+    // Greedily grow each segment while some line through its first key still
+    // predicts every distinct key within the bound (a shrinking cone of
+    // feasible slopes). Duplicates are found from their first slot.
+    int first = 0;
+    while (first < used) {
+      NormalizedKey firstKey = node->keyArray[first];
+      double slopeLow = 0.0;
+      double slopeHigh = std::numeric_limits<double>::infinity();
+      int last = first;
+      for (int i = first + 1; i < used; i++) {
+        if (node->keyArray[i] != node->keyArray[i - 1]) {
+          double dk = static_cast<double>(node->keyArray[i] - firstKey);
+          double dp = i - first;
+          double low = std::max(slopeLow, (dp - learnedMaxError) / dk);
+          double high = std::min(slopeHigh, (dp + learnedMaxError) / dk);
+          if (low > high) {
+            break;
+          }
+          slopeLow = low;
+          slopeHigh = high;
+        }
+        last = i;
+      }
+
+      LearnedSegment segment;
+      segment.firstKey = firstKey;
+      segment.lastKey = node->keyArray[last];
+      segment.slope = slopeHigh == std::numeric_limits<double>::infinity()
+                          ? slopeLow
+                          : (slopeLow + slopeHigh) / 2;
+      segment.pageNo = pageNo;
+      segment.firstSlot = first;
+      segment.lastSlot = last;
+      segment.valid = true;
+      learnedSegments.push_back(segment);
+      learnedLeafSegments[pageNo].second++;
+
+      for (int i = first; i <= last; i++) {
+        if (i == first || node->keyArray[i] != node->keyArray[i - 1]) {
+          double predicted =
+              first + segment.slope *
+                          static_cast<double>(node->keyArray[i] - firstKey);
+          double error = std::fabs(predicted - i);
+          learnedMaxObserved =
+              std::max(learnedMaxObserved, static_cast<int>(std::ceil(error)));
+          errorSum += error;
+          trainedKeys++;
+        }
+      }
+      first = last + 1;
+    }
+
+    pageNo = node->rightSibPageNo;
+  }
+
+  if (trainedKeys > 0) {
+    learnedMeanError = errorSum / trainedKeys;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::learnedLayerStats
+// -----------------------------------------------------------------------------
+
+LearnedLayerStats BTreeIndex::learnedLayerStats() const {
+  LearnedLayerStats stats;
+  stats.segments = learnedSegments.size();
+  stats.validSegments = 0;
+  for (std::size_t i = 0; i < learnedSegments.size(); i++) {
+    if (learnedSegments[i].valid) {
+      stats.validSegments++;
+    }
+  }
+  stats.modelBytes = learnedSegments.size() * sizeof(LearnedSegment);
+  stats.errorBound = learnedMaxError;
+  stats.maxError = learnedMaxObserved;
+  stats.meanError = learnedMeanError;
+  stats.predictions = learnedPredictions;
+  stats.fallbacks = learnedFallbacks;
+  return stats;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::learnedSeek
+// -----------------------------------------------------------------------------
+
+// Orders segments by their last key, for finding the first segment that may
+// hold a key.
+static bool segmentBelow(const LearnedSegment &segment,
+                         const NormalizedKey key) {
+  return segment.lastKey < key;
+}
+
+bool BTreeIndex::learnedSeek(NormalizedKey key, PageId &pageNo, int &slot) {
+  if (learnedSegments.empty()) {
+    return false;
+  }
+
+  std::size_t idx = std::lower_bound(learnedSegments.begin(),
+                                     learnedSegments.end(), key, segmentBelow) -
+                    learnedSegments.begin();
+  // Entries inserted into the leaf before the segment may also be at or above
+  // the key, so that segment has to be valid as well
+  if (idx == learnedSegments.size() || !learnedSegments[idx].valid ||
+      (idx > 0 && !learnedSegments[idx - 1].valid)) {
+    learnedFallbacks++;
+    return false;
+  }
+
+  const LearnedSegment &segment = learnedSegments[idx];
+  double predicted = segment.firstSlot;
+  if (key > segment.firstKey) {
+    predicted += segment.slope * static_cast<double>(key - segment.firstKey);
+  }
+  // A key between two trained keys lies at most one slot past the bound
+  int start = static_cast<int>(std::floor(predicted)) - learnedMaxError - 1;
+  pageNo = segment.pageNo;
+  slot = std::min(std::max(start, segment.firstSlot), segment.lastSlot);
+  learnedPredictions++;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::invalidateLearnedLeaf
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::invalidateLearnedLeaf(PageId pageNo) {
+  if (pageNo >= learnedLeafSegments.size()) {
+    return;
+  }
+  const std::pair<std::size_t, std::size_t> &range =
+      learnedLeafSegments[pageNo];
+  for (std::size_t i = range.first;
+       i < range.first + range.second && i < learnedSegments.size(); i++) {
+    learnedSegments[i].valid = false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::normalizeRange
+// -----------------------------------------------------------------------------
+
+NormalizedRange BTreeIndex::normalizeRange(const void *lowVal,
+                                           const Operator lowOp,
+                                           const void *highVal,
+                                           const Operator highOp) const {
+  if (highOp != LT && highOp != LTE) {
+    throw BadOpcodesException();
+  }
+
+  if (lowOp != GT && lowOp != GTE) {
+    throw BadOpcodesException();
+  }
+
+  NormalizedRange range;
+  range.low = normalizeKey(lowVal, this->attributeType);
+  range.lowOp = lowOp;
+  range.high = normalizeKey(highVal, this->attributeType);
+  range.highOp = highOp;
+  range.lowStringOp = lowOp;
+  range.highStringOp = highOp;
+
+  if (range.high < range.low) {
+    throw BadScanrangeException();
+  }
+
+  // Keys sharing the prefix of a long bound may fall on either side of it, so
+  // the tree is scanned including the prefix and the full keys are checked
+  if (this->attributeType == STRING) {
+    const char *low = static_cast<const char *>(lowVal);
+    const char *high = static_cast<const char *>(highVal);
+    range.lowString.assign(low, strnlen(low, STRINGKEYSIZE));
+    range.highString.assign(high, strnlen(high, STRINGKEYSIZE));
+    if (range.highString < range.lowString) {
+      throw BadScanrangeException();
+    }
+    if (range.lowString.size() >= STRINGPREFIXSIZE) {
+      range.lowOp = GTE;
+    }
+    if (range.highString.size() >= STRINGPREFIXSIZE) {
+      range.highOp = LTE;
+    }
+  }
+  return range;
+}
+
+std::vector<NormalizedRange> BTreeIndex::normalizeRanges(
+    const std::vector<ScanRange> &ranges) const {
+  std::vector<NormalizedRange> normRanges;
+  normRanges.reserve(ranges.size());
+
+  for (std::size_t i = 0; i < ranges.size(); i++) {
+    NormalizedRange range =
+        normalizeRange(ranges[i].lowVal, ranges[i].lowOp, ranges[i].highVal,
+                       ranges[i].highOp);
+
+    // Each range has to start after the previous one ends
+    if (!normRanges.empty()) {
+      const NormalizedRange &prev = normRanges.back();
+      if (this->attributeType == STRING) {
+        if (range.lowString < prev.highString ||
+            (range.lowString == prev.highString &&
+             prev.highStringOp == LTE && range.lowStringOp == GTE)) {
+          throw BadScanrangeException();
+        }
+      } else if (range.low < prev.high ||
+                 (range.low == prev.high && prev.highOp == LTE &&
+                  range.lowOp == GTE)) {
+        throw BadScanrangeException();
+      }
+    }
+    normRanges.push_back(range);
+  }
+  return normRanges;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void *lowValParm, const Operator lowOpParm,
+                           const void *highValParm, const Operator highOpParm) {
+  if (highOpParm != LT && highOpParm != LTE) {
+    throw BadOpcodesException();
+  }
+
+  if (lowOpParm != GT && lowOpParm != GTE) {
+    throw BadOpcodesException();
+  }
+
+  if (scanExecuting) {
+    endScan();
+  }
+
+  // initilizing fields
+  switch (this->attributeType) {
+    case INTEGER:
+      lowValInt = *static_cast<const int *>(lowValParm);
+      highValInt = *static_cast<const int *>(highValParm);
+      break;
+    case DOUBLE:
+      lowValDouble = *static_cast<const double *>(lowValParm);
+      highValDouble = *static_cast<const double *>(highValParm);
+      break;
+    case STRING:
+      lowValString.assign(static_cast<const char *>(lowValParm),
+                          strnlen(static_cast<const char *>(lowValParm),
+                                  STRINGKEYSIZE));
+      highValString.assign(static_cast<const char *>(highValParm),
+                           strnlen(static_cast<const char *>(highValParm),
+                                   STRINGKEYSIZE));
+      break;
+  }
+
+  NormalizedRange range =
+      normalizeRange(lowValParm, lowOpParm, highValParm, highOpParm);
+  if (!beginScan(std::vector<NormalizedRange>(1, range))) {
+    throw NoSuchKeyFoundException();
+  }
+}
+
+void BTreeIndex::startScan(const std::vector<ScanRange> &ranges) {
+  std::vector<NormalizedRange> normRanges = normalizeRanges(ranges);
+
+  if (scanExecuting) {
+    endScan();
+  }
+
+  if (!beginScan(normRanges)) {
+    throw NoSuchKeyFoundException();
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::range
+// -----------------------------------------------------------------------------
+
+IndexScan BTreeIndex::range(const void *lowVal, const Operator lowOp,
+                            const void *highVal, const Operator highOp) {
+  return IndexScan(this, std::vector<NormalizedRange>(
+                             1, normalizeRange(lowVal, lowOp, highVal, highOp)));
+}
+
+IndexScan BTreeIndex::range(const void *lowVal, const void *highVal) {
+  return range(lowVal, GTE, highVal, LTE);
+}
+
+IndexScan BTreeIndex::range(const std::vector<ScanRange> &ranges) {
+  return IndexScan(this, normalizeRanges(ranges));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::beginScan
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::beginScan(const std::vector<NormalizedRange> &ranges) {
+  scanGeneration++;
+  scanRanges = ranges;
+  currentRange = 0;
+
+  // Ranges over a STRING index that meet at the prefix of a long bound are
+  // scanned as one, so that keys with that prefix are read only once
+  sharedPrefixes.clear();
+  if (this->attributeType == STRING) {
+    keyRanges = ranges;
+    scanRanges.clear();
+    for (std::size_t i = 0; i < ranges.size(); i++) {
+      const NormalizedRange &range = ranges[i];
+      if (range.lowString.size() >= STRINGPREFIXSIZE) {
+        sharedPrefixes.insert(range.low);
+      }
+      if (range.highString.size() >= STRINGPREFIXSIZE) {
+        sharedPrefixes.insert(range.high);
+      }
+      if (!scanRanges.empty() && range.low == scanRanges.back().high &&
+          range.lowOp == GTE && scanRanges.back().highOp == LTE) {
+        scanRanges.back().high = range.high;
+        scanRanges.back().highOp = range.highOp;
+      } else {
+        scanRanges.push_back(range);
+      }
+    }
+  }
+
+  // Pending messages in range are applied on top of the leaves
+  if (this->useMessageBuffers) {
+    NormalizedKey low = scanRanges.front().low;
+    NormalizedKey high = scanRanges.back().high;
+    scanOverlay.insert(deltaBuffer.lower_bound(low),
+                       deltaBuffer.upper_bound(high));
+    if (!this->ifRootIsLeaf) {
+      collectMessages(rootPageNum, low, high);
+    }
+    scanDelta = &scanOverlay;
+  }
+
+  // Equality probes for absent keys are answered by the leaf filter without
+  // reading the leaf.
+  if (this->useLeafFilters) {
+    while (currentRange < scanRanges.size() &&
+           isPointRange(scanRanges[currentRange]) &&
+           !leafMayContain(scanRanges[currentRange].low) &&
+           scanDelta->find(scanRanges[currentRange].low) == scanDelta->end()) {
+      currentRange++;
+    }
+  }
+  if (currentRange == scanRanges.size()) {
+    scanOverlay.clear();
+    scanDeletes.clear();
+    scanDelta = &deltaBuffer;
+    return false;
+  }
+
+  PageId fid;
+  NormalizedKey fence = EMPTY_KEY;
+  int startSlot = 0;
+  std::vector<PageId> path;
+
+  if (this->ifRootIsLeaf) {
+    fid = rootPageNum;
+    currentPage = fetchRoot();
+  } else if (learnedSeek(scanRanges[currentRange].low, fid, startSlot)) {
+    // Reached without the descent, so the fence is unknown
+    fence = 0;
+    currentPage = bufMgr->fetchPage(file, fid);
+  } else {
+    currentPage = search(fid, scanRanges[currentRange].low, path, fence);
+  }
+
+  currentLeaf = readLeaf(currentPage.get(), currentDecoded);
+  if (this->useLeafFilters && !leafFilter(fid).built) {
+    buildLeafFilter(fid, currentLeaf.keyArray, currentLeaf.used);
+  }
+
+  currentFenceKey = fence;
+  nextEntry = startSlot;
+  treeExhausted = false;
+  deltaPos = scanDelta->begin();
+
+  if (!seekRange()) {
+    currentPage.release();
+    scanOverlay.clear();
+    scanDeletes.clear();
+    scanDelta = &deltaBuffer;
+    return false;
+  }
+  scanExecuting = true;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::seekRange
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::seekRange() {
+  while (currentRange < scanRanges.size()) {
+    const NormalizedRange &range = scanRanges[currentRange];
+    lowValKey = range.low;
+    lowOp = range.lowOp;
+    highValKey = range.high;
+    highOp = range.highOp;
+
+    // Both cursors have to be positioned, as scanNext merges the two
+    bool inTree = seekTree();
+    bool inDelta = seekDelta();
+    if (inTree || inDelta) {
+      return true;
+    }
+    currentRange++;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::seekTree
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::seekTree() {
+  const NormalizedRange &range = scanRanges[currentRange];
+
+  while (!treeExhausted) {
+    // Look for the low bound in what is left of the pinned leaf
+    const LeafView *leaf = &currentLeaf;
+    int used = leaf->used;
+    int start = std::min(nextEntry, used);
+    int idx;
+    if (lowOp == GT) {
+      idx = std::upper_bound(leaf->keyArray + start, leaf->keyArray + used,
+                             lowValKey) -
+            leaf->keyArray;
+    } else {
+      idx = std::lower_bound(leaf->keyArray + start, leaf->keyArray + used,
+                             lowValKey) -
+            leaf->keyArray;
+    }
+
+    if (idx < used) {
+      // If idx is past the range, the next range starts at or after it
+      nextEntry = idx;
+      return !pastHighBound(leaf->keyArray[idx], highValKey, highOp);
+    }
+
+    // Every key left in this leaf is below the range. An absent point key can
+    // be skipped without leaving the leaf.
+    if (this->useLeafFilters && isPointRange(range) &&
+        !leafMayContain(lowValKey)) {
+      return false;
+    }
+
+    PageId nextPageNo;
+    NormalizedKey nextFence = 0;
+    int nextSlot = 0;
+    PageGuard nextPage;
+    if (lowValKey < currentFenceKey) {
+      // The range starts before the fence, so in the right sibling
+      nextPageNo = leaf->rightSibPageNo;
+    } else {
+      // Skip ahead: re-descend to the leaf holding the low bound
+      if (!learnedSeek(lowValKey, nextPageNo, nextSlot)) {
+        std::vector<PageId> path;
+        nextFence = EMPTY_KEY;
+        nextPage = search(nextPageNo, lowValKey, path, nextFence);
+      }
+      if (nextPageNo == currentPage.pageNo()) {
+        // The range starts past this leaf but before the fence
+        nextPage.release();
+        nextPageNo = leaf->rightSibPageNo;
+        nextFence = 0;
+        nextSlot = 0;
+      }
+    }
+
+    if (nextPageNo == Page::INVALID_NUMBER) {
+      treeExhausted = true;
+      return false;
+    }
+
+    if (!nextPage) {
+      nextPage = bufMgr->fetchPage(file, nextPageNo);
+    }
+    currentPage = std::move(nextPage);
+    currentLeaf = readLeaf(currentPage.get(), currentDecoded);
+    currentFenceKey = nextFence;
+    nextEntry = nextSlot;
+    if (this->useLeafFilters && !leafFilter(nextPageNo).built) {
+      buildLeafFilter(nextPageNo, currentLeaf.keyArray, currentLeaf.used);
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::seekDelta
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::seekDelta() {
+  // Ranges are disjoint and ascending, so the bound never moves the cursor
+  // back over entries already returned
+  if (lowOp == GT) {
+    deltaPos = scanDelta->upper_bound(lowValKey);
+  } else {
+    deltaPos = scanDelta->lower_bound(lowValKey);
+  }
+  return deltaPos != scanDelta->end() &&
+         !pastHighBound(deltaPos->first, highValKey, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNext(RecordId &outRid) {
+  if (scanExecuting == false) {
+    throw ScanNotInitializedException();
+  }
+
+  if (!fetchNext(outRid)) {
+    throw IndexScanCompletedException();
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::fetchNext
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::fetchNext(RecordId &outRid) {
+  while (true) {
+    const LeafView *currPage = &currentLeaf;
+
+    // Move on to the right sibling once this leaf is used up. The sibling is
+    // pinned before the current leaf is released so that endScan always finds
+    // a pinned page. An entry deleted from an uncompressed leaf during the
+    // scan leaves EMPTY_KEY behind.
+    while (!treeExhausted && (nextEntry >= currPage->used ||
+                              currPage->keyArray[nextEntry] == EMPTY_KEY)) {
+      PageId sibPageNo = currPage->rightSibPageNo;
+      if (sibPageNo == Page::INVALID_NUMBER) {
+        treeExhausted = true;
+        break;
+      }
+      PageGuard sibPage = bufMgr->fetchPage(file, sibPageNo);
+      currentPage = std::move(sibPage);
+      currentLeaf = readLeaf(currentPage.get(), currentDecoded);
+      currentFenceKey = 0;
+      nextEntry = 0;
+      if (this->useLeafFilters && !leafFilter(sibPageNo).built) {
+        buildLeafFilter(sibPageNo, currPage->keyArray, currPage->used);
+      }
+    }
+
+    bool inTree =
+        !treeExhausted &&
+        !pastHighBound(currPage->keyArray[nextEntry], highValKey, highOp);
+    bool inDelta = deltaPos != scanDelta->end() &&
+                   !pastHighBound(deltaPos->first, highValKey, highOp);
+
+    if (!inTree && !inDelta) {
+      // This range is done; move on to the next one, if any
+      currentRange++;
+      if (!seekRange()) {
+        return false;
+      }
+      continue;
+    }
+
+    // Merge the leaves with the buffered entries, taking the tree first on
+    // ties
+    if (!inTree || (deltaPos != scanDelta->end() &&
+                    deltaPos->first < currPage->keyArray[nextEntry])) {
+      outRid = deltaPos->second;
+      ++deltaPos;
+      return true;
+    }
+
+    NormalizedKey key = currPage->keyArray[nextEntry];
+    const char *suffix =
+        currPage->suffixArray != NULL
+            ? currPage->suffixArray + nextEntry * STRINGSUFFIXSIZE
+            : NULL;
+    outRid = currPage->ridArray[nextEntry];
+    nextEntry++;
+
+    // Skip leaf entries with a pending delete
+    if (!scanDeletes.empty()) {
+      std::map<std::pair<NormalizedKey, std::uint64_t>, int>::iterator it =
+          scanDeletes.find(std::make_pair(key, packRid(outRid)));
+      if (it != scanDeletes.end()) {
+        if (--it->second == 0) {
+          scanDeletes.erase(it);
+        }
+        continue;
+      }
+    }
+
+    // The prefix of a long bound does not tell which side of it the key is on
+    if (!sharedPrefixes.empty() && sharedPrefixes.count(key) > 0 &&
+        !keyInRanges(key, suffix)) {
+      continue;
+    }
+    return true;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::keyInRanges
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::keyInRanges(NormalizedKey key, const char *suffix) const {
+  std::string fullKey;
+  for (int shift = 8 * (STRINGPREFIXSIZE - 1); shift >= 0; shift -= 8) {
+    char c = static_cast<char>((key >> shift) & 0xff);
+    if (c == '\0') {
+      break;
+    }
+    fullKey.push_back(c);
+  }
+  if (fullKey.size() == static_cast<std::size_t>(STRINGPREFIXSIZE)) {
+    fullKey.append(suffix, strnlen(suffix, STRINGSUFFIXSIZE));
+  }
+
+  for (std::size_t i = 0; i < keyRanges.size(); i++) {
+    const NormalizedRange &range = keyRanges[i];
+    bool aboveLow = range.lowStringOp == GT ? fullKey > range.lowString
+                                            : fullKey >= range.lowString;
+    bool belowHigh = range.highStringOp == LT ? fullKey < range.highString
+                                              : fullKey <= range.highString;
+    if (aboveLow && belowHigh) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+//
+void BTreeIndex::endScan() {
+  if (scanExecuting == false) {
+    throw ScanNotInitializedException();
+  }
+
+  closeScan();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::closeScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::closeScan() {
+  scanExecuting = false;
+
+  currentPage.release();
 
   lowOp = LT;
   highOp = GT;
   lowValInt = -1;
   highValInt = -1;
+  lowValKey = 0;
+  highValKey = 0;
+  scanRanges.clear();
+  keyRanges.clear();
+  sharedPrefixes.clear();
+  currentRange = 0;
+  currentFenceKey = 0;
+  treeExhausted = false;
+  scanOverlay.clear();
+  scanDeletes.clear();
+  scanDelta = &deltaBuffer;
+  deltaPos = deltaBuffer.end();
   nextEntry = -1;
-  currentPageData = NULL;
-  currentPageNum = Page::INVALID_NUMBER;
+  currentLeaf.used = 0;
+}
+
+// -----------------------------------------------------------------------------
+// IndexScan
+// -----------------------------------------------------------------------------
+
+IndexScan::IndexScan(BTreeIndex *index,
+                     const std::vector<NormalizedRange> &ranges)
+    : index(index), ranges(ranges), executing(false), generation(0) {}
+
+IndexScan::IndexScan(IndexScan &&other)
+    : index(other.index),
+      ranges(other.ranges),
+      executing(other.executing),
+      generation(other.generation) {
+  other.executing = false;
+}
+
+IndexScan::~IndexScan() {
+  // A scan started since begin() belongs to someone else
+  if (executing && ownsScan()) {
+    index->closeScan();
+  }
+}
+
+IndexScan::iterator IndexScan::begin() {
+  if (index->scanExecuting) {
+    index->closeScan();
+  }
+  executing = index->beginScan(ranges);
+  generation = index->scanGeneration;
+
+  iterator it;
+  if (next(it.rid)) {
+    it.scan = this;
+  }
+  return it;
+}
+
+bool IndexScan::next(RecordId &outRid) {
+  if (!executing) {
+    return false;
+  }
+  if (!ownsScan()) {
+    executing = false;
+    throw ScanNotInitializedException();
+  }
+  if (index->fetchNext(outRid)) {
+    return true;
+  }
+  index->closeScan();
+  executing = false;
+  return false;
+}
+
+bool IndexScan::ownsScan() const {
+  return index->scanExecuting && index->scanGeneration == generation;
+}
+
+IndexScan::iterator &IndexScan::iterator::operator++() {
+  if (!scan->next(rid)) {
+    scan = NULL;
+  }
+  return *this;
 }
 
 }  // namespace badgerdb
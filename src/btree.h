@@ -8,7 +8,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -37,20 +44,168 @@ enum Operator {
 };
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Order-preserving unsigned form of an index key. Keys of every
+ * Datatype are normalized into this representation at insert and scan-bound
+ * time, so node search compares plain unsigned integers whatever the declared
+ * attribute type.
  */
-//                                                  sibling ptr             key
-//                                                  rid
-const int INTARRAYLEAFSIZE =
-    (Page::SIZE - sizeof(PageId)) / (sizeof(int) + sizeof(RecordId));
+typedef std::uint64_t NormalizedKey;
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Marks an empty key slot in a node. Empty slots always sort after
+ * every used slot. No INTEGER key normalizes to this value; for DOUBLE it is a
+ * NaN bit pattern and for STRING it is a prefix of eight 0xFF bytes, neither
+ * of which can be indexed.
  */
-//                                                     level     extra pageNo
-//                                                     key       pageNo
-const int INTARRAYNONLEAFSIZE = (Page::SIZE - sizeof(int) - sizeof(PageId)) /
-                                (sizeof(int) + sizeof(PageId));
+const NormalizedKey EMPTY_KEY = UINT64_MAX;
+
+/**
+ * @brief Number of leading characters of a STRING key that are stored in the
+ * index. The prefix is packed big-endian into one NormalizedKey word; keys
+ * that share it are told apart by the rest of the key, which the leaves keep
+ * next to it.
+ */
+const int STRINGPREFIXSIZE = sizeof(NormalizedKey);
+
+/**
+ * @brief Largest number of characters of a STRING key, the size of the
+ * attribute field.
+ */
+const int STRINGKEYSIZE = 64;
+
+/**
+ * @brief Number of characters of a STRING key stored after its prefix.
+ */
+const int STRINGSUFFIXSIZE = STRINGKEYSIZE - STRINGPREFIXSIZE;
+
+/**
+ * @brief Normalize an INTEGER key: flipping the sign bit maps two's complement
+ * order onto unsigned order.
+ */
+inline NormalizedKey normalizeInt(const int key) {
+  return static_cast<std::uint32_t>(key) ^ 0x80000000u;
+}
+
+/**
+ * @brief Normalize a DOUBLE key. Non-negative values get their sign bit set
+ * and negative values have all bits inverted, which maps IEEE-754 order onto
+ * unsigned order. Negative zero is folded onto positive zero first.
+ */
+inline NormalizedKey normalizeDouble(double key) {
+  key += 0.0;
+  std::uint64_t bits;
+  std::memcpy(&bits, &key, sizeof(bits));
+  const std::uint64_t mask =
+      static_cast<std::uint64_t>(static_cast<std::int64_t>(bits) >> 63) |
+      0x8000000000000000ull;
+  return bits ^ mask;
+}
+
+/**
+ * @brief Normalize a STRING key: the first STRINGPREFIXSIZE characters are
+ * packed big-endian, zero padded after the terminating NUL, so unsigned order
+ * matches strcmp order on the prefix.
+ */
+inline NormalizedKey normalizeString(const char* key) {
+  NormalizedKey norm = 0;
+  int i = 0;
+  for (; i < STRINGPREFIXSIZE && key[i] != '\0'; i++) {
+    norm = (norm << 8) | static_cast<unsigned char>(key[i]);
+  }
+  for (; i < STRINGPREFIXSIZE; i++) {
+    norm <<= 8;
+  }
+  return norm;
+}
+
+/**
+ * @brief Normalize a key of the given type.
+ *
+ * @param key   Pointer to integer / double / char string
+ * @param type  Datatype of the key
+ */
+inline NormalizedKey normalizeKey(const void* key, const Datatype type) {
+  switch (type) {
+    case DOUBLE:
+      return normalizeDouble(*static_cast<const double*>(key));
+    case STRING:
+      return normalizeString(static_cast<const char*>(key));
+    default:
+      return normalizeInt(*static_cast<const int*>(key));
+  }
+}
+
+/**
+ * @brief Hash of a normalized key: the splitmix64 finalizer, so consecutive
+ * keys spread over all bits. It is a bijection, so keys hash equal only if
+ * they are equal.
+ */
+inline std::uint64_t hashNormalizedKey(NormalizedKey x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+/**
+ * @brief Number of key slots in B+Tree leaf. Every Datatype uses 8-byte key
+ * slots, which costs INTEGER indexes a quarter of the fanout 4-byte slots
+ * gave them (511 leaf and 681 non-leaf slots instead of 682 and 1023). Two
+ * levels of nodes still hold 348k INTEGER entries, and indexes that need
+ * the density can use compressed leaves.
+ */
+//                                                  sibling ptr
+//                                                  key           rid
+const int INTARRAYLEAFSIZE = (Page::SIZE - sizeof(PageId)) /
+                             (sizeof(NormalizedKey) + sizeof(RecordId));
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf.
+ */
+//                                                  level (padded)  extra pageNo
+//                                                  key             pageNo
+const int INTARRAYNONLEAFSIZE =
+    (Page::SIZE - sizeof(NormalizedKey) - sizeof(PageId)) /
+    (sizeof(NormalizedKey) + sizeof(PageId));
+
+/**
+ * @brief Number of key slots in a non-leaf node that keeps a message buffer.
+ * Far fewer than INTARRAYNONLEAFSIZE, so that most of the page is left for
+ * the buffer.
+ */
+const int BUFFEREDNONLEAFSIZE = 64;
+
+/**
+ * @brief Kind of change carried by a buffered message.
+ */
+enum MessageOp { INSERT_MESSAGE, DELETE_MESSAGE };
+
+/**
+ * @brief A pending insert or delete of one entry, kept in a non-leaf node's
+ * message buffer until it is flushed towards the leaves.
+ */
+struct BufferMessage {
+  NormalizedKey key;
+  RecordId rid;
+  MessageOp op;
+  void set(MessageOp o, RecordId r, NormalizedKey k) {
+    op = o;
+    rid = r;
+    key = k;
+  }
+};
+
+/**
+ * @brief Number of message slots in a non-leaf node that keeps a message
+ * buffer.
+ */
+//                                  level, count    keys, pageNos, padding
+const int MESSAGEBUFFERSIZE =
+    (Page::SIZE - 2 * sizeof(int) - BUFFEREDNONLEAFSIZE * sizeof(NormalizedKey) -
+     (BUFFEREDNONLEAFSIZE + 1) * sizeof(PageId) - sizeof(PageId)) /
+    sizeof(BufferMessage);
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to
@@ -97,6 +252,53 @@ bool operator<(const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2) {
     return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief One interval of a multi-range scan. The bounds point to values of the
+ * index's attribute type, as for BTreeIndex::startScan().
+ */
+struct ScanRange {
+  /**
+   * Low value of range, pointer to integer / double / char string.
+   */
+  const void* lowVal;
+
+  /**
+   * Low operator (GT/GTE).
+   */
+  Operator lowOp;
+
+  /**
+   * High value of range, pointer to integer / double / char string.
+   */
+  const void* highVal;
+
+  /**
+   * High operator (LT/LTE).
+   */
+  Operator highOp;
+};
+
+/**
+ * @brief Normalized bounds of one scan range, as kept while the scan runs.
+ */
+struct NormalizedRange {
+  NormalizedKey low;
+  Operator lowOp;
+  NormalizedKey high;
+  Operator highOp;
+
+  /**
+   * Full bounds and operators of a range over a STRING index; empty for other
+   * types. A bound longer than STRINGPREFIXSIZE keeps only its prefix in low
+   * or high, with the operator widened to include the prefix, and keys with
+   * that prefix are checked against these.
+   */
+  std::string lowString;
+  Operator lowStringOp;
+  std::string highString;
+  Operator highStringOp;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first
  * page of the btree index file and is cast to the following structure to store
@@ -128,7 +330,20 @@ struct IndexMetaInfo {
    */
   PageId rootPageNo;
 
+  /**
+   * True while the root page is still a leaf node.
+   */
   bool ifRootIsLeaf;
+
+  /**
+   * True if the non-leaf nodes keep message buffers (BufferedNonLeafNodeInt).
+   */
+  bool messageBuffers;
+
+  /**
+   * True if the leaf nodes are compressed (CompressedLeafNodeInt).
+   */
+  bool compressedLeaves;
 };
 
 /*
@@ -141,7 +356,8 @@ leaf nodes. Otherwise set to 0.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes. Keys are stored normalized, so the
+ * same layout serves every Datatype.
  */
 struct NonLeafNodeInt {
   /**
@@ -150,9 +366,9 @@ struct NonLeafNodeInt {
   int level;
 
   /**
-   * Stores keys.
+   * Stores normalized keys. Unused slots hold EMPTY_KEY.
    */
-  int keyArray[INTARRAYNONLEAFSIZE];
+  NormalizedKey keyArray[INTARRAYNONLEAFSIZE];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf
@@ -162,13 +378,48 @@ struct NonLeafNodeInt {
 };
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for non-leaf nodes of an index built with message buffers
+ * (a B-epsilon tree). Inserts and deletes are parked in the root's buffer and
+ * move one level down, in a batch for a single child, whenever a buffer fills.
+ */
+struct BufferedNonLeafNodeInt {
+  /**
+   * Level of the node in the tree.
+   */
+  int level;
+
+  /**
+   * Number of messages in the buffer.
+   */
+  int messageCount;
+
+  /**
+   * Stores normalized keys. Unused slots hold EMPTY_KEY.
+   */
+  NormalizedKey keyArray[BUFFEREDNONLEAFSIZE];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf
+   * nodes in the tree.
+   */
+  PageId pageNoArray[BUFFEREDNONLEAFSIZE + 1];
+
+  /**
+   * Pending messages for the subtree, in arrival order. A message goes to the
+   * child an insert of its key would descend to.
+   */
+  BufferMessage messages[MESSAGEBUFFERSIZE];
+};
+
+/**
+ * @brief Structure for all leaf nodes. Keys are stored normalized, so the same
+ * layout serves every Datatype.
  */
 struct LeafNodeInt {
   /**
-   * Stores keys.
+   * Stores normalized keys. Unused slots hold EMPTY_KEY.
    */
-  int keyArray[INTARRAYLEAFSIZE];
+  NormalizedKey keyArray[INTARRAYLEAFSIZE];
 
   /**
    * Stores RecordIds.
@@ -184,205 +435,1179 @@ struct LeafNodeInt {
 };
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute
- * of a relation. This index supports only one scan at a time.
+ * @brief Number of key slots in a leaf node of a STRING index.
  */
-class BTreeIndex {
- private:
+//                                                     sibling ptr
+//                                                     key           rid
+//                                                     rest of the key
+const int STRINGARRAYLEAFSIZE =
+    (Page::SIZE - sizeof(PageId)) /
+    (sizeof(NormalizedKey) + sizeof(RecordId) + STRINGSUFFIXSIZE);
+
+/**
+ * @brief Structure for leaf nodes of a STRING index. Besides the normalized
+ * prefix it keeps the rest of every key, so that keys sharing a prefix can be
+ * told apart without reading the relation.
+ */
+struct StringLeafNode {
   /**
-   * File object for the index file.
+   * Stores normalized key prefixes. Unused slots hold EMPTY_KEY.
    */
-  File* file;
+  NormalizedKey keyArray[STRINGARRAYLEAFSIZE];
 
   /**
-   * Buffer Manager Instance.
+   * Stores RecordIds.
    */
-  BufMgr* bufMgr;
+  RecordId ridArray[STRINGARRAYLEAFSIZE];
 
   /**
-   * Page number of meta page.
+   * Characters of each key after its prefix, zero padded.
    */
-  PageId headerPageNum;
+  char suffixArray[STRINGARRAYLEAFSIZE][STRINGSUFFIXSIZE];
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Page number of the leaf on the right side.
    */
-  PageId rootPageNum;
+  PageId rightSibPageNo;
+};
+
+/**
+ * @brief Number of bytes available to the packed entries of a compressed
+ * leaf.
+ */
+//                                                      count, widths
+//                                                      base key, base page
+//                                                      sibling ptr
+const int COMPRESSEDLEAFDATASIZE = Page::SIZE - 2 * sizeof(int) -
+                                   sizeof(NormalizedKey) - 2 * sizeof(PageId);
+
+/**
+ * @brief Largest number of entries in a compressed leaf, however narrow its
+ * fields are.
+ */
+const int COMPRESSEDLEAFMAXSIZE = 8192;
 
+/**
+ * @brief Structure for leaf nodes of an index built with compressed leaves.
+ * Keys are stored as offsets from the smallest key of the leaf (frame of
+ * reference), record ids as page number offsets from the smallest page number
+ * and slot numbers, each field bit-packed at the width of its largest value.
+ * The packed data holds every key offset, then every page offset, then every
+ * slot number. Removing entries never widens a field, so any subset of a
+ * leaf's entries fits in its page.
+ */
+struct CompressedLeafNodeInt {
   /**
-   * Datatype of attribute over which index is built.
+   * Number of entries in the leaf.
    */
-  Datatype attributeType;
+  int count;
 
   /**
-   * Offset of attribute, over which index is built, inside records.
+   * Bits per key offset.
    */
-  int attrByteOffset;
+  std::uint8_t keyBits;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Bits per page number offset.
    */
-  int leafOccupancy;
+  std::uint8_t pageBits;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Bits per slot number.
    */
-  int nodeOccupancy;
+  std::uint8_t slotBits;
 
-  bool ifRootIsLeaf;
+  std::uint8_t padding;
 
-  // MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Smallest key in the leaf.
+   */
+  NormalizedKey baseKey;
 
   /**
-   * True if an index scan has been started.
+   * Smallest page number among the leaf's record ids.
    */
-  bool scanExecuting;
+  PageId basePageNo;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Page number of the leaf on the right side.
    */
-  int nextEntry;
+  PageId rightSibPageNo;
 
   /**
-   * Page number of current page being scanned.
+   * Packed entries. The last 8 bytes are never part of the packed data, so
+   * that a field can be read with a single word load.
    */
-  PageId currentPageNum;
+  std::uint8_t data[COMPRESSEDLEAFDATASIZE];
+};
 
+/**
+ * @brief Entries of a compressed leaf, decoded into memory.
+ */
+struct DecodedLeaf {
   /**
-   * Current Page being scanned.
+   * Keys, in order.
    */
-  Page* currentPageData;
+  std::vector<NormalizedKey> keyArray;
 
   /**
-   * Low INTEGER value for scan.
+   * Record ids.
    */
-  int lowValInt;
+  std::vector<RecordId> ridArray;
 
   /**
-   * Low DOUBLE value for scan.
+   * Page number of the leaf on the right side.
    */
-  double lowValDouble;
+  PageId rightSibPageNo;
+};
+
+/**
+ * @brief Read-only view of the entries of a leaf in either format: it points
+ * into the page of an uncompressed leaf and into a DecodedLeaf otherwise.
+ */
+struct LeafView {
+  const NormalizedKey* keyArray;
+  const RecordId* ridArray;
 
   /**
-   * Low STRING value for scan.
+   * Rest of each STRING key, STRINGSUFFIXSIZE characters per entry; NULL for
+   * other types.
    */
-  std::string lowValString;
+  const char* suffixArray;
 
   /**
-   * High INTEGER value for scan.
+   * Number of entries.
    */
-  int highValInt;
+  int used;
 
   /**
-   * High DOUBLE value for scan.
+   * Page number of the leaf on the right side.
    */
-  double highValDouble;
+  PageId rightSibPageNo;
+};
+
+/**
+ * @brief Number of bits in the Bloom filter kept for each leaf. About eight
+ * bits per key for a full leaf.
+ */
+const int LEAFFILTERBITS = 4096;
+
+/**
+ * @brief Number of hash probes per key in a leaf Bloom filter.
+ */
+const int LEAFFILTERHASHES = 5;
 
+/**
+ * @brief In-memory Bloom filter summarizing the keys held by one leaf page. It
+ * lets an equality probe for an absent key stop after the non-leaf descent
+ * instead of reading the leaf.
+ */
+struct LeafFilter {
   /**
-   * High STRING value for scan.
+   * True once the filter holds every key of its leaf. A filter that has not
+   * been built answers "maybe" for every key.
    */
-  std::string highValString;
+  bool built;
 
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Filter bits.
    */
-  Operator lowOp;
+  std::uint64_t bits[LEAFFILTERBITS / 64];
+
+  LeafFilter() { clear(); }
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Empty the filter and mark it unbuilt.
    */
-  Operator highOp;
+  void clear() {
+    built = false;
+    std::memset(bits, 0, sizeof(bits));
+  }
 
- public:
   /**
-   * BTreeIndex Constructor.
-   * Check to see if the corresponding index file exists. If so, open the file.
-   * If not, create it and insert entries for every tuple in the base relation
-   * using FileScan class.
-   *
-   * @param relationName        Name of file.
-   * @param outIndexName        Return the name of index file.
-   * @param bufMgrIn						Buffer Manager
-   * Instance
-   * @param attrByteOffset			Offset of attribute, over which
-   * index is to be built, in the record
-   * @param attrType						Datatype of
-   * attribute over which index is built
+   * Add a key to the filter.
    */
-  BTreeIndex(const std::string& relationName, std::string& outIndexName,
-             BufMgr* bufMgrIn, const int attrByteOffset,
-             const Datatype attrType);
+  void add(const NormalizedKey key) {
+    std::uint64_t h = hashNormalizedKey(key);
+    std::uint32_t h1 = static_cast<std::uint32_t>(h);
+    std::uint32_t h2 = static_cast<std::uint32_t>(h >> 32) | 1;
+    for (int i = 0; i < LEAFFILTERHASHES; i++) {
+      std::uint32_t bit = (h1 + i * h2) % LEAFFILTERBITS;
+      bits[bit / 64] |= std::uint64_t(1) << (bit % 64);
+    }
+  }
 
   /**
-   * BTreeIndex Destructor.
-   * End any initialized scan, flush index file, after unpinning any pinned
-   * pages, from the buffer manager and delete file instance thereby closing the
-   * index file. Destructor should not throw any exceptions. All exceptions
-   * should be caught in here itself.
-   * */
-  ~BTreeIndex();
+   * Return false only if the key is certainly not in the leaf.
+   */
+  bool mayContain(const NormalizedKey key) const {
+    if (!built) {
+      return true;
+    }
+    std::uint64_t h = hashNormalizedKey(key);
+    std::uint32_t h1 = static_cast<std::uint32_t>(h);
+    std::uint32_t h2 = static_cast<std::uint32_t>(h >> 32) | 1;
+    for (int i = 0; i < LEAFFILTERHASHES; i++) {
+      std::uint32_t bit = (h1 + i * h2) % LEAFFILTERBITS;
+      if (!(bits[bit / 64] & (std::uint64_t(1) << (bit % 64)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE,
+              "Non-leaf node must fit in a page.");
+static_assert(sizeof(BufferedNonLeafNodeInt) <= Page::SIZE,
+              "Buffered non-leaf node must fit in a page.");
+static_assert(sizeof(LeafNodeInt) <= Page::SIZE,
+              "Leaf node must fit in a page.");
+static_assert(sizeof(StringLeafNode) <= Page::SIZE,
+              "String leaf node must fit in a page.");
+static_assert(sizeof(CompressedLeafNodeInt) <= Page::SIZE,
+              "Compressed leaf node must fit in a page.");
 
+/**
+ * @brief One piece of the learned routing layer: a linear model predicting
+ * the slot of a key within a run of slots of one leaf.
+ */
+struct LearnedSegment {
   /**
-   * @brief
-   *
-   * @param pagePointer
-   * @param entry
-   * @param childEntry
-   * @param pageLevel
-   * @param isRoot
+   * Smallest key covered by the segment.
    */
-  void insertHelper(Page* pagePointer, RIDKeyPair<int> entry,
-                    PageKeyPair<int>* childEntry, int pageLevel, bool isRoot);
+  NormalizedKey firstKey;
 
   /**
-   * Insert a new entry using the pair <value,rid>.
-   * Start from root to recursively find out the leaf to insert the entry in.
-   *The insertion may cause splitting of leaf node. This splitting will require
-   *addition of new leaf page number entry into the parent non-leaf, which may
-   *in-turn get split. This may continue all the way upto the root causing the
-   *root to get split. If root gets split, metapage needs to be changed
-   *accordingly. Make sure to unpin pages as soon as you can.
-   * @param key			Key to insert, pointer to integer/double/char
-   *string
-   * @param rid			Record ID of a record whose entry is getting
-   *inserted into the index.
-   **/
-  void insertEntry(const void* key, const RecordId rid);
+   * Largest key covered by the segment.
+   */
+  NormalizedKey lastKey;
 
   /**
-   * @brief
-   *
-   * @param foundPageID
-   * @param currPageId
-   * @param key
-   * @param path
+   * Predicted slots per unit of key, starting from firstSlot at firstKey.
    */
-  void search(PageId& foundPageID, PageId currPageId, const void* key,
-              std::vector<PageId>& path);
+  double slope;
 
   /**
-   * Begin a filtered scan of the index.  For instance, if the method is called
-   * using ("a",GT,"d",LTE) then we should seek all entries with a value
-   * greater than "a" and less than or equal to "d".
-   * If another scan is already executing, that needs to be ended here.
-   * Set up all the variables for scan. Start from root to find out the leaf
-   *page that contains the first RecordID that satisfies the scan parameters.
-   *Keep that page pinned in the buffer pool.
-   * @param lowVal	Low value of range, pointer to integer / double / char
-   *string
-   * @param lowOp		Low operator (GT/GTE)
-   * @param highVal	High value of range, pointer to integer / double / char
-   *string
-   * @param highOp	High operator (LT/LTE)
-   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
-   *their their expected values
-   * @throws  BadScanrangeException If lowVal > highval
-   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that
-   *satisfies the scan criteria.
+   * Page number of the leaf.
+   */
+  PageId pageNo;
+
+  /**
+   * First slot covered by the segment.
+   */
+  int firstSlot;
+
+  /**
+   * Last slot covered by the segment.
+   */
+  int lastSlot;
+
+  /**
+   * False once the leaf has changed since the segment was trained.
+   */
+  bool valid;
+};
+
+/**
+ * @brief Size and accuracy of the learned routing layer of a BTreeIndex.
+ */
+struct LearnedLayerStats {
+  /**
+   * Number of segments trained.
+   */
+  std::size_t segments;
+
+  /**
+   * Number of segments not yet invalidated by a change to their leaf.
+   */
+  std::size_t validSegments;
+
+  /**
+   * Memory taken by the segments, in bytes.
+   */
+  std::size_t modelBytes;
+
+  /**
+   * Error bound the segments were trained for, in slots.
+   */
+  int errorBound;
+
+  /**
+   * Largest error of a trained key, in slots.
+   */
+  int maxError;
+
+  /**
+   * Mean error over the trained keys, in slots.
+   */
+  double meanError;
+
+  /**
+   * Number of descents answered by the learned layer.
+   */
+  std::size_t predictions;
+
+  /**
+   * Number of descents that fell back to the tree because the segment was
+   * invalid or the key was past the last segment.
+   */
+  std::size_t fallbacks;
+};
+
+/**
+ * @brief Optional features of a BTreeIndex, chosen when it is constructed.
+ */
+struct BTreeOptions {
+  /**
+   * Keep an in-memory Bloom filter per leaf so equality probes for absent
+   * keys skip the leaf read. The filters are not stored in the index file;
+   * opening an existing index reads every leaf once to rebuild them.
+   */
+  bool useLeafFilters;
+
+  /**
+   * Number of entries the in-memory delta buffer absorbs before it is drained
+   * into the leaves in key order. 0 inserts straight into the tree.
+   */
+  std::size_t deltaBufferCapacity;
+
+  /**
+   * Append every buffered entry to a log file next to the index, so entries
+   * not yet drained survive a crash and are replayed when the index is
+   * opened again.
+   */
+  bool logDeltaBuffer;
+
+  /**
+   * Build the index with message buffers in its non-leaf nodes. Only used when
+   * the index is built; an existing index keeps the format it was built with.
+   */
+  bool useMessageBuffers;
+
+  /**
+   * Train a learned routing layer over the leaves once the index is built or
+   * opened, so that scans find their first leaf without reading non-leaf
+   * nodes. Suits read-mostly indexes with smooth key distributions.
+   */
+  bool useLearnedLayer;
+
+  /**
+   * Largest error, in slots, the learned layer may make for a trained key.
+   */
+  int learnedLayerMaxError;
+
+  /**
+   * Build the index with compressed leaves, which hold several times more
+   * entries of dense or clustered keys than uncompressed ones. Only used when
+   * the index is built; an existing index keeps the format it was built with.
+   */
+  bool compressLeaves;
+
+  /**
+   * Follow references to resident children through swips kept with the
+   * parent's frame, so that descending through nodes already in the buffer
+   * pool takes no page table lookups. Only kept in memory.
+   */
+  bool swizzleChildren;
+
+  BTreeOptions()
+      : useLeafFilters(false),
+        deltaBufferCapacity(0),
+        logDeltaBuffer(false),
+        useMessageBuffers(false),
+        useLearnedLayer(false),
+        learnedLayerMaxError(16),
+        compressLeaves(false),
+        swizzleChildren(false) {}
+};
+
+class IndexScan;
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute
+ * of a relation. This index supports only one scan at a time.
+ */
+class BTreeIndex {
+  friend class IndexScan;
+
+ private:
+  /**
+   * File object for the index file.
+   */
+  File* file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr* bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+  PageId headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+  PageId rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+  int attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+  int leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+  int nodeOccupancy;
+
+  /**
+   * True while the root page is still a leaf node.
+   */
+  bool ifRootIsLeaf;
+
+  /**
+   * True if the leaf nodes are compressed.
+   */
+  bool compressedLeaves;
+
+  /**
+   * Set when a full compressed leaf was split instead of taking an insert.
+   * The insert has to descend again.
+   */
+  bool leafInsertDeferred;
+
+  // MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * True if an index scan has been started.
+   */
+  bool scanExecuting;
+
+  /**
+   * Number of scans started on this index. An IndexScan remembers the value
+   * its own scan got, to notice when another scan has taken over the cursor.
+   */
+  std::uint64_t scanGeneration;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+  int nextEntry;
+
+  /**
+   * Current Page being scanned, kept pinned until the scan moves off it.
+   */
+  PageGuard currentPage;
+
+  /**
+   * Entries of the current page being scanned.
+   */
+  LeafView currentLeaf;
+
+  /**
+   * The current page being scanned, decoded if the leaves are compressed.
+   */
+  DecodedLeaf currentDecoded;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+  int lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+  double lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+  std::string lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+  int highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+  double highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+  std::string highValString;
+
+  /**
+   * For a STRING index, the ranges of the current scan as asked for, before
+   * ranges meeting at a shared prefix were joined for the tree scan.
+   */
+  std::vector<NormalizedRange> keyRanges;
+
+  /**
+   * Prefixes of the bounds of the current scan that are longer than
+   * STRINGPREFIXSIZE. An entry with one of these prefixes is only returned if
+   * its full key lies in keyRanges.
+   */
+  std::set<NormalizedKey> sharedPrefixes;
+
+  /**
+   * Rest of the STRING key being inserted, for the leaf that takes it.
+   */
+  char insertSuffix[STRINGSUFFIXSIZE];
+
+  /**
+   * Normalized low value for scan, compared directly against node keys.
+   */
+  NormalizedKey lowValKey;
+
+  /**
+   * Normalized high value for scan, compared directly against node keys.
+   */
+  NormalizedKey highValKey;
+
+  // MEMBERS SPECIFIC TO LEAF FILTERS
+
+  /**
+   * True if Bloom filters are kept for the leaves of this index.
+   */
+  bool useLeafFilters;
+
+  /**
+   * Leaf Bloom filters keyed by leaf page number. They are rebuilt from the
+   * leaves when an existing index is opened.
+   */
+  std::map<PageId, LeafFilter> leafFilters;
+
+  // MEMBERS SPECIFIC TO THE DELTA BUFFER
+
+  /**
+   * Number of entries the delta buffer holds before it is drained. 0 if
+   * there is no delta buffer.
+   */
+  std::size_t deltaBufferCapacity;
+
+  /**
+   * Entries inserted but not yet drained into the tree, in key order.
+   */
+  std::multimap<NormalizedKey, RecordId> deltaBuffer;
+
+  /**
+   * Next delta buffer entry to be scanned.
+   */
+  std::multimap<NormalizedKey, RecordId>::const_iterator deltaPos;
+
+  /**
+   * True once the current scan has run past the last leaf; from then on only
+   * buffered entries are left.
+   */
+  bool treeExhausted;
+
+  /**
+   * Name of the delta buffer log, the index file name with ".delta" appended.
+   */
+  std::string deltaLogName;
+
+  /**
+   * Delta buffer log. Only open if the buffer is logged.
+   */
+  std::ofstream deltaLog;
+
+  // MEMBERS SPECIFIC TO MESSAGE BUFFERS
+
+  /**
+   * True if the non-leaf nodes keep message buffers.
+   */
+  bool useMessageBuffers;
+
+  /**
+   * Inserts the current scan merges with the leaf entries: the delta buffer
+   * itself, or, with message buffers, a copy of the delta buffer entries in
+   * range together with the pending inserts in range.
+   */
+  const std::multimap<NormalizedKey, RecordId>* scanDelta;
+
+  /**
+   * Pending inserts in range of the current scan, and the delta buffer
+   * entries in range, when the index has message buffers.
+   */
+  std::multimap<NormalizedKey, RecordId> scanOverlay;
+
+  /**
+   * Leaf entries the current scan must skip because a delete is pending,
+   * with the number of deletes pending for each.
+   */
+  std::map<std::pair<NormalizedKey, std::uint64_t>, int> scanDeletes;
+
+  // MEMBERS SPECIFIC TO SWIZZLING
+
+  /**
+   * True if children are reached through swips.
+   */
+  bool swizzleChildren;
+
+  /**
+   * Frame the root was last found in, or NOFRAME.
+   */
+  FrameId rootFrame;
+
+  /**
+   * Pin the root, trying the frame it was last found in first when swizzling.
+   */
+  PageGuard fetchRoot();
+
+  /**
+   * Pin the child in a slot of a pinned non-leaf node, through the slot's
+   * swip when swizzling.
+   *
+   * @param parent      Guard holding the non-leaf node
+   * @param slot        Slot of the child in pageNoArray
+   * @param pageNo      Page number of the child
+   */
+  PageGuard fetchChild(const PageGuard& parent, int slot, PageId pageNo);
+
+  // MEMBERS SPECIFIC TO THE LEARNED LAYER
+
+  /**
+   * Error bound the learned layer is trained for, in slots.
+   */
+  int learnedMaxError;
+
+  /**
+   * Learned segments in key order, along the leaf chain. Empty until the
+   * layer is trained.
+   */
+  std::vector<LearnedSegment> learnedSegments;
+
+  /**
+   * Segments to invalidate when a leaf changes, indexed by leaf page number:
+   * first segment and number of segments. An empty leaf maps to the segment
+   * after it, since keys inserted into it are found through that segment.
+   */
+  std::vector<std::pair<std::size_t, std::size_t> > learnedLeafSegments;
+
+  /**
+   * Largest and mean error over the trained keys, in slots.
+   */
+  int learnedMaxObserved;
+  double learnedMeanError;
+
+  /**
+   * Descents answered by the learned layer, and descents that fell back to
+   * the tree.
+   */
+  std::size_t learnedPredictions;
+  std::size_t learnedFallbacks;
+
+  /**
+   * Find the leaf and the slot to start searching from for a key, using the
+   * learned layer. The slot is at most learnedMaxError + 1 slots before the
+   * first entry not below the key.
+   *
+   * @param key         Normalized key
+   * @param pageNo      Set to the predicted leaf
+   * @param slot        Set to the slot to start searching from
+   * @return  False if the tree must be descended instead
+   */
+  bool learnedSeek(NormalizedKey key, PageId& pageNo, int& slot);
+
+  /**
+   * Mark the segments trained over a leaf as invalid after the leaf changed.
+   *
+   * @param pageNo      Page number of the leaf
+   */
+  void invalidateLearnedLeaf(PageId pageNo);
+
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+  Operator lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+  Operator highOp;
+
+  /**
+   * Ranges of the current scan in ascending order. lowValKey, highValKey,
+   * lowOp and highOp hold the bounds of the range being scanned.
+   */
+  std::vector<NormalizedRange> scanRanges;
+
+  /**
+   * Index into scanRanges of the range being scanned.
+   */
+  std::size_t currentRange;
+
+  /**
+   * Lowest separator above the current leaf seen on the way down to it: keys
+   * at or above it live in later leaves. 0 when the leaf was reached along the
+   * sibling chain and the bound is unknown.
+   */
+  NormalizedKey currentFenceKey;
+
+  /**
+   * Check a full STRING key against the ranges of the current scan.
+   *
+   * @param key         Normalized prefix of the key
+   * @param suffix      Rest of the key, as kept in the leaf
+   * @return  True if the key lies in one of keyRanges
+   */
+  bool keyInRanges(NormalizedKey key, const char* suffix) const;
+
+  /**
+   * Apply an insert or delete to the tree, growing the root if it splits.
+   * With message buffers the message is only added to the root's buffer. The
+   * caller is responsible for flushing the index file.
+   *
+   * @param message     Insert or delete to apply
+   */
+  void applyMessage(const BufferMessage& message);
+
+  /**
+   * Apply an insert or delete to a leaf.
+   *
+   * @param pageNo      Page number of the leaf an insert of the key descends to
+   * @param message     Insert or delete to apply
+   * @param childEntry  Set to the new sibling if the leaf was split
+   * @return  True if the leaf was split
+   */
+  bool applyToLeaf(PageId pageNo, const BufferMessage& message,
+                   PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Remove one entry from the leaves. Duplicates of a key may span several
+   * leaves, so the leaves holding the key are searched left to right.
+   *
+   * @param entry       Normalized key and rid to remove
+   * @return  False if the entry is not in the tree
+   */
+  bool removeEntry(const RIDKeyPair<NormalizedKey>& entry);
+
+  /**
+   * Add a message to the buffer of a non-leaf node, flushing part of the
+   * buffer to the children first if it is full.
+   *
+   * @param pageNo      Page number of the non-leaf node
+   * @param message     Insert or delete to add
+   * @param newSiblings Empty; receives the separators of the new siblings,
+   *                    in key order, if the node was split
+   * @return  True if the node was split
+   */
+  bool pushMessage(PageId pageNo, const BufferMessage& message,
+                   std::vector<PageKeyPair<NormalizedKey> >& newSiblings);
+
+  /**
+   * Move the messages for the child with the most pending messages out of a
+   * full buffer, into the child's buffer or, one level above the leaves,
+   * into the leaf itself. Children split on the way are added to the node,
+   * which may split in turn, more than once; later messages descend through
+   * whichever piece of the node covers their key.
+   *
+   * @param page        Non-leaf node, pinned by the caller
+   * @param newSiblings Empty; receives the separators of the new siblings,
+   *                    in key order, if the node was split
+   * @return  True if the node was split
+   */
+  bool flushMessages(Page* page,
+                     std::vector<PageKeyPair<NormalizedKey> >& newSiblings);
+
+  /**
+   * Add a child's separator to a non-leaf node that may already have split,
+   * inserting it into the piece that covers its key.
+   *
+   * @param page        Non-leaf node, pinned by the caller
+   * @param entry       Separator key and page number of the child
+   * @param newSiblings Separators of the node's new siblings so far, in key
+   *                    order; a piece that splits adds its sibling here
+   */
+  void insertSeparator(Page* page, const PageKeyPair<NormalizedKey>& entry,
+                       std::vector<PageKeyPair<NormalizedKey> >& newSiblings);
+
+  /**
+   * Gather the pending messages for keys in [low, high] from the buffers of
+   * the subtree rooted at the given non-leaf page into scanOverlay and
+   * scanDeletes.
+   *
+   * @param pageNo      Page number of the non-leaf node
+   * @param low         Lowest key of interest
+   * @param high        Highest key of interest
+   */
+  void collectMessages(PageId pageNo, NormalizedKey low, NormalizedKey high);
+
+  /**
+   * Locate the level and the key and child arrays of a non-leaf page in the
+   * node format of this index.
+   *
+   * @param page        Non-leaf page
+   * @param level       Set to the node's level
+   * @param keyArray    Set to the node's keys
+   * @param pageNoArray Set to the node's children
+   */
+  void nonLeafArrays(Page* page, int*& level, NormalizedKey*& keyArray,
+                     PageId*& pageNoArray);
+
+  /**
+   * Locate the arrays of an uncompressed leaf page in the leaf format of this
+   * index.
+   *
+   * @param page            Leaf page
+   * @param keyArray        Set to the leaf's keys
+   * @param ridArray        Set to the leaf's record ids
+   * @param suffixArray     Set to the rest of the leaf's STRING keys, or NULL
+   * @param rightSibPageNo  Set to the leaf's sibling pointer
+   */
+  void leafArrays(Page* page, NormalizedKey*& keyArray, RecordId*& ridArray,
+                  char*& suffixArray, PageId*& rightSibPageNo) const;
+
+  /**
+   * Append a message to the delta buffer log, if the buffer is logged.
+   *
+   * @param message     Insert or delete to log
+   */
+  void logMessage(const BufferMessage& message);
+
+  /**
+   * Add an entry to the delta buffer, logging it if required, and drain the
+   * buffer once it is full. A running scan holds a position in the buffer,
+   * so draining waits until the scan has ended.
+   *
+   * @param entry       Normalized key and rid to insert
+   */
+  void bufferEntry(const RIDKeyPair<NormalizedKey>& entry);
+
+  /**
+   * Insert every buffered entry into the tree in key order, flush the index
+   * file and empty the log.
+   */
+  void drainDeltaBuffer();
+
+  /**
+   * Apply the inserts and deletes left in the delta buffer log by an earlier
+   * run to the tree, then empty the log.
+   */
+  void replayDeltaLog();
+
+  /**
+   * Insert an entry into the subtree rooted at the given page. If the node
+   * splits, the separator key and page number of the new right sibling are
+   * returned through childEntry so the caller can add them to its own node.
+   *
+   * @param pageNo      Page number of the subtree root
+   * @param page        Guard holding the subtree root, pinned by the caller
+   * @param isLeaf      True if the page is a leaf node
+   * @param entry       Normalized key and rid to insert
+   * @param childEntry  Set to the new sibling if the node was split
+   * @return  True if the node was split
+   */
+  bool insertHelper(PageId pageNo, PageGuard page, bool isLeaf,
+                    const RIDKeyPair<NormalizedKey>& entry,
+                    PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Insert into a leaf node that has been pinned by the caller.
+   *
+   * @param pageNo      Page number of the leaf
+   * @param page        Leaf page
+   * @param entry       Normalized key and rid to insert
+   * @param childEntry  Set to the new sibling if the leaf was split
+   * @return  True if the leaf was split
+   */
+  bool insertLeaf(PageId pageNo, Page* page,
+                  const RIDKeyPair<NormalizedKey>& entry,
+                  PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Insert into a compressed leaf node that has been pinned by the caller. A
+   * leaf that cannot take the entry is split in two, and the entry is left for
+   * the caller to insert again (see leafInsertDeferred): each half is a subset
+   * of the old entries, so it is sure to fit.
+   *
+   * @param pageNo      Page number of the leaf
+   * @param page        Leaf page
+   * @param entry       Normalized key and rid to insert
+   * @param childEntry  Set to the new sibling if the leaf was split
+   * @return  True if the leaf was split
+   */
+  bool insertCompressedLeaf(PageId pageNo, Page* page,
+                            const RIDKeyPair<NormalizedKey>& entry,
+                            PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Return the entries of a leaf page, decoding them into the given buffer if
+   * the leaves are compressed.
+   *
+   * @param page    Leaf page, pinned by the caller
+   * @param decoded Buffer for the decoded entries
+   */
+  LeafView readLeaf(const Page* page, DecodedLeaf& decoded) const;
+
+  /**
+   * Insert a separator into a non-leaf node that has been pinned by the
+   * caller. When a node with a message buffer splits, the messages for keys
+   * at or above the pushed up key move to the new sibling.
+   *
+   * @param page        Non-leaf node
+   * @param entry       Separator key and page number of the new child
+   * @param childEntry  Set to the new sibling if the node was split
+   * @return  True if the node was split
+   */
+  bool insertNonLeaf(Page* page,
+                     const PageKeyPair<NormalizedKey>& entry,
+                     PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Replace the root after it was split, and record the new root in the meta
+   * page.
+   *
+   * @param childEntry  Separator key and page number of the new sibling
+   */
+  void growRoot(const PageKeyPair<NormalizedKey>& childEntry);
+
+  /**
+   * Descend from the root, which must not be a leaf, to the leftmost leaf
+   * that may hold the key.
+   *
+   * @param foundPageID Page number of the leaf returned in this
+   * @param key         Normalized key
+   * @param path        Page numbers of the non-leaf nodes visited
+   * @param fenceKey    Lowered to the smallest separator above the path taken
+   * @return  Guard holding the leaf
+   */
+  PageGuard search(PageId& foundPageID, NormalizedKey key,
+                   std::vector<PageId>& path, NormalizedKey& fenceKey);
+
+  /**
+   * Check the operators and order of a range and normalize its bounds.
+   *
+   * @throws  BadOpcodesException If an operator is invalid
+   * @throws  BadScanrangeException If low > high
+   */
+  NormalizedRange normalizeRange(const void* lowVal, const Operator lowOp,
+                                 const void* highVal,
+                                 const Operator highOp) const;
+
+  /**
+   * Check and normalize ranges for a multi-range scan.
+   *
+   * @throws  BadOpcodesException If an operator of any range is invalid
+   * @throws  BadScanrangeException If a range has low > high, or the ranges
+   * are not ascending and disjoint
+   */
+  std::vector<NormalizedRange> normalizeRanges(
+      const std::vector<ScanRange>& ranges) const;
+
+  /**
+   * Start a scan over validated, ascending ranges: find and pin the leaf
+   * holding the first matching entry, and move on to the next scanGeneration.
+   * Any scan already executing must have been ended.
+   *
+   * @param ranges  Normalized ranges
+   * @return  False, with no scan executing, if no key satisfies any range
+   */
+  bool beginScan(const std::vector<NormalizedRange>& ranges);
+
+  /**
+   * Fetch the record id of the next entry of the executing scan.
+   *
+   * @param outRid  Record id returned in this
+   * @return  False if no entries are left
+   */
+  bool fetchNext(RecordId& outRid);
+
+  /**
+   * End the executing scan: unpin its leaf and reset the scan variables.
+   */
+  void closeScan();
+
+  /**
+   * Position the scan on the first entry of the current range or, if it is
+   * empty, of the next non-empty range, in both the tree and the delta
+   * buffer.
+   *
+   * @return  False if no range has any entries left
+   */
+  bool seekRange();
+
+  /**
+   * Position the leaf cursor on the first entry of the current range.
+   * Searches the pinned leaf first, steps to the right sibling when the fence
+   * key shows the range starts there, and otherwise re-descends from the
+   * root. Leaves are only ever visited left to right.
+   *
+   * @return  False if the tree has no entries in the current range
+   */
+  bool seekTree();
+
+  /**
+   * Position the cursor over buffered entries on the first entry of the
+   * current range.
+   *
+   * @return  False if there are no buffered entries in the current range
+   */
+  bool seekDelta();
+
+  /**
+   * Return the filter of the given leaf, adding an unbuilt one if it has none.
+   *
+   * @param pageNo  Page number of the leaf
+   */
+  LeafFilter& leafFilter(PageId pageNo);
+
+  /**
+   * Rebuild the filter of a leaf from the keys it holds.
+   *
+   * @param pageNo  Page number of the leaf
+   * @param keys    Keys of the leaf
+   * @param used    Number of keys
+   */
+  void buildLeafFilter(PageId pageNo, const NormalizedKey* keys, int used);
+
+  /**
+   * Build the filter of every leaf, walking the leaf level from the left.
+   */
+  void buildLeafFilters();
+
+  /**
+   * Descend to the leaves that may hold the key and consult their filters.
+   * That is one leaf, unless copies of the key run across separators equal to
+   * it. Only non-leaf pages are read.
+   *
+   * @param key Normalized key
+   * @return  False if the key is certainly not in the index
+   */
+  bool leafMayContain(NormalizedKey key);
+
+ public:
+  /**
+   * BTreeIndex Constructor.
+   * Check to see if the corresponding index file exists. If so, open the file.
+   * If not, create it and insert entries for every tuple in the base relation
+   * using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager
+   * Instance
+   * @param attrByteOffset			Offset of attribute, over which
+   * index is to be built, in the record
+   * @param attrType						Datatype of
+   * attribute over which index is built
+   * @param options             Optional index features
+   */
+  BTreeIndex(const std::string& relationName, std::string& outIndexName,
+             BufMgr* bufMgrIn, const int attrByteOffset,
+             const Datatype attrType,
+             const BTreeOptions& options = BTreeOptions());
+
+  /**
+   * BTreeIndex Destructor.
+   * End any initialized scan, drain the delta buffer, flush index file, after
+   * unpinning any pinned pages, from the buffer manager and delete file
+   * instance thereby closing the index file. Destructor should not throw any exceptions. All exceptions
+   * should be caught in here itself.
+   * */
+  ~BTreeIndex();
+
+  /**
+   * Insert a new entry using the pair <value,rid>.
+   * Start from root to recursively find out the leaf to insert the entry in.
+   *The insertion may cause splitting of leaf node. This splitting will require
+   *addition of new leaf page number entry into the parent non-leaf, which may
+   *in-turn get split. This may continue all the way upto the root causing the
+   *root to get split. If root gets split, metapage needs to be changed
+   *accordingly. Make sure to unpin pages as soon as you can.
+   *With a delta buffer the entry is only added to the buffer, and the tree
+   *is updated when the buffer drains. With message buffers the index file is
+   *only flushed when the index is closed.
+   * @param key			Key to insert, pointer to integer/double/char
+   *string
+   * @param rid			Record ID of a record whose entry is getting
+   *inserted into the index.
+   **/
+  void insertEntry(const void* key, const RecordId rid);
+
+  /**
+   * Delete the entry <key,rid>. With message buffers the delete is only
+   * queued, and it reaches the leaf in a later batch. Deleting an entry that
+   * is not in the index has no effect. Leaves are not merged, so a leaf whose
+   * entries are all deleted stays in the tree empty.
+   *
+   * @param key			Key of the entry, pointer to integer/double/char
+   *string
+   * @param rid			Record ID of the entry
+   **/
+  void deleteEntry(const void* key, const RecordId rid);
+
+  /**
+   * (Re)train the learned routing layer over the current leaves: walk the
+   * leaf chain and fit piecewise linear segments, each within one leaf, that
+   * predict the slot of every key to within the error bound. Segments over a
+   * leaf that changes afterwards are invalidated, and scans for their keys go
+   * through the tree until the layer is trained again. The layer is kept in
+   * memory only.
+   **/
+  void trainLearnedLayer();
+
+  /**
+   * Return the size and accuracy of the learned layer.
+   **/
+  LearnedLayerStats learnedLayerStats() const;
+
+  /**
+   * Begin a filtered scan of the index.  For instance, if the method is called
+   * using ("a",GT,"d",LTE) then we should seek all entries with a value
+   * greater than "a" and less than or equal to "d".
+   * If another scan is already executing, that needs to be ended here.
+   * Set up all the variables for scan. Start from root to find out the leaf
+   *page that contains the first RecordID that satisfies the scan parameters.
+   *Keep that page pinned in the buffer pool.
+   * @param lowVal	Low value of range, pointer to integer / double / char
+   *string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char
+   *string
+   * @param highOp	High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that
+   *satisfies the scan criteria.
+   *An equality probe (k,GTE,k,LTE) on an index with leaf filters is answered
+   *without reading the leaf when the filter rules the key out.
    **/
   void startScan(const void* lowVal, const Operator lowOp, const void* highVal,
                  const Operator highOp);
 
+  /**
+   * Begin a scan over several ranges at once, such as an IN-list of equality
+   * ranges. The ranges must be in ascending order and must not overlap.
+   * Entries are returned by scanNext() in key order, and each leaf is read at
+   * most once: the scan moves along the leaf chain when the next range starts
+   * nearby and re-descends from the root only to skip ahead.
+   * If another scan is already executing, that needs to be ended here.
+   * @param ranges	Ranges to scan
+   * @throws  BadOpcodesException If an operator of any range is invalid
+   * @throws  BadScanrangeException If a range has low > high, or the ranges
+   *are not ascending and disjoint
+   * @throws  NoSuchKeyFoundException If no key in the B+ tree satisfies any
+   *of the ranges.
+   **/
+  void startScan(const std::vector<ScanRange>& ranges);
+
   /**
    * Fetch the record id of the next index entry that matches the scan.
    * Return the next record from current page being scanned. If current page has
@@ -403,6 +1628,137 @@ class BTreeIndex {
    * @throws ScanNotInitializedException If no scan has been initialized.
    **/
   void endScan();
+
+  /**
+   * Scan a range with range-for, without exceptions for running out of
+   * entries or finding none:
+   *
+   *   for (RecordId rid : index.range(&low, GTE, &high, LT)) { ... }
+   *
+   * The scan starts when iteration begins and, like startScan(), ends any
+   * other scan of the index.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of
+   *their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   **/
+  IndexScan range(const void* lowVal, const Operator lowOp,
+                  const void* highVal, const Operator highOp);
+
+  /**
+   * Scan the keys from lowVal to highVal, both included, with range-for.
+   * @throws  BadScanrangeException If lowVal > highval
+   **/
+  IndexScan range(const void* lowVal, const void* highVal);
+
+  /**
+   * Scan several ascending, disjoint ranges with range-for, as one scan.
+   * @throws  BadOpcodesException If an operator of any range is invalid
+   * @throws  BadScanrangeException If a range has low > high, or the ranges
+   *are not ascending and disjoint
+   **/
+  IndexScan range(const std::vector<ScanRange>& ranges);
+};
+
+/**
+ * @brief Entries of an index scan, returned by BTreeIndex::range(). Its
+ * iterators are input iterators: begin() starts the scan, and the scan ends
+ * when the iterator reaches end() or the IndexScan is destroyed. Reaching the
+ * end is a comparison, not an exception.
+ */
+class IndexScan {
+ public:
+  /**
+   * @brief Input iterator over the record ids of a scan.
+   */
+  class iterator {
+   public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef RecordId value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const RecordId* pointer;
+    typedef const RecordId& reference;
+
+    iterator() : scan(NULL) {}
+
+    const RecordId& operator*() const { return rid; }
+    const RecordId* operator->() const { return &rid; }
+
+    /**
+     * Fetch the next entry, becoming equal to end() if there is none.
+     */
+    iterator& operator++();
+
+    bool operator==(const iterator& rhs) const { return scan == rhs.scan; }
+    bool operator!=(const iterator& rhs) const { return scan != rhs.scan; }
+
+   private:
+    friend class IndexScan;
+
+    /**
+     * Scan the iterator reads from; NULL once it is at the end.
+     */
+    IndexScan* scan;
+
+    /**
+     * Record id of the current entry.
+     */
+    RecordId rid;
+  };
+
+  IndexScan(IndexScan&& other);
+  IndexScan(const IndexScan&) = delete;
+  IndexScan& operator=(const IndexScan&) = delete;
+
+  /**
+   * End the scan if it is still executing and no other scan has replaced it.
+   */
+  ~IndexScan();
+
+  /**
+   * Start the scan and fetch its first entry. Starting it again restarts it.
+   */
+  iterator begin();
+
+  iterator end() { return iterator(); }
+
+ private:
+  friend class BTreeIndex;
+
+  IndexScan(BTreeIndex* index, const std::vector<NormalizedRange>& ranges);
+
+  /**
+   * Fetch the next entry, ending the scan if there is none.
+   *
+   * @return  False if no entries are left
+   * @throws  ScanNotInitializedException If another scan has been started on
+   * the index, or the scan ended, since begin()
+   */
+  bool next(RecordId& outRid);
+
+  /**
+   * True if the scan executing on the index is the one begin() started.
+   */
+  bool ownsScan() const;
+
+  /**
+   * Index being scanned.
+   */
+  BTreeIndex* index;
+
+  /**
+   * Normalized ranges to scan.
+   */
+  std::vector<NormalizedRange> ranges;
+
+  /**
+   * True while this object's scan is executing.
+   */
+  bool executing;
+
+  /**
+   * Index's scanGeneration when begin() started this object's scan.
+   */
+  std::uint64_t generation;
 };
 
 }  // namespace badgerdb
@@ -15,100 +15,120 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::uint64_t BufHashTbl::mix(const std::uint32_t fileId, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // finalizer of MurmurHash3 over the 64-bit key (fileId, pageNo)
+  std::uint64_t key = ((std::uint64_t)fileId << 32) | pageNo;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+int BufHashTbl::probe(const std::uint32_t fileId, const PageId pageNo)
+{
+  int index = hash(fileId, pageNo);
+  numLookups++;
+  numProbes++;
+  while (ht[index].fileId &&
+         (ht[index].fileId != fileId || ht[index].pageNo != pageNo))
+	{
+    index = (index + 1) & (HTSIZE - 1);
+    numProbes++;
+  }
+  return index;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(1), numEntries(0), numLookups(0), numProbes(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
+  while (HTSIZE < htSize)
+    HTSIZE *= 2;
+
+  // allocate the array of buckets, all empty
+  ht = new hashBucket[HTSIZE];
   for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+    ht[i].fileId = 0;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
   delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+bool BufHashTbl::tryInsert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
-  }
-
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
+  // keep one bucket empty so that every probe run ends
+  if (numEntries + 1 >= HTSIZE)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  int index = probe(file->id(), pageNo);
+  if (ht[index].fileId)
+    return false;
+
+  ht[index].fileId = file->id();
+  ht[index].pageNo = pageNo;
+  ht[index].frameNo = frameNo;
+  numEntries++;
+  return true;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::find(const File* file, const PageId pageNo, FrameId &frameNo)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  int index = probe(file->id(), pageNo);
+  if (!ht[index].fileId)
+    return false;
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  frameNo = ht[index].frameNo; // return frameNo by reference
+  return true;
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+bool BufHashTbl::tryRemove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  int hole = probe(file->id(), pageNo);
+  if (!ht[hole].fileId)
+    return false;
 
-  while (tmpBuc)
+  // Shift later entries of the probe run back into the hole, unless that
+  // would move one before its home bucket
+  int next = (hole + 1) & (HTSIZE - 1);
+  while (ht[next].fileId)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    }
-		else
+    int home = hash(ht[next].fileId, ht[next].pageNo);
+    if (((next - home) & (HTSIZE - 1)) >= ((next - hole) & (HTSIZE - 1)))
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      ht[hole] = ht[next];
+      hole = next;
     }
+    next = (next + 1) & (HTSIZE - 1);
+  }
+
+  ht[hole].fileId = 0;
+  numEntries--;
+  return true;
+}
+
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  if (!tryInsert(file, pageNo, frameNo))
+  {
+    FrameId present = 0;
+    find(file, pageNo, present);
+    throw HashAlreadyPresentException(file->filename(), pageNo, present);
   }
+}
+
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!find(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::remove(const File* file, const PageId pageNo) {
+  if (!tryRemove(file, pageNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
 }
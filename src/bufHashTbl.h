@@ -12,13 +12,14 @@
 namespace badgerdb {
 
 /**
-* @brief Declarations for buffer pool hash table
+* @brief Declarations for buffer pool hash table. Each bucket is one slot of
+* the table and holds its entry inline.
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * id of the file object (see File::id()), or 0 if the slot is empty
 	 */
-	File *file;
+	std::uint32_t fileId;
 
 	/**
 	 * page number within a file
@@ -29,16 +30,17 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
-* @brief Hash table class to keep track of pages in the buffer pool
+* @brief Hash table class to keep track of pages in the buffer pool. It uses
+* open addressing with linear probing over a flat array of buckets, so a
+* lookup touches one or two cache lines and inserts and removes never
+* allocate. Removal shifts the following entries of the probe run back
+* instead of leaving tombstones. Pages are keyed on the file's id rather than
+* its address, and the key is mixed so that neighbouring pages and files
+* spread over the whole table.
 *
 * @warning This class is not threadsafe.
 */
@@ -46,26 +48,56 @@ class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Size of Hash Table, a power of two
 	 */
   int HTSIZE;
 	/**
-	 * Actual Hash table object
+	 * Actual Hash table object: HTSIZE buckets
 	 */
-  hashBucket**  ht;
+  hashBucket*  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * Number of entries in the table
+	 */
+  int numEntries;
+
+	/**
+	 * Number of lookups, inserts and removes since the last clearStats()
+	 */
+  std::uint64_t numLookups;
+
+	/**
+	 * Number of buckets those operations examined
+	 */
+  std::uint64_t numProbes;
+
+	/**
+	 * returns hash value between 0 and HTSIZE-1 computed using file id and pageNo
 	 *
-	 * @param file   	File object
+	 * @param fileId 	Id of the file object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const std::uint32_t fileId, const PageId pageNo)
+  {
+		return (int)(mix(fileId, pageNo) & (HTSIZE - 1));
+  }
+
+	/**
+	 * Find the bucket holding (fileId, pageNo), or the empty bucket ending its
+	 * probe run, and count the buckets examined.
+	 *
+	 * @param fileId 	Id of the file object
+	 * @param pageNo  Page number in the file
+	 * @return  			Index of the bucket
+	 */
+  int	 probe(const std::uint32_t fileId, const PageId pageNo);
 
  public:
 	/**
-   * Constructor of BufHashTbl class
+   * Constructor of BufHashTbl class. htSize is rounded up to a power of two.
+   * The table holds one entry less than its size, and probe runs stay short
+   * while it is at most half full.
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -74,6 +106,37 @@ class BufHashTbl
 	 */
   ~BufHashTbl(); // destructor
 	
+	/**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo, unless the
+   * page is already present.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+	 * @return  			False if the page already exists in the hash table
+	 */
+  bool tryInsert(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, without throwing
+   * on a miss. Misses are the normal case on the read path.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Set to the frame number if the page is found
+	 * @return  			True if the page entry is in the hash table
+	 */
+  bool find(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * Delete entry (file,pageNo) from hash table, if present.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			False if the page entry is not in the hash table
+	 */
+  bool tryRemove(const File* file, const PageId pageNo);
+
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
 	 *
@@ -104,6 +167,33 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Number of lookups, inserts and removes since the last clearStats().
+	 */
+  std::uint64_t lookups() const { return numLookups; }
+
+	/**
+   * Number of buckets examined by those operations. Divided by lookups(), this
+   * is the mean probe length; 1 means no collisions at all.
+	 */
+  std::uint64_t probes() const { return numProbes; }
+
+	/**
+   * Clear the probe statistics
+	 */
+  void clearStats() { numLookups = numProbes = 0; }
+
+	/**
+   * Mix (fileId, pageNo) into 64 well distributed bits. The table indexes by
+   * the low bits, so callers that split pages over several tables should
+   * choose the table by the high bits.
+	 *
+	 * @param fileId 	Id of the file object
+	 * @param pageNo  Page number in the file
+	 * @return  			Mixed key
+	 */
+  static std::uint64_t mix(const std::uint32_t fileId, const PageId pageNo);
 };
 
 }
@@ -0,0 +1,835 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+// Buffer manager micro-benchmarks. Each benchmark prints one line with the
+// mean cost of an operation. Build with "make bench" and run from src/.
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bufHashTbl.h"
+#include "buffer.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "file.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::string benchFileName = "bench.db";
+
+// Number of files the threads of the multi-file benchmark miss on.
+const int threadFileCount = 8;
+
+typedef std::chrono::steady_clock Clock;
+
+// Results benchmarks compute only so that the compiler keeps their loops.
+volatile long sink;
+
+// Mean nanoseconds per operation since start.
+double nsPerOp(const Clock::time_point start, const long ops) {
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+void report(const char *name, const double ns) {
+  std::printf("%-40s %10.1f ns/op\n", name, ns);
+}
+
+// -----------------------------------------------------------------------------
+// Hash table lookups that miss
+// -----------------------------------------------------------------------------
+
+void benchLookupMiss(File *file, const int frames, const long ops) {
+  BufHashTbl table(frames * 2);
+  for (int i = 0; i < frames; i++) {
+    table.insert(file, i + 1, i);
+  }
+
+  // Probe for pages that are not in the table, as readPage does on a miss
+  FrameId frameNo;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    try {
+      table.lookup(file, frames + 1 + (i % frames), frameNo);
+    } catch (const HashNotFoundException &e) {
+    }
+  }
+  report("lookup miss, exception", nsPerOp(start, ops));
+
+  long found = 0;
+  start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    found += table.find(file, frames + 1 + (i % frames), frameNo);
+  }
+  report("lookup miss, status", nsPerOp(start, ops));
+  if (found != 0) {
+    std::printf("unexpected hit\n");
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Page table probe lengths
+// -----------------------------------------------------------------------------
+
+// Fills the page table the way BufMgr does with runs of consecutive pages
+// from several files, and reports the mean number of buckets a hit and a miss
+// examine.
+void benchProbeLength(const int frames, const int files) {
+  std::vector<BlobFile> blobs;
+  for (int f = 0; f < files; f++) {
+    blobs.push_back(BlobFile::create(benchFileName + std::to_string(f)));
+  }
+
+  BufHashTbl table(frames * 2);
+  for (int i = 0; i < frames; i++) {
+    table.insert(&blobs[i % files], 1 + i / files, i);
+  }
+
+  FrameId frameNo;
+  table.clearStats();
+  for (int i = 0; i < frames; i++) {
+    table.find(&blobs[i % files], 1 + i / files, frameNo);
+  }
+  std::printf("%-40s %10.2f buckets\n", "probe length, hit",
+              (double)table.probes() / table.lookups());
+
+  table.clearStats();
+  for (int i = 0; i < frames; i++) {
+    table.find(&blobs[i % files], 1 + frames + i, frameNo);
+  }
+  std::printf("%-40s %10.2f buckets\n", "probe length, miss",
+              (double)table.probes() / table.lookups());
+}
+
+// -----------------------------------------------------------------------------
+// readPage that misses / hits the buffer pool
+// -----------------------------------------------------------------------------
+
+void benchReadPage(File *file, const int frames, const int pages,
+                   const long ops) {
+  BufMgr bufMgr(frames);
+  Page *page;
+
+  // Cycling over more pages than frames misses on every read
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    PageId pageNo = 1 + i % pages;
+    bufMgr.readPage(file, pageNo, page);
+    bufMgr.unPinPage(file, pageNo, false);
+  }
+  report("readPage miss", nsPerOp(start, ops));
+
+  start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    PageId pageNo = 1 + i % (frames / 2);
+    bufMgr.readPage(file, pageNo, page);
+    bufMgr.unPinPage(file, pageNo, false);
+  }
+  report("readPage hit", nsPerOp(start, ops));
+
+  bufMgr.flushFile(file);
+}
+
+// -----------------------------------------------------------------------------
+// Following swips
+// -----------------------------------------------------------------------------
+
+// Reads the children of a pinned parent page, all in the pool, by page number
+// and through the parent's swips, and reports the cost of each way.
+void benchSwizzle(File *file, const int frames, const long ops) {
+  BufMgr bufMgr(frames);
+  const int children = frames / 2;
+  PageGuard parent = bufMgr.fetchPage(file, 1);
+
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    PageGuard child = bufMgr.fetchPage(file, 2 + i % children);
+  }
+  report("fetchPage hit", nsPerOp(start, ops));
+
+  start = Clock::now();
+  for (long i = 0; i < ops; i++) {
+    const int slot = i % children;
+    PageGuard child = bufMgr.fetchChild(parent, slot, file, 2 + slot);
+  }
+  report("fetchChild hit", nsPerOp(start, ops));
+
+  parent.release();
+  bufMgr.flushFile(file);
+}
+
+// -----------------------------------------------------------------------------
+// Resizing the pool
+// -----------------------------------------------------------------------------
+
+// Grows a pool of frames to sixteen times its size and shrinks it back with
+// the file's pages resident, and reports the cost per frame added or removed.
+void benchResize(File *file, const int frames, const int pages) {
+  BufMgr bufMgr(frames);
+  Page *page;
+  for (int i = 0; i < pages; i++) {
+    bufMgr.readPage(file, 1 + i, page);
+    bufMgr.unPinPage(file, 1 + i, false);
+  }
+
+  Clock::time_point start = Clock::now();
+  bufMgr.resize(frames * 16);
+  report("resize grow, per frame", nsPerOp(start, frames * 15));
+
+  for (int i = 0; i < pages; i++) {
+    bufMgr.readPage(file, 1 + i, page);
+    bufMgr.unPinPage(file, 1 + i, false);
+  }
+  start = Clock::now();
+  bufMgr.resize(frames);
+  report("resize shrink, per frame", nsPerOp(start, frames * 15));
+
+  bufMgr.flushFile(file);
+}
+
+// Grows and shrinks the pool over and over while four threads read random
+// pages, and reports the cost per resize and how many shrinks a page pinned
+// by a reader refused. Every page read is checked to be the page asked for.
+void benchResizeUnderLoad(File *file, const int frames, const int pages) {
+  const int resizes = 100;
+  BufMgr bufMgr(frames);
+  std::atomic<bool> done(false);
+  std::atomic<long> wrong(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < 4; t++) {
+    workers.push_back(std::thread([&, t]() {
+      std::uint32_t seed = 2654435761u * (t + 1);
+      Page *page;
+      for (long i = 0; !done; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        PageId pageNo = 1 + (seed >> 8) % pages;
+        bufMgr.readPage(file, pageNo, page);
+        bufMgr.latchPage(page, false);
+        if (page->page_number() != pageNo) {
+          wrong++;
+        }
+        bufMgr.unlatchPage(page, false);
+        bufMgr.unPinPage(file, pageNo, i % 8 == 0);
+      }
+    }));
+  }
+
+  int refused = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < resizes; i++) {
+    try {
+      bufMgr.resize(i % 2 == 0 ? frames * 16 : frames);
+    } catch (const PagePinnedException &e) {
+      refused++;
+    }
+  }
+  double ns = nsPerOp(start, resizes);
+  done = true;
+  for (std::size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+
+  report("resize under load, per resize", ns);
+  std::printf("%d of %d shrinks refused for a pinned page\n", refused,
+              resizes / 2);
+  if (wrong != 0) {
+    std::printf("%ld reads returned the wrong page\n", wrong.load());
+  }
+  bufMgr.flushFile(file);
+}
+
+// -----------------------------------------------------------------------------
+// File quotas
+// -----------------------------------------------------------------------------
+
+// Scans the file over and over while touching the pages of a small index
+// file now and then, too seldom for them to stay in the pool by recency
+// alone, and reports how many index pages were read again without and with a
+// quota reserving frames for the index and capping the scan.
+void benchQuotas(File *file, const int frames, const int pages,
+                 const long ops) {
+  const int indexPages = frames / 5;
+  const std::string indexName = benchFileName + "index";
+  {
+    PageFile index = PageFile::create(indexName);
+    for (int i = 0; i < indexPages; i++) {
+      PageId pageNo;
+      index.allocatePage(pageNo);
+    }
+
+    for (int useQuota = 0; useQuota < 2; useQuota++) {
+      BufMgr bufMgr(frames);
+      bufMgr.setMaxReadAhead(0);
+      if (useQuota) {
+        bufMgr.setFileQuota(indexName, FileQuota(indexPages, 0, 1));
+        bufMgr.setFileQuota(file->filename(), FileQuota(0, frames / 2));
+      }
+      Page *page;
+      for (long i = 0; i < ops; i++) {
+        PageId pageNo = 1 + i % pages;
+        bufMgr.readPage(file, pageNo, page);
+        bufMgr.unPinPage(file, pageNo, false);
+        if (i % 16 == 0) {
+          PageId indexNo = 1 + (i / 16) % indexPages;
+          bufMgr.readPage(&index, indexNo, page);
+          bufMgr.unPinPage(&index, indexNo, false);
+        }
+      }
+      std::printf("%-40s %10d misses\n",
+                  useQuota ? "index pages, with quotas"
+                           : "index pages, no quotas",
+                  static_cast<int>(bufMgr.getMetrics().files[indexName].misses));
+      bufMgr.flushFile(file);
+      bufMgr.flushFile(&index);
+    }
+  }
+  File::remove(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// Metrics snapshots
+// -----------------------------------------------------------------------------
+
+// Reports what taking a snapshot of the metrics and diffing two snapshots
+// cost, after reads of the file have filled the pool and the counters.
+void benchMetrics(File *file, const int frames, const int pages,
+                  const long ops) {
+  BufMgr bufMgr(frames);
+  Page *page;
+  for (long i = 0; i < ops; i++) {
+    PageId pageNo = 1 + (i * 7) % pages;
+    bufMgr.readPage(file, pageNo, page);
+    bufMgr.unPinPage(file, pageNo, false);
+  }
+
+  const long snapshots = ops / 100;
+  BufMetrics first = bufMgr.getMetrics();
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < snapshots; i++) {
+    sink = bufMgr.getMetrics().stats.accesses;
+  }
+  report("getMetrics", nsPerOp(start, snapshots));
+
+  BufMetrics last = bufMgr.getMetrics();
+  start = Clock::now();
+  for (long i = 0; i < snapshots; i++) {
+    sink = last.since(first).readLatency.total;
+  }
+  report("BufMetrics::since", nsPerOp(start, snapshots));
+
+  bufMgr.flushFile(file);
+}
+
+// -----------------------------------------------------------------------------
+// Threads sharing one buffer pool
+// -----------------------------------------------------------------------------
+
+// Runs ops random reads of the files' pages split over 1 to 32 threads, and
+// reports the throughput for each thread count. Thread t reads file
+// t % files.size(). Every page read is checked to be the page asked for; one
+// read in eight marks the page dirty, so that evictions write pages back
+// while other threads read them.
+void benchThreads(const char *name, const std::vector<File *> &files,
+                  const int frames, const int pages, const long ops) {
+  std::printf("%s, %d frames\n", name, frames);
+  for (int threads = 1; threads <= 32; threads *= 2) {
+    BufMgr bufMgr(frames);
+    std::atomic<long> wrong(0);
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        File *file = files[t % files.size()];
+        std::uint32_t seed = 2654435761u * (t + 1);
+        Page *page;
+        for (long i = t; i < ops; i += threads) {
+          seed = seed * 1664525u + 1013904223u;
+          PageId pageNo = 1 + (seed >> 8) % pages;
+          bufMgr.readPage(file, pageNo, page);
+          bufMgr.latchPage(page, false);
+          if (page->page_number() != pageNo) {
+            wrong++;
+          }
+          bufMgr.unlatchPage(page, false);
+          bufMgr.unPinPage(file, pageNo, i % 8 == 0);
+        }
+      }));
+    }
+    for (std::size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+    }
+    double ns = nsPerOp(start, ops);
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "  %2d threads", threads);
+    std::printf("%-40s %10.2f Mops/s\n", label, 1000.0 / ns);
+    if (wrong != 0) {
+      std::printf("%ld reads returned the wrong page\n", wrong.load());
+    }
+    for (std::size_t f = 0; f < files.size(); f++) {
+      bufMgr.flushFile(files[f]);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Pool memory pages
+// -----------------------------------------------------------------------------
+
+// Counts the data TLB misses of this thread from construction to stop(), if
+// the kernel lets the process count them.
+class TlbMissCounter {
+ public:
+  TlbMissCounter() {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~TlbMissCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  // Misses so far, or -1 if they cannot be counted.
+  long stop() {
+    long long misses;
+    if (fd_ < 0 || read(fd_, &misses, sizeof(misses)) != sizeof(misses)) {
+      return -1;
+    }
+    return misses;
+  }
+
+ private:
+  int fd_;
+};
+
+// Reads a word at a random offset of random frames, as callers do with the
+// pages they pin, in a large pool mapped with each kind of memory page, and
+// reports the cost of a read and the data TLB misses per read.
+void benchPoolPages(const int frames, const long ops) {
+  const PoolPages kinds[] = {SMALL_PAGES, TRANSPARENT_HUGE_PAGES, HUGE_PAGES};
+  const char *kindNames[] = {"small pages", "transparent huge", "huge pages"};
+
+  for (int k = 0; k < 3; k++) {
+    BufMgr bufMgr(frames, CLOCK, kinds[k]);
+    const char *pool = reinterpret_cast<const char *>(bufMgr.bufPool);
+
+    std::uint32_t seed = 4;
+    long sum = 0;
+    TlbMissCounter counter;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      std::size_t frame = (seed >> 8) % frames;
+      std::size_t offset = (seed & 0xff) * 32;
+      sum += pool[frame * sizeof(Page) + offset];
+    }
+    double ns = nsPerOp(start, ops);
+    long misses = counter.stop();
+    sink = sum;
+
+    char label[64];
+    if (misses < 0) {
+      std::snprintf(label, sizeof(label), "pool of %d MB, %s",
+                    (int)(frames * sizeof(Page) >> 20), kindNames[k]);
+    } else {
+      std::snprintf(label, sizeof(label), "pool of %d MB, %s, %.2f TLB miss",
+                    (int)(frames * sizeof(Page) >> 20), kindNames[k],
+                    (double)misses / ops);
+    }
+    report(label, ns);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// flushFile of a small file
+// -----------------------------------------------------------------------------
+
+// Reads the first pages of the file into pools of growing size, and reports
+// the time flushFile takes to write them back and free their frames.
+void benchFlushFile(File *file, const int pages, const int rounds) {
+  for (int frames = 1024; frames <= 16384; frames *= 4) {
+    BufMgr bufMgr(frames);
+    Page *page;
+
+    Clock::duration flushing = Clock::duration::zero();
+    for (int r = 0; r < rounds; r++) {
+      for (PageId pageNo = 1; pageNo <= (PageId)pages; pageNo++) {
+        bufMgr.readPage(file, pageNo, page);
+        bufMgr.unPinPage(file, pageNo, true);
+      }
+      Clock::time_point start = Clock::now();
+      bufMgr.flushFile(file);
+      flushing += Clock::now() - start;
+    }
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "flushFile, %d pages, %5d frames",
+                  pages, frames);
+    report(label,
+           std::chrono::duration<double, std::nano>(flushing).count() /
+               rounds);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Read-ahead
+// -----------------------------------------------------------------------------
+
+// Reads the file's pages in order, every page and every third page, through
+// the pool and through a ring, with and without read-ahead, and reports the
+// cost of a page and how many pages were read ahead.
+void benchReadAhead(File *file, const int frames, const int pages) {
+  for (int stride = 1; stride <= 3; stride += 2) {
+    for (int useRing = 0; useRing < 2; useRing++) {
+      for (int ahead = 0; ahead < 2; ahead++) {
+        BufMgr bufMgr(frames);
+        BufRing ring(16);
+        if (!ahead) {
+          bufMgr.setMaxReadAhead(0);
+        }
+        Page *page;
+
+        Clock::time_point start = Clock::now();
+        for (PageId pageNo = 1; pageNo <= (PageId)pages; pageNo += stride) {
+          bufMgr.readPage(file, pageNo, page, useRing ? &ring : NULL);
+          bufMgr.unPinPage(file, pageNo, false);
+        }
+        double ns = nsPerOp(start, pages / stride);
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "stride %d %s, %4d read ahead",
+                      stride, useRing ? "ring" : "pool",
+                      static_cast<int>(bufMgr.getBufStats().readaheads.load()));
+        report(label, ns);
+        bufMgr.flushFile(file);
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Pinning batches of pages
+// -----------------------------------------------------------------------------
+
+// Pins batches of 16 pages, first a run of consecutive pages and then pages
+// spread over the file, one readPage at a time and with one readPages, and
+// reports the cost of a page. Every page is checked to be the one asked for.
+void benchReadPages(File *file, const int frames, const int pages,
+                    const long batches) {
+  const int batch = 16;
+  for (int spread = 0; spread < 2; spread++) {
+    for (int vector = 0; vector < 2; vector++) {
+      BufMgr bufMgr(frames);
+      bufMgr.setMaxReadAhead(0);
+      PageId pageNos[batch];
+      Page *batchPages[batch];
+      long wrong = 0;
+
+      std::uint32_t seed = 5;
+      Clock::time_point start = Clock::now();
+      for (long b = 0; b < batches; b++) {
+        for (int i = 0; i < batch; i++) {
+          seed = seed * 1664525u + 1013904223u;
+          pageNos[i] = spread ? 1 + (seed >> 8) % pages
+                              : 1 + (b * batch + i) % pages;
+        }
+        if (vector) {
+          bufMgr.readPages(file, pageNos, batch, batchPages);
+        } else {
+          for (int i = 0; i < batch; i++) {
+            bufMgr.readPage(file, pageNos[i], batchPages[i]);
+          }
+        }
+        for (int i = 0; i < batch; i++) {
+          wrong += batchPages[i]->page_number() != pageNos[i];
+          bufMgr.unPinPage(file, pageNos[i], false);
+        }
+      }
+      double ns = nsPerOp(start, batches * batch);
+
+      char label[64];
+      std::snprintf(label, sizeof(label), "%s, %s",
+                    spread ? "spread pages" : "consecutive pages",
+                    vector ? "readPages" : "readPage");
+      report(label, ns);
+      if (wrong != 0) {
+        std::printf("%ld pages were not the page asked for\n", wrong);
+      }
+      bufMgr.flushFile(file);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Background writer
+// -----------------------------------------------------------------------------
+
+// Runs random reads of the file's pages, dirtying half of them, without and
+// with the background writer, and reports how many of the misses had to write
+// a dirty victim back first. With thinkUs > 0 the reader sleeps that long
+// between requests, as a server waiting on its clients does, and only the
+// time spent in the buffer manager is reported; the writer then runs while
+// the reader is idle instead of competing with it for the CPU.
+void benchWriter(File *file, const int frames, const int pages,
+                 const long ops, const int thinkUs) {
+  for (int useWriter = 0; useWriter < 2; useWriter++) {
+    BufMgr bufMgr(frames);
+    if (useWriter) {
+      bufMgr.startWriter(frames / 4, 1);
+    }
+    Page *page;
+
+    std::uint32_t seed = 3;
+    std::chrono::duration<double, std::nano> busy(0);
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      PageId pageNo = 1 + (seed >> 8) % pages;
+      Clock::time_point request = Clock::now();
+      bufMgr.readPage(file, pageNo, page);
+      bufMgr.unPinPage(file, pageNo, i % 2 == 0);
+      if (thinkUs > 0) {
+        busy += Clock::now() - request;
+        std::this_thread::sleep_for(std::chrono::microseconds(thinkUs));
+      }
+    }
+    double ns = thinkUs > 0 ? busy.count() / ops : nsPerOp(start, ops);
+    bufMgr.stopWriter();
+
+    const BufStats &stats = bufMgr.getBufStats();
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s%s, %4.1f%% dirty victims",
+                  thinkUs > 0 ? "idle, " : "",
+                  useWriter ? "with writer" : "no writer",
+                  100.0 * (stats.diskwrites - stats.writerwrites) /
+                      stats.diskreads);
+    report(label, ns);
+    bufMgr.flushFile(file);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Replacement policies
+// -----------------------------------------------------------------------------
+
+// Probes of an index region twice the size of the pool, skewed towards its
+// first pages, interrupted by full scans of the rest of the file.
+std::vector<PageId> traceProbesAndScans(const int frames, const int pages,
+                                        const long ops) {
+  std::vector<PageId> trace;
+  const int hot = 2 * frames;
+  std::uint32_t seed = 1;
+  while ((long)trace.size() < ops) {
+    for (int i = 0; i < 20 * frames; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      double u = (seed >> 8) / 16777216.0;
+      trace.push_back(1 + (PageId)(hot * u * u * u));
+    }
+    for (int pageNo = hot + 1; pageNo <= pages; pageNo++) {
+      trace.push_back(pageNo);
+    }
+  }
+  trace.resize(ops);
+  return trace;
+}
+
+// Accesses over the whole file, skewed towards its first pages.
+std::vector<PageId> traceSkewed(const int pages, const long ops) {
+  std::vector<PageId> trace;
+  std::uint32_t seed = 2;
+  for (long i = 0; i < ops; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    double u = (seed >> 8) / 16777216.0;
+    trace.push_back(1 + (PageId)(pages * u * u * u));
+  }
+  return trace;
+}
+
+// Repeated sequential passes over a fifth more pages than the pool holds.
+std::vector<PageId> traceLoop(const int frames, const long ops) {
+  std::vector<PageId> trace;
+  for (long i = 0; i < ops; i++) {
+    trace.push_back(1 + i % (frames * 6 / 5));
+  }
+  return trace;
+}
+
+// Replays a trace with every replacement policy, and reports the hit ratio
+// and the throughput of each. Nothing is read ahead, so that every disk read
+// is a miss of the trace.
+void benchPolicies(const char *name, File *file, const int frames,
+                   const std::vector<PageId> &trace) {
+  const Replacement policies[] = {CLOCK, LRU2, TWOQ, ARC};
+  const char *policyNames[] = {"CLOCK", "LRU-2", "2Q", "ARC"};
+
+  std::printf("%s, %d frames\n", name, frames);
+  for (int p = 0; p < 4; p++) {
+    BufMgr bufMgr(frames, policies[p]);
+    bufMgr.setMaxReadAhead(0);
+    Page *page;
+
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      bufMgr.readPage(file, trace[i], page);
+      bufMgr.unPinPage(file, trace[i], false);
+    }
+    double ns = nsPerOp(start, trace.size());
+
+    const BufStats &stats = bufMgr.getBufStats();
+    char label[64];
+    std::snprintf(label, sizeof(label), "  %-6s hit ratio %5.3f",
+                  policyNames[p], 1.0 - (double)stats.diskreads / stats.accesses);
+    std::printf("%-40s %10.2f Mops/s\n", label, 1000.0 / ns);
+    bufMgr.flushFile(file);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Sequential scans through a ring
+// -----------------------------------------------------------------------------
+
+// Warms the pool with a hot set of half as many pages as frames, scans the
+// rest of the file with and without a ring, and reports how many hot pages
+// the scan evicted. Nothing is read ahead, so that every hot page evicted
+// is read again.
+void benchScanRing(File *file, const int frames, const int pages) {
+  const int hot = frames / 2;
+  for (int useRing = 0; useRing < 2; useRing++) {
+    BufMgr bufMgr(frames);
+    bufMgr.setMaxReadAhead(0);
+    BufRing ring(16);
+    Page *page;
+
+    for (int pass = 0; pass < 2; pass++) {
+      for (PageId pageNo = 1; pageNo <= (PageId)hot; pageNo++) {
+        bufMgr.readPage(file, pageNo, page);
+        bufMgr.unPinPage(file, pageNo, false);
+      }
+    }
+
+    Clock::time_point start = Clock::now();
+    for (PageId pageNo = hot + 1; pageNo <= (PageId)pages; pageNo++) {
+      bufMgr.readPage(file, pageNo, page, useRing ? &ring : NULL);
+      bufMgr.unPinPage(file, pageNo, false);
+    }
+    double ns = nsPerOp(start, pages - hot);
+
+    bufMgr.clearBufStats();
+    for (PageId pageNo = 1; pageNo <= (PageId)hot; pageNo++) {
+      bufMgr.readPage(file, pageNo, page);
+      bufMgr.unPinPage(file, pageNo, false);
+    }
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "scan %s, %d/%d hot pages evicted",
+                  useRing ? "with ring" : "in pool",
+                  static_cast<int>(bufMgr.getBufStats().diskreads.load()), hot);
+    report(label, ns);
+    bufMgr.flushFile(file);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int frames = 100;
+  const int pages = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const long ops = argc > 2 ? std::atol(argv[2]) : 200000;
+
+  try {
+    File::remove(benchFileName);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    PageFile file = PageFile::create(benchFileName);
+    for (int i = 0; i < pages; i++) {
+      PageId pageNo;
+      file.allocatePage(pageNo);
+    }
+
+    std::printf("%d frames, %d pages, %ld operations\n", frames, pages, ops);
+    benchLookupMiss(&file, frames, ops);
+    benchReadPage(&file, frames, pages, ops);
+    benchMetrics(&file, frames, pages, ops);
+    benchSwizzle(&file, frames, ops);
+    benchResize(&file, frames * 10, pages);
+    benchResizeUnderLoad(&file, frames * 10, pages);
+    benchQuotas(&file, frames, pages, ops);
+    benchScanRing(&file, frames, pages);
+    benchReadAhead(&file, frames, pages);
+    benchReadPages(&file, frames, pages, ops / 100);
+    benchWriter(&file, frames, pages, ops, 0);
+    benchWriter(&file, frames, pages, ops / 20, 50);
+    benchFlushFile(&file, 8, 1000);
+    benchPoolPages(65536, ops * 10);
+    benchPolicies("probes and scans", &file, frames,
+                  traceProbesAndScans(frames, pages, ops));
+    benchPolicies("skewed", &file, frames, traceSkewed(pages, ops));
+    benchPolicies("loop", &file, frames, traceLoop(frames, ops));
+    std::vector<File *> oneFile(1, &file);
+    benchThreads("threads, all hits", oneFile, 2048, pages, ops);
+    benchThreads("threads, mostly misses", oneFile, 256, pages, ops);
+
+    // Threads missing on different files do not share an I/O latch
+    std::vector<PageFile> threadFiles;
+    std::vector<File *> manyFiles;
+    for (int f = 0; f < threadFileCount; f++) {
+      std::string name = benchFileName + "t" + std::to_string(f);
+      try {
+        File::remove(name);
+      } catch (const FileNotFoundException &e) {
+      }
+      threadFiles.push_back(PageFile::create(name));
+      for (int i = 0; i < pages; i++) {
+        PageId pageNo;
+        threadFiles.back().allocatePage(pageNo);
+      }
+    }
+    for (int f = 0; f < threadFileCount; f++) {
+      manyFiles.push_back(&threadFiles[f]);
+    }
+    benchThreads("threads, mostly misses, 8 files", manyFiles, 256, pages,
+                 ops);
+  }
+  for (int f = 0; f < threadFileCount; f++) {
+    File::remove(benchFileName + "t" + std::to_string(f));
+  }
+  benchProbeLength(frames, 4);
+  for (int f = 0; f < 4; f++) {
+    File::remove(benchFileName + std::to_string(f));
+  }
+
+  File::remove(benchFileName);
+  return 0;
+}
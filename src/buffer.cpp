@@ -7,39 +7,355 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
 
 namespace badgerdb { 
 
+/**
+ * Largest number of page table partitions
+ */
+static const std::uint32_t MAXPARTITIONS = 64;
+
+/**
+ * Pages first read ahead for a stream of misses
+ */
+static const std::uint32_t MINREADAHEAD = 4;
+
+/**
+ * Most pages read ahead at once
+ */
+static const std::uint32_t MAXREADAHEAD = 32;
+
+/**
+ * Largest distance between misses, in pages, that is taken for a stream
+ */
+static const std::int64_t MAXSTRIDE = 64;
+
+/**
+ * Size of a huge page on x86-64; mappings are rounded up to a multiple of it
+ */
+static const std::size_t HUGEPAGESIZE = 2 * 1024 * 1024;
+
+/**
+ * One call in this many is timed; reading the clock twice costs about as much
+ * as a buffer pool hit
+ */
+static const std::uint32_t LATENCYSAMPLE = 32;
+
+/**
+ * Counts the time from its construction to its destruction as the latency of
+ * one operation, however the operation ends. Only one operation in
+ * LATENCYSAMPLE on each thread is timed.
+ */
+class LatencyTimer
+{
+ private:
+  LatencyRecorder* recorder;
+  std::chrono::steady_clock::time_point start;
+
+ public:
+  explicit LatencyTimer(LatencyRecorder& sampled)
+  	: recorder(NULL)
+  {
+  	static thread_local std::uint32_t calls = 0;
+  	if (calls++ % LATENCYSAMPLE == 0)
+		{
+  		recorder = &sampled;
+  		start = std::chrono::steady_clock::now();
+  	}
+  }
+
+  ~LatencyTimer()
+  {
+  	if (recorder != NULL)
+  		recorder->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+  			std::chrono::steady_clock::now() - start).count());
+  }
+};
+
+/**
+ * Most frames a buffer pool can grow to without a larger initial size; only
+ * address space is reserved for them until they are used
+ */
+static const std::uint32_t MAXFRAMES = 1 << 20;
+
+/**
+ * Reserve address space for the buffer pool, without memory behind it.
+ *
+ * @param bytes   	Bytes wanted; rounded up to a whole number of huge pages
+ * @return  			Start of the space, aligned to a huge page
+ * @throws std::bad_alloc If the space cannot be reserved
+ */
+static void* reservePool(std::size_t& bytes)
+{
+  bytes = (bytes + HUGEPAGESIZE - 1) / HUGEPAGESIZE * HUGEPAGESIZE;
+
+  // reserve a huge page more than needed and trim both ends, so that the
+  // kernel can back every huge page of the space
+  char* start = static_cast<char*>(mmap(NULL, bytes + HUGEPAGESIZE, PROT_NONE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+  if (start == MAP_FAILED)
+  	throw std::bad_alloc();
+  char* aligned = start + (HUGEPAGESIZE - reinterpret_cast<std::uintptr_t>(start) % HUGEPAGESIZE) % HUGEPAGESIZE;
+  if (aligned > start)
+  	munmap(start, aligned - start);
+  if (aligned < start + HUGEPAGESIZE)
+  	munmap(aligned + bytes, start + HUGEPAGESIZE - aligned);
+  return aligned;
+}
+
+/**
+ * Put memory behind part of the space reserved for the buffer pool.
+ *
+ * @param addr		Start of the part, aligned to a huge page
+ * @param bytes   	Bytes in the part, a multiple of a huge page
+ * @param pages		Kind of memory pages to map with
+ * @param interleave	True to interleave the memory over the NUMA nodes the process may use
+ * @throws std::bad_alloc If no memory can be mapped
+ */
+static void commitPool(void* addr, const std::size_t bytes, const PoolPages pages, const bool interleave)
+{
+  if (bytes == 0)
+  	return;
+
+  void* mapped = MAP_FAILED;
+  if (pages == HUGE_PAGES)
+  	mapped = mmap(addr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+  if (mapped == MAP_FAILED)
+	{
+  	mapped = mmap(addr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  	if (mapped == MAP_FAILED)
+  		throw std::bad_alloc();
+  	madvise(addr, bytes, pages == SMALL_PAGES ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+  }
+
+  // the policy only applies to pages not touched yet, so it is set before
+  // any frame is constructed; without NUMA support it is simply not set
+  if (interleave)
+	{
+  	unsigned long nodes[16] = {0};
+  	const unsigned long maxNode = sizeof(nodes) * 8;
+  	if (syscall(SYS_get_mempolicy, NULL, nodes, maxNode, NULL, MPOL_F_MEMS_ALLOWED) == 0)
+  		syscall(SYS_mbind, addr, bytes, MPOL_INTERLEAVE, nodes, maxNode, 0);
+  }
+}
+
+/**
+ * Give back the memory behind part of the space reserved for the buffer pool,
+ * keeping the space reserved.
+ *
+ * @param addr		Start of the part, aligned to a huge page
+ * @param bytes   	Bytes in the part, a multiple of a huge page
+ */
+static void decommitPool(void* addr, const std::size_t bytes)
+{
+  if (bytes > 0)
+  	mmap(addr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+}
+
+/**
+ * Bytes of reserved space that must have memory behind them to hold a number
+ * of objects
+ */
+static std::size_t committedBytes(const std::uint32_t count, const std::size_t size)
+{
+  return (count * size + HUGEPAGESIZE - 1) / HUGEPAGESIZE * HUGEPAGESIZE;
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, const Replacement replacement, const PoolPages pages, const bool interleave)
+	: numBufs(0), reservedBufs(std::max(bufs, MAXFRAMES)), pageKind(pages), interleavePool(interleave),
+	  writerStop(false), hasQuotas(false), maxReadAhead(std::min(MAXREADAHEAD, bufs / 8)) {
+  // the frames stay where they are for the life of the buffer manager, so
+  // the space for every frame it may grow to is reserved up front
+	descTableBytes = reservedBufs * sizeof(BufDesc);
+	bufDescTable = static_cast<BufDesc*>(reservePool(descTableBytes));
+  poolBytes = reservedBufs * sizeof(Page);
+  bufPool = static_cast<Page*>(reservePool(poolBytes));
+  addFrames(bufs);
+
+  // one partition of the page table per few hundred frames, so that threads
+  // working on different pages rarely wait for the same latch
+  numPartitions = 1;
+  while (numPartitions < MAXPARTITIONS && numPartitions * 512 <= bufs)
+  	numPartitions *= 2;
+  partitions = new BufPartition[numPartitions];
+  sizePageTable();
+
+  policy = ReplacementPolicy::create(replacement, bufs, bufDescTable);
+}
+
+void BufMgr::addFrames(const std::uint32_t bufs)
+{
+  const std::size_t descsMapped = committedBytes(numBufs, sizeof(BufDesc));
+  commitPool(reinterpret_cast<char*>(bufDescTable) + descsMapped,
+             committedBytes(bufs, sizeof(BufDesc)) - descsMapped, pageKind, interleavePool);
+  const std::size_t pagesMapped = committedBytes(numBufs, sizeof(Page));
+  commitPool(reinterpret_cast<char*>(bufPool) + pagesMapped,
+             committedBytes(bufs, sizeof(Page)) - pagesMapped, pageKind, interleavePool);
 
-  for (FrameId i = 0; i < bufs; i++) 
+  for (FrameId i = numBufs; i < bufs; i++)
   {
+  	new (&bufDescTable[i]) BufDesc();
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
+  	new (&bufPool[i]) Page();
+  }
+  numBufs = bufs;
+}
+
+void BufMgr::removeFrames(const std::uint32_t bufs)
+{
+  for (FrameId i = bufs; i < numBufs; i++)
+	{
+  	bufDescTable[i].~BufDesc();
+  	bufPool[i].~Page();
+  }
+
+  const std::size_t descsKept = committedBytes(bufs, sizeof(BufDesc));
+  decommitPool(reinterpret_cast<char*>(bufDescTable) + descsKept,
+               committedBytes(numBufs, sizeof(BufDesc)) - descsKept);
+  const std::size_t pagesKept = committedBytes(bufs, sizeof(Page));
+  decommitPool(reinterpret_cast<char*>(bufPool) + pagesKept, committedBytes(numBufs, sizeof(Page)) - pagesKept);
+  numBufs = bufs;
+}
+
+void BufMgr::sizePageTable()
+{
+  // each partition has room for four times its share of the frames, so it
+  // never fills up when pages spread unevenly and probe runs stay short
+  int htsize = numBufs * 4 / numPartitions;
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+  	BufHashTbl* table = new BufHashTbl (htsize);  // allocate the buffer hash table
+  	for (std::unordered_map<std::uint32_t, std::map<PageId, FrameId> >::const_iterator pages =
+  	       partitions[i].filePages.begin(); pages != partitions[i].filePages.end(); ++pages)
+		{
+  		for (std::map<PageId, FrameId>::const_iterator it = pages->second.begin(); it != pages->second.end(); ++it)
+  			table->insert(bufDescTable[it->second].file, it->first, it->second);
+  	}
+  	delete partitions[i].table;
+  	partitions[i].table = table;
+  }
+}
+
+void BufMgr::setFileQuota(const std::string& filename, const FileQuota& quota)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  FileQuotaState* state;
+  bool added;
+  {
+    std::lock_guard<std::mutex> guard(quotaLatch);
+    added = fileQuotas.find(filename) == fileQuotas.end();
+    state = &fileQuotas[filename];
+    state->minFrames = quota.minFrames;
+    state->maxFrames = quota.maxFrames;
+    state->priority = quota.priority;
+    hasQuotas = true;
+  }
+  if (! added)
+    return;
+
+  // pages of the file read before it had a quota count towards it from now
+  // on; a frame's page cannot change while the frame is taken over
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    BufDesc* tmpbuf = &(bufDescTable[i]);
+    tmpbuf->acquire();
+    if (tmpbuf->valid && tmpbuf->quota == NULL && tmpbuf->file->filename() == filename)
+    {
+      tmpbuf->quota = state;
+      state->resident++;
+    }
+    tmpbuf->release();
   }
+}
+
+void BufMgr::resize(const std::uint32_t bufs)
+{
+  if (bufs == 0 || bufs > reservedBufs)
+  	throw BufferExceededException();
 
-  bufPool = new Page[bufs];
+  // the writer looks at every frame, so it waits out the resize; it is
+  // stopped before other calls are held back, as it makes calls itself
+  const bool writing = writer.joinable();
+  stopWriter();
+  resizeLatch.lock();
+  try
+	{
+  	// a pinned page has to stay where it is, so the pool shrinks only if no
+  	// page in the frames to remove is pinned
+  	for (FrameId i = bufs; i < numBufs; i++)
+		{
+  		BufDesc* tmpbuf = &(bufDescTable[i]);
+  		if (tmpbuf->valid && tmpbuf->pinCnt > 0)
+  			throw PagePinnedException(tmpbuf->file->filename(), tmpbuf->pageNo, i);
+  	}
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  	for (FrameId i = bufs; i < numBufs; i++)
+		{
+  		BufDesc* tmpbuf = &(bufDescTable[i]);
+  		if (! tmpbuf->valid)
+  			continue;
+  		if (tmpbuf->dirty)
+			{
+  			bufStats.diskwrites++;
+  			bufStats.dirtyevictions++;
+  			std::lock_guard<std::mutex> ioGuard(tmpbuf->file->ioLatch());
+  			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+  		}
+  		else
+  			bufStats.cleanevictions++;
 
-  clockHand = bufs - 1;
+  		BufPartition& part = partitionOf(tmpbuf->file, tmpbuf->pageNo);
+  		{
+  			std::lock_guard<std::mutex> guard(part.latch);
+  			part.remove(tmpbuf->file, tmpbuf->pageNo);
+  		}
+  		dropSwips(i);
+  		tmpbuf->Clear();
+  		policy->freed(i);
+  	}
+
+  	if (bufs < numBufs)
+  		removeFrames(bufs);
+  	else
+  		addFrames(bufs);
+  	policy->resize(bufs);
+  	sizePageTable();
+  }
+  catch (...)
+	{
+  	resizeLatch.unlock();
+  	if (writing)
+  		startWriter(writerMaxPages, writerIntervalMs);
+  	throw;
+  }
+  resizeLatch.unlock();
+
+  if (writing)
+  	startWriter(writerMaxPages, writerIntervalMs);
 }
 
 
 BufMgr::~BufMgr() {
+  stopWriter();
+
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
@@ -50,113 +366,699 @@ BufMgr::~BufMgr() {
   	}
   }
 
-	delete hashTable;
-  delete [] bufDescTable;
-  delete [] bufPool;
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+		delete partitions[i].table;
+	delete [] partitions;
+	delete policy;
+  removeFrames(0);
+  munmap(bufDescTable, descTableBytes);
+  munmap(bufPool, poolBytes);
+}
+
+void BufMgr::allocBuf(FrameId & frame, FileQuotaState* quota) 
+{
+  // quotas give way before the pool is taken to be full
+  FrameChoice choice = choiceFor(quota);
+  if (pickFrame(frame, false, quota, choice))
+    return;
+  if (choice == ANY_FRAME || !pickFrame(frame, false, quota, ANY_FRAME))
+  {
+    // full buffer pool
+    throw BufferExceededException();
+  }
+} // end allocBuf
+
+bool BufMgr::allocCleanBuf(FrameId & frame, FileQuotaState* quota)
+{
+  // a page nobody asked for yet never overrides a quota
+  return pickFrame(frame, true, quota, choiceFor(quota));
+}
+
+BufMgr::FrameChoice BufMgr::choiceFor(const FileQuotaState* quota)
+{
+  if (! hasQuotas)
+    return ANY_FRAME;
+  if (quota != NULL && quota->maxFrames > 0 && quota->resident >= quota->maxFrames)
+    return OWN_FRAME;
+  return BY_QUOTA;
+}
+
+bool BufMgr::pickFrame(FrameId & frame, const bool cleanOnly, const FileQuotaState* quota, const FrameChoice choice)
+{
+  // the replacement policy proposes frames until one can be taken over
+  int offered = 0;
+  bool found = policy->pickVictim([this, &offered, cleanOnly, quota, choice](FrameId frameNo)
+                                  {
+                                    offered++;
+                                    return takeFrame(frameNo, cleanOnly, quota, choice);
+                                  }, frame);
+  bufStats.sweeps++;
+  bufStats.sweepframes += offered;
+  return found;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+bool BufMgr::takeFrame(const FrameId frameNo, const bool cleanOnly, const FileQuotaState* quota,
+                       const FrameChoice choice)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  BufDesc* tmpbuf = &(bufDescTable[frameNo]);
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  // skip frames that are pinned or that another thread is taking over
+  if (cleanOnly && tmpbuf->dirty)
+    return false;
+  if (tmpbuf->pinCnt > 0 || tmpbuf->busy.exchange(true))
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    bufStats.pinwaits++;
+    return false;
+  }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+  // the page's file and quota are stable now
+  bool allowed = true;
+  if (choice == OWN_FRAME)
+    allowed = tmpbuf->valid && tmpbuf->quota == quota;
+  else if (choice == BY_QUOTA && tmpbuf->quota != NULL)
+  {
+    if (tmpbuf->quota != quota && tmpbuf->quota->resident <= tmpbuf->quota->minFrames)
+      allowed = false;
+    else if (tmpbuf->chances > 0)
     {
-      break;
+      tmpbuf->chances--;
+      allowed = false;
     }
+  }
+  if (allowed && evictPage(frameNo))
+    return true;
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
-    {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
-    }
-    else
-    {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
-    }
+  // kept by its quota, or pinned or referenced since it was proposed
+  tmpbuf->release();
+  return false;
+}
+
+FileQuotaState* BufMgr::quotaOf(const File* file)
+{
+  if (! hasQuotas)
+    return NULL;
+  std::lock_guard<std::mutex> guard(quotaLatch);
+  std::map<std::string, FileQuotaState>::iterator it = fileQuotas.find(file->filename());
+  return it != fileQuotas.end() ? &it->second : NULL;
+}
+
+bool BufMgr::evictPage(const FrameId frameNo)
+{
+  BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+
+  // if invalid, use frame
+  if (! tmpbuf->valid)
+    return true;
+
+  // nobody can pin the page while its partition is latched
+  BufPartition& part = partitionOf(tmpbuf->file, tmpbuf->pageNo);
+  std::lock_guard<std::mutex> guard(part.latch);
+  if (tmpbuf->pinCnt > 0 || tmpbuf->refbit)
+    return false;
+
+  // flush any existing changes to disk if necessary; this happens
+  // before the page leaves the page table, so that no thread can read
+  // the page from disk before it has been written
+  if (tmpbuf->dirty)
+  {
+    bufStats.diskwrites++;
+    bufStats.dirtyevictions++;
+    std::lock_guard<std::mutex> ioGuard(tmpbuf->file->ioLatch());
+    tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[frameNo]);
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  else
+    bufStats.cleanevictions++;
+
+  // remove previous entry from hash table
+  part.remove(tmpbuf->file, tmpbuf->pageNo);
+
+  //Reset all the BufDesc entry for the frame before returning the frame
+  dropSwips(frameNo);
+  tmpbuf->Clear();
+  return true;
+}
+
+std::uint32_t BufMgr::allocRingBuf(BufRing* ring, FrameId & frame, FileQuotaState* quota)
+{
+  // fill the ring from the pool first
+  if (ring->frames.size() < ring->size)
   {
-    throw BufferExceededException();
+    allocBuf(frame, quota);
+    ring->frames.push_back(frame);
+    ring->files.push_back(NULL);
+    ring->pageNos.push_back(static_cast<PageId>(Page::INVALID_NUMBER));
+    return ring->frames.size() - 1;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  std::uint32_t slot = ring->next;
+  ring->next = (ring->next + 1) % ring->size;
+
+  // the pool may have shrunk since the slot was filled
+  if (ring->frames[slot] >= numBufs)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    allocBuf(frame, quota);
+    ring->frames[slot] = frame;
+    return slot;
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  // reuse the slot's frame if it still holds the page the ring read into it
+  BufDesc* tmpbuf = &(bufDescTable[ring->frames[slot]]);
+  if (tmpbuf->pinCnt == 0 && !tmpbuf->busy.exchange(true))
+  {
+    if (tmpbuf->valid && tmpbuf->file == ring->files[slot] && tmpbuf->pageNo == ring->pageNos[slot] &&
+        evictPage(ring->frames[slot]))
+    {
+      policy->taken(ring->frames[slot]);
+      frame = ring->frames[slot];
+      return slot;
+    }
+    tmpbuf->release();
+  }
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+  // otherwise leave the frame to the pool and take another
+  allocBuf(frame, quota);
+  ring->frames[slot] = frame;
+  return slot;
+}
+
+void BufMgr::installPage(File* file, const PageId pageNo, FrameId &frameNo, const bool cold,
+                         FileQuotaState* quota)
+{
+  BufPartition& part = partitionOf(file, pageNo);
+  std::unique_lock<std::mutex> guard(part.latch);
+
+  FrameId existing;
+  if (part.table->find(file, pageNo, existing))
+  {
+    // another thread read the page first; use its frame
+    bufDescTable[existing].pinCnt++;
+    guard.unlock();
+
+    policy->freed(frameNo);
+    bufDescTable[frameNo].release();
+    if (!cold)
+      policy->accessed(existing);
+    frameNo = existing;
+    return;
+  }
+
+  // set up the entry properly
+  bufDescTable[frameNo].Set(file, pageNo, quota);
+
+  // insert in the hash table
+  part.insert(file, pageNo, frameNo);
+  guard.unlock();
+
+  // the policy learns of the page before anyone else can take the frame over
+  policy->loaded(frameNo, file, pageNo, cold);
+  bufDescTable[frameNo].release();
+}
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufRing* ring)
 {
+  SharedLatchGuard resizeGuard(resizeLatch);
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  LatencyTimer timer(readLatency);
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  bufStats.accesses++;
+  bool found;
+  {
+    BufPartition& part = partitionOf(file, pageNo);
+    std::lock_guard<std::mutex> guard(part.latch);
+    found = part.table->find(file, pageNo, frameNo);
+    if (found)
+      bufDescTable[frameNo].pinCnt++;
+    part.count(file, found);
+  }
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
+  PageId first;
+  std::int64_t stride;
+  std::uint32_t count;
+  if (found)
+  {
     page = &bufPool[frameNo];
+    pageHit(file, pageNo, frameNo, ring);
+    return;
   }
-  catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
+  // not in the buffer pool, must allocate a new page
+  FileQuotaState* quota = quotaOf(file);
+  std::uint32_t slot = 0;
+  if (ring != NULL)
+    slot = allocRingBuf(ring, frameNo, quota);
+  else
+    allocBuf(frameNo, quota);
+
+  // read the page into the new frame
+  bufStats.diskreads++;
+  try
+  {
+    std::lock_guard<std::mutex> ioGuard(file->ioLatch());
     bufPool[frameNo] = file->readPage(pageNo);
+  }
+  catch (...)
+  {
+    if (ring != NULL)
+      ring->files[slot] = NULL;
+    policy->freed(frameNo);
+    bufDescTable[frameNo].release();
+    throw;
+  }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  if (ring != NULL)
+  {
+    // the ring reuses the frame later only if this page is still in it
+    FrameId ringFrame = frameNo;
+    installPage(file, pageNo, frameNo, true, quota);
+    ring->files[slot] = frameNo == ringFrame ? file : NULL;
+    ring->pageNos[slot] = pageNo;
+  }
+  else
+    installPage(file, pageNo, frameNo, false, quota);
+  page = &bufPool[frameNo];
+
+  if (nextReadAhead(file, pageNo, true, ring, first, stride, count))
+    readAhead(file, first, stride, count, ring);
+}
+
+void BufMgr::pageHit(File* file, const PageId pageNo, const FrameId frameNo, BufRing* ring)
+{
+  // let the replacement policy know, once the partition is no longer latched
+  if (ring == NULL)
+    policy->accessed(frameNo);
+
+  // an access renews the chances of a page with a priority
+  BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+  if (tmpbuf->quota != NULL)
+    tmpbuf->chances = tmpbuf->quota->priority.load();
+
+  // reading the first page of a window read ahead reads the next window
+  PageId first;
+  std::int64_t stride;
+  std::uint32_t count;
+  if (tmpbuf->readAheadMark && tmpbuf->readAheadMark.exchange(false) &&
+      nextReadAhead(file, pageNo, false, ring, first, stride, count))
+    readAhead(file, first, stride, count, ring);
+}
+
+bool BufMgr::pinFrame(File* file, const PageId pageNo, const FrameId frameNo)
+{
+  // the pool may have shrunk since the frame was noted
+  if (frameNo >= numBufs)
+    return false;
+
+  // a page enters and leaves a frame under the latch of its partition, so
+  // while it is held the frame either holds the page or does not
+  BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+  BufPartition& part = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(part.latch);
+  if (! tmpbuf->valid || tmpbuf->pageNo != pageNo)
+    return false;
+  const File* holder = tmpbuf->file;
+  if (holder == NULL || holder->id() != file->id())
+    return false;
+  tmpbuf->pinCnt++;
+  part.count(file, true);
+  bufStats.accesses++;
+  bufStats.swiphits++;
+  return true;
+}
+
+void BufMgr::swizzle(const FrameId parentNo, const std::uint32_t slot, const FrameId frameNo)
+{
+  // the parent is pinned, so its swip table stays with it
+  BufDesc* parent = &(bufDescTable[parentNo]);
+  std::atomic<FrameId>* swips = parent->swips;
+  if (swips == NULL)
+  {
+    std::atomic<FrameId>* table = new std::atomic<FrameId>[SWIPSLOTS];
+    for (std::uint32_t i = 0; i < SWIPSLOTS; i++)
+      table[i] = NOFRAME;
+
+    // another thread following a swip of the same parent may have given it a table first
+    if (parent->swips.compare_exchange_strong(swips, table))
+      swips = table;
+    else
+      delete [] table;
+  }
+
+  swips[slot] = frameNo;
+  bufDescTable[frameNo].swizzledAt = static_cast<std::uint64_t>(parentNo) << 32 | slot;
+}
+
+void BufMgr::dropSwips(const FrameId frameNo)
+{
+  BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+
+  // most frames were never reached through a swip nor followed one, and
+  // leave without the latch
+  const std::uint64_t at = tmpbuf->swizzledAt.exchange(NOSWIP);
+  if (at == NOSWIP && tmpbuf->swips.load() == NULL)
+    return;
+
+  // unswizzle the swip that refers to the frame, unless it has since been
+  // pointed elsewhere. The frame is taken over, so no swip is followed from
+  // its own table, and the latch keeps the parent from deleting its table
+  // meanwhile.
+  std::atomic<FrameId>* swips;
+  {
+    std::lock_guard<std::mutex> guard(swipLatch);
+    const FrameId parentNo = static_cast<FrameId>(at >> 32);
+    if (at != NOSWIP && parentNo < numBufs)
+    {
+      std::atomic<FrameId>* parentSwips = bufDescTable[parentNo].swips;
+      FrameId swizzled = frameNo;
+      if (parentSwips != NULL)
+        parentSwips[at & 0xffffffff].compare_exchange_strong(swizzled, NOFRAME);
+    }
+    swips = tmpbuf->swips.exchange(NULL);
+  }
+
+  // the frames the page referred to keep their place until they are evicted,
+  // and unswizzling them then finds no table
+  delete [] swips;
+}
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+PageGuard BufMgr::fetchPageAt(File* file, const PageId pageNo, FrameId& hint)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  if (hint != NOFRAME && pinFrame(file, pageNo, hint))
+  {
+    pageHit(file, pageNo, hint, NULL);
+    return PageGuard(this, file, pageNo, &bufPool[hint], false);
+  }
+  PageGuard guard = fetchPage(file, pageNo);
+  hint = guard.page - bufPool;
+  return guard;
+}
+
+PageGuard BufMgr::fetchChild(const PageGuard& parent, const std::uint32_t slot, File* file, const PageId pageNo)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  const FrameId parentNo = parent.page - bufPool;
+  if (slot >= SWIPSLOTS)
+    return fetchPage(file, pageNo);
+
+  std::atomic<FrameId>* swips = bufDescTable[parentNo].swips;
+  if (swips != NULL)
+  {
+    const FrameId frameNo = swips[slot];
+    if (frameNo != NOFRAME && pinFrame(file, pageNo, frameNo))
+    {
+      pageHit(file, pageNo, frameNo, NULL);
+      return PageGuard(this, file, pageNo, &bufPool[frameNo], false);
+    }
+  }
+
+  PageGuard guard = fetchPage(file, pageNo);
+  swizzle(parentNo, slot, guard.page - bufPool);
+  return guard;
+}
+
+PageGuard BufMgr::fetchPage(File* file, const PageId pageNo, BufRing* ring)
+{
+  Page* page;
+  readPage(file, pageNo, page, ring);
+  return PageGuard(this, file, pageNo, page, false);
+}
+
+WritePageGuard BufMgr::fetchPageForWrite(File* file, const PageId pageNo)
+{
+  Page* page;
+  readPage(file, pageNo, page);
+  return WritePageGuard(this, file, pageNo, page);
+}
+
+WritePageGuard BufMgr::newPage(File* file, PageId &pageNo)
+{
+  Page* page;
+  allocPage(file, pageNo, page);
+  return WritePageGuard(this, file, pageNo, page);
+}
+
+void BufMgr::readPages(File* file, const PageId* pageNos, const std::size_t n, Page** pages,
+                       const PageArrived& arrived)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  for (std::size_t i = 0; i < n; i++)
+    pages[i] = NULL;
+
+  try
+  {
+    // pin the pages that are in the buffer pool
+    std::vector<std::pair<PageId, std::size_t> > misses;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      FrameId frameNo = 0;
+      bool found;
+      bufStats.accesses++;
+      {
+        BufPartition& part = partitionOf(file, pageNos[i]);
+        std::lock_guard<std::mutex> guard(part.latch);
+        found = part.table->find(file, pageNos[i], frameNo);
+        if (found)
+          bufDescTable[frameNo].pinCnt++;
+        part.count(file, found);
+      }
+      if (found)
+      {
+        policy->accessed(frameNo);
+        if (bufDescTable[frameNo].quota != NULL)
+          bufDescTable[frameNo].chances = bufDescTable[frameNo].quota->priority.load();
+        pages[i] = &bufPool[frameNo];
+        if (arrived)
+          arrived(i, pages[i]);
+      }
+      else
+        misses.push_back(std::make_pair(pageNos[i], i));
+    }
+
+    // read the others in runs of consecutive pages
+    FileQuotaState* quota = quotaOf(file);
+    std::sort(misses.begin(), misses.end());
+    std::vector<Page> run;
+    std::size_t k = 0;
+    while (k < misses.size())
+    {
+      const PageId first = misses[k].first;
+      std::size_t end = k + 1;
+      while (end < misses.size() && misses[end].first <= misses[end - 1].first + 1)
+        end++;
+      const std::uint32_t count = misses[end - 1].first - first + 1;
+
+      run.resize(count);
+      std::uint32_t numRead;
+      {
+        std::lock_guard<std::mutex> ioGuard(file->ioLatch());
+        numRead = file->readPages(first, count, &run[0]);
+      }
+
+      for (; k < end; k++)
+      {
+        const PageId pageNo = misses[k].first;
+        const std::size_t index = misses[k].second;
+        if (k > 0 && misses[k - 1].first == pageNo)
+        {
+          // requested again; pin the frame the first request read it into
+          pages[index] = pages[misses[k - 1].second];
+          std::lock_guard<std::mutex> guard(partitionOf(file, pageNo).latch);
+          bufDescTable[pages[index] - bufPool].pinCnt++;
+        }
+        else
+        {
+          // a page the run stopped short of is read alone, which throws the
+          // reason it cannot be read
+          if (pageNo - first >= numRead)
+          {
+            std::lock_guard<std::mutex> ioGuard(file->ioLatch());
+            run[pageNo - first] = file->readPage(pageNo);
+          }
+
+          FrameId frameNo;
+          allocBuf(frameNo, quota);
+          bufPool[frameNo] = run[pageNo - first];
+          bufStats.diskreads++;
+          installPage(file, pageNo, frameNo, false, quota);
+          pages[index] = &bufPool[frameNo];
+        }
+        if (arrived)
+          arrived(index, pages[index]);
+      }
+    }
+  }
+  catch (...)
+  {
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (pages[i] != NULL)
+      {
+        unPinPage(file, pageNos[i], false);
+        pages[i] = NULL;
+      }
+    }
+    throw;
+  }
+}
+
+bool BufMgr::nextReadAhead(const File* file, const PageId pageNo, const bool miss, const BufRing* ring,
+                           PageId& first, std::int64_t& stride, std::uint32_t& count)
+{
+  // a ring reads at most half its size ahead, so that it never reuses a frame
+  // holding a page read ahead but not read yet
+  std::uint32_t limit = ring != NULL ? std::min(ring->size / 2, maxReadAhead.load()) : maxReadAhead.load();
+  if (limit == 0)
+    return false;
+
+  std::lock_guard<std::mutex> guard(streamLatch);
+  ReadAheadStream& stream = streams[file->id()];
+  if (miss)
+  {
+    std::int64_t distance = (std::int64_t)pageNo - (std::int64_t)stream.lastMiss;
+    if (stream.lastMiss != Page::INVALID_NUMBER && distance == stream.stride)
+      stream.run++;
+    else
+    {
+      stream.stride = distance;
+      stream.run = 1;
+      stream.window = 0;
+    }
+    stream.lastMiss = pageNo;
+
+    // three misses in a row at the same stride start reading ahead
+    if (stream.run < 2 || stream.stride == 0 || std::abs(stream.stride) > MAXSTRIDE)
+      return false;
+    if (stream.window == 0)
+      stream.next = pageNo + stream.stride;
+  }
+  else if (stream.window == 0)
+  {
+    // the stream changed since the page was read ahead
+    return false;
+  }
+
+  stream.window = std::min(stream.window == 0 ? MINREADAHEAD : stream.window * 2, limit);
+  first = stream.next;
+  stride = stream.stride;
+  count = stream.window;
+  if (stride < 0)
+  {
+    // going backwards, stop at the first page of the file
+    if (first < 1)
+      count = 0;
+    else
+      count = std::min<std::int64_t>(count, (first - 1) / -stride + 1);
+  }
+  stream.next = first + count * stride;
+  return count > 0;
+}
+
+void BufMgr::readAhead(File* file, const PageId first, const std::int64_t stride, const std::uint32_t count,
+                       BufRing* ring)
+{
+  auto resident = [this, file](const PageId pageNo)
+  {
+    BufPartition& part = partitionOf(file, pageNo);
+    std::lock_guard<std::mutex> guard(part.latch);
+    FrameId frameNo;
+    return part.table->find(file, pageNo, frameNo);
+  };
+
+  FileQuotaState* quota = quotaOf(file);
+  std::vector<Page> pages(stride == 1 ? count : 1);
+  bool marked = false;
+  std::uint32_t i = 0;
+  while (i < count)
+  {
+    PageId pageNo = first + i * stride;
+    if (resident(pageNo))
+    {
+      i++;
+      continue;
+    }
+
+    // read a run of consecutive pages missing from the pool at once
+    std::uint32_t run = 1;
+    while (stride == 1 && i + run < count && !resident(pageNo + run))
+      run++;
+    std::uint32_t numRead;
+    {
+      std::lock_guard<std::mutex> ioGuard(file->ioLatch());
+      numRead = file->readPages(pageNo, run, &pages[0]);
+    }
+
+    for (std::uint32_t j = 0; j < numRead; j++)
+    {
+      // never write a page back to make room for a page nobody asked for yet
+      FrameId frameNo;
+      std::uint32_t slot = 0;
+      if (ring != NULL)
+      {
+        try
+        {
+          slot = allocRingBuf(ring, frameNo, quota);
+        }
+        catch (const BufferExceededException& e)
+        {
+          return;
+        }
+      }
+      else if (!allocCleanBuf(frameNo, quota))
+        return;
+
+      bufPool[frameNo] = pages[j];
+      bufStats.diskreads++;
+      bufStats.readaheads++;
+
+      FrameId ours = frameNo;
+      installPage(file, pageNo + j, frameNo, ring != NULL, quota);
+      if (ring != NULL)
+      {
+        ring->files[slot] = frameNo == ours ? file : NULL;
+        ring->pageNos[slot] = pageNo + j;
+      }
+      if (!marked)
+      {
+        bufDescTable[frameNo].readAheadMark = true;
+        marked = true;
+      }
+      unPinPage(file, pageNo + j, false);
+    }
+
+    // end of the file
+    if (numRead < run)
+      return;
+    i += run;
   }
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  SharedLatchGuard resizeGuard(resizeLatch);
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  BufPartition& part = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(part.latch);
+  part.table->lookup(file, pageNo, frameNo);
+
+  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+
+  // make sure the page is actually pinned
+  if (bufDescTable[frameNo].pinCnt == 0)
+  {
+  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+  }
+  else bufDescTable[frameNo].pinCnt--;
+}
+
+void BufMgr::unPinFrame(File* file, const PageId pageNo, const Page* page, const bool dirty)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  // the page cannot leave its frame while pinned, so no lookup is needed
+  const FrameId frameNo = page - bufPool;
+  std::lock_guard<std::mutex> guard(partitionOf(file, pageNo).latch);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
@@ -170,66 +1072,336 @@ void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  SharedLatchGuard resizeGuard(resizeLatch);
+  LatencyTimer timer(allocLatency);
   FrameId frameNo;
+  bufStats.accesses++;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  FileQuotaState* quota = quotaOf(file);
+  allocBuf(frameNo, quota);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
-
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  try
+  {
+    std::lock_guard<std::mutex> ioGuard(file->ioLatch());
+    bufPool[frameNo] = file->allocatePage(pageNo);
+  }
+  catch (...)
+  {
+    policy->freed(frameNo);
+    bufDescTable[frameNo].release();
+    throw;
+  }
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  installPage(file, pageNo, frameNo, false, quota);
+  page = &bufPool[frameNo];
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  SharedLatchGuard resizeGuard(resizeLatch);
+  LatencyTimer timer(flushLatency);
+
+  // collect the pages of the file from every partition, so that they are
+  // written in page number order
+  std::vector<std::pair<PageId, FrameId> > pages;
+  for (std::uint32_t i = 0; i < numPartitions; i++)
 	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
+  	std::lock_guard<std::mutex> guard(partitions[i].latch);
+  	std::unordered_map<std::uint32_t, std::map<PageId, FrameId> >::const_iterator filePages =
+  		partitions[i].filePages.find(file->id());
+  	if (filePages != partitions[i].filePages.end())
+  		pages.insert(pages.end(), filePages->second.begin(), filePages->second.end());
+  }
+  std::sort(pages.begin(), pages.end());
+
+  {
+  	std::lock_guard<std::mutex> guard(streamLatch);
+  	streams.erase(file->id());
+  }
+
+  for (std::size_t i = 0; i < pages.size(); i++)
+	{
+  	const PageId pageNo = pages[i].first;
+  	const FrameId frameNo = pages[i].second;
+  	BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+  	tmpbuf->acquire();
+  	if (tmpbuf->file != file || tmpbuf->pageNo != pageNo)
+		{
+			// evicted since it was collected
+			tmpbuf->release();
+			continue;
+		}
+		if (tmpbuf->valid == false)
 		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+			tmpbuf->release();
+  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		}
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
+		BufPartition& part = partitionOf(file, pageNo);
+		std::unique_lock<std::mutex> guard(part.latch);
+    if (tmpbuf->pinCnt > 0)
+		{
+			guard.unlock();
+			tmpbuf->release();
+			throw PagePinnedException(file->filename(), pageNo, frameNo);
+		}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
+    if (tmpbuf->dirty == true)
+		{
+			std::lock_guard<std::mutex> ioGuard(tmpbuf->file->ioLatch());
+			tmpbuf->file->writePage(pageNo, bufPool[frameNo]);
+			tmpbuf->dirty = false;
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+
+  	part.remove(file, pageNo);
+  	dropSwips(frameNo);
+  	tmpbuf->Clear();
+  	guard.unlock();
+  	policy->freed(frameNo);
+		tmpbuf->release();
   }
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  SharedLatchGuard resizeGuard(resizeLatch);
 	//Deallocate from file altogether
-  //See if it is in the buffer pool
+  //See if it is in the buffer pool; a page that is not needs no frame freed
+  BufPartition& part = partitionOf(file, pageNo);
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  bool resident;
+  {
+    std::lock_guard<std::mutex> guard(part.latch);
+    resident = part.table->find(file, pageNo, frameNo);
+  }
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  if (resident)
+  {
+    // take the frame over first, as the clock does, then make sure it still
+    // holds the page
+    BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+    bool cleared = false;
+    tmpbuf->acquire();
+    {
+      std::lock_guard<std::mutex> guard(part.latch);
+      if (tmpbuf->valid && tmpbuf->file == file && tmpbuf->pageNo == pageNo)
+      {
+	      // clear the page
+	      dropSwips(frameNo);
+	      tmpbuf->Clear();
+	      cleared = true;
 
-	hashTable->remove(file, pageNo);
+	      part.remove(file, pageNo);
+      }
+    }
+    if (cleared)
+      policy->freed(frameNo);
+    tmpbuf->release();
+  }
 
   // deallocate it in the file	
+  std::lock_guard<std::mutex> ioGuard(file->ioLatch());
   file->deletePage(pageNo);
 }
 
+std::uint32_t BufMgr::writeAhead(const std::uint32_t maxPages)
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  std::vector<FrameId> candidates;
+  policy->peekVictims(numBufs / 2 + 1, candidates);
+
+  std::uint32_t written = 0;
+  Page copy;
+  for (std::size_t i = 0; i < candidates.size() && written < maxPages; i++)
+  {
+    BufDesc* tmpbuf = &(bufDescTable[candidates[i]]);
+    if (! tmpbuf->dirty || tmpbuf->pinCnt > 0 || tmpbuf->busy.exchange(true))
+      continue;
+
+    // copy the page while nobody can pin it, then write the copy with only the
+    // busy flag held, which keeps the frame from being evicted or flushed
+    // before the write is done; a page changed meanwhile is marked dirty again
+    // when it is unpinned
+    File* file = NULL;
+    PageId pageNo = 0;
+    if (tmpbuf->valid)
+    {
+      BufPartition& part = partitionOf(tmpbuf->file, tmpbuf->pageNo);
+      std::lock_guard<std::mutex> guard(part.latch);
+      if (tmpbuf->dirty && tmpbuf->pinCnt == 0)
+      {
+        copy = bufPool[candidates[i]];
+        tmpbuf->dirty = false;
+        file = tmpbuf->file;
+        pageNo = tmpbuf->pageNo;
+      }
+    }
+
+    if (file != NULL)
+    {
+      try
+      {
+        std::lock_guard<std::mutex> ioGuard(file->ioLatch());
+        file->writePage(pageNo, copy);
+      }
+      catch (...)
+      {
+        tmpbuf->dirty = true;
+        tmpbuf->release();
+        throw;
+      }
+      bufStats.diskwrites++;
+      bufStats.writerwrites++;
+      written++;
+    }
+    tmpbuf->release();
+  }
+  return written;
+}
+
+void BufMgr::runWriter(const std::uint32_t maxPages, const std::uint32_t intervalMs)
+{
+  std::unique_lock<std::mutex> guard(writerLatch);
+  while (! writerStop)
+  {
+    guard.unlock();
+    writeAhead(maxPages);
+    guard.lock();
+    writerWake.wait_for(guard, std::chrono::milliseconds(intervalMs),
+                        [this] { return writerStop; });
+  }
+}
+
+void BufMgr::startWriter(const std::uint32_t maxPages, const std::uint32_t intervalMs)
+{
+  stopWriter();
+  writerStop = false;
+  writerMaxPages = maxPages;
+  writerIntervalMs = intervalMs;
+  writer = std::thread(&BufMgr::runWriter, this, maxPages, intervalMs);
+}
+
+void BufMgr::stopWriter()
+{
+  if (! writer.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(writerLatch);
+    writerStop = true;
+  }
+  writerWake.notify_one();
+  writer.join();
+}
+
+void BufMgr::setMaxReadAhead(const std::uint32_t pages)
+{
+  maxReadAhead = pages;
+}
+
+void BufMgr::latchPage(const Page* page, const bool exclusive)
+{
+  FrameLatch& latch = bufDescTable[page - bufPool].latch;
+  if (exclusive)
+  	latch.lock();
+  else
+  	latch.lockShared();
+}
+
+void BufMgr::unlatchPage(const Page* page, const bool exclusive)
+{
+  FrameLatch& latch = bufDescTable[page - bufPool].latch;
+  if (exclusive)
+  	latch.unlock();
+  else
+  	latch.unlockShared();
+}
+
+void BufMgr::collectCounts(BufStats& stats, std::map<std::string, FileAccesses>* files)
+{
+  std::uint64_t lookups = 0;
+  std::uint64_t probes = 0;
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+
+  // a file has counts in every partition holding one of its pages; they are
+  // summed by file id, and the name is copied once per file
+  std::unordered_map<std::uint32_t, FileAccesses> byFile;
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+  	std::lock_guard<std::mutex> guard(partitions[i].latch);
+  	lookups += partitions[i].table->lookups();
+  	probes += partitions[i].table->probes();
+  	for (std::unordered_map<std::uint32_t, FileAccesses>::const_iterator it = partitions[i].fileAccesses.begin();
+  	     it != partitions[i].fileAccesses.end(); ++it)
+		{
+  		hits += it->second.hits;
+  		misses += it->second.misses;
+  		if (files == NULL)
+  			continue;
+  		FileAccesses& counts = byFile[it->first];
+  		if (counts.name.empty())
+  			counts.name = it->second.name;
+  		counts.hits += it->second.hits;
+  		counts.misses += it->second.misses;
+  	}
+  }
+  stats.hashlookups.store(lookups, std::memory_order_relaxed);
+  stats.hashprobes.store(probes, std::memory_order_relaxed);
+  stats.hits.store(hits, std::memory_order_relaxed);
+  stats.misses.store(misses, std::memory_order_relaxed);
+
+  if (files != NULL)
+	{
+  	for (std::unordered_map<std::uint32_t, FileAccesses>::const_iterator it = byFile.begin(); it != byFile.end(); ++it)
+		{
+  		FileAccesses& counts = (*files)[it->second.name];
+  		counts.name = it->second.name;
+  		counts.hits += it->second.hits;
+  		counts.misses += it->second.misses;
+  	}
+  }
+}
+
+BufStats & BufMgr::getBufStats()
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  collectCounts(bufStats, NULL);
+  return bufStats;
+}
+
+BufMetrics BufMgr::getMetrics()
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  BufMetrics metrics;
+  metrics.stats = bufStats;
+  collectCounts(metrics.stats, &metrics.files);
+  readLatency.snapshot(metrics.readLatency);
+  allocLatency.snapshot(metrics.allocLatency);
+  flushLatency.snapshot(metrics.flushLatency);
+  return metrics;
+}
+
+void BufMgr::clearBufStats()
+{
+  SharedLatchGuard resizeGuard(resizeLatch);
+  bufStats.clear();
+  readLatency.clear();
+  allocLatency.clear();
+  flushLatency.clear();
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+  	std::lock_guard<std::mutex> guard(partitions[i].latch);
+  	partitions[i].table->clearStats();
+  	partitions[i].clearCounts();
+  }
+}
+
 void BufMgr::printSelf(void) 
 {
+  SharedLatchGuard resizeGuard(resizeLatch);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
@@ -246,4 +1418,194 @@ void BufMgr::printSelf(void)
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+//----------------------------------------
+// PageGuard
+//----------------------------------------
+
+PageGuard::PageGuard()
+	: bufMgr(NULL), file(NULL), pageNum(Page::INVALID_NUMBER), page(NULL), dirty(false)
+{
+}
+
+PageGuard::PageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page, const bool dirty)
+	: bufMgr(bufMgr), file(file), pageNum(pageNo), page(page), dirty(dirty)
+{
+}
+
+PageGuard::PageGuard(PageGuard&& other)
+	: bufMgr(other.bufMgr), file(other.file), pageNum(other.pageNum), page(other.page), dirty(other.dirty)
+{
+  other.bufMgr = NULL;
+  other.page = NULL;
+  other.pageNum = Page::INVALID_NUMBER;
+}
+
+PageGuard& PageGuard::operator=(PageGuard&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    file = other.file;
+    pageNum = other.pageNum;
+    page = other.page;
+    dirty = other.dirty;
+    other.bufMgr = NULL;
+    other.page = NULL;
+    other.pageNum = Page::INVALID_NUMBER;
+  }
+  return *this;
+}
+
+PageGuard::~PageGuard()
+{
+  release();
+}
+
+void PageGuard::release()
+{
+  if (bufMgr != NULL)
+  {
+    BufMgr* pinnedIn = bufMgr;
+    const Page* pinned = page;
+    bufMgr = NULL;
+    page = NULL;
+    pinnedIn->unPinFrame(file, pageNum, pinned, dirty);
+    pageNum = Page::INVALID_NUMBER;
+  }
+}
+
+LatencyHistogram::LatencyHistogram()
+	: total(0), sum(0)
+{
+  std::fill(counts, counts + BUCKETS, 0);
+}
+
+std::uint64_t LatencyHistogram::bucketLimit(const int bucket)
+{
+  if (bucket < 4)
+  	return bucket;
+  if (bucket == BUCKETS - 1)
+  	return ~static_cast<std::uint64_t>(0);
+
+  // the next bucket starts past the limit
+  const int next = bucket + 1;
+  return (static_cast<std::uint64_t>(4 + next % 4) << (next / 4 - 1)) - 1;
+}
+
+std::uint64_t LatencyHistogram::percentile(const double fraction) const
+{
+  if (total == 0)
+  	return 0;
+
+  // the rank of the latency wanted, counting from 1
+  std::uint64_t rank = static_cast<std::uint64_t>(fraction * total + 0.5);
+  rank = std::max<std::uint64_t>(1, std::min(rank, total));
+  std::uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++)
+	{
+  	seen += counts[i];
+  	if (seen >= rank)
+  		return bucketLimit(i);
+  }
+  return bucketLimit(BUCKETS - 1);
+}
+
+LatencyHistogram& LatencyHistogram::operator-=(const LatencyHistogram& earlier)
+{
+  for (int i = 0; i < BUCKETS; i++)
+  	counts[i] -= earlier.counts[i];
+  total -= earlier.total;
+  sum -= earlier.sum;
+  return *this;
+}
+
+void LatencyRecorder::snapshot(LatencyHistogram& histogram) const
+{
+  const int used = usedBuckets.load(std::memory_order_relaxed);
+  histogram.total = 0;
+  for (int i = 0; i < used; i++)
+	{
+  	histogram.counts[i] = counts[i].load(std::memory_order_relaxed);
+  	histogram.total += histogram.counts[i];
+  }
+  std::fill(histogram.counts + used, histogram.counts + LatencyHistogram::BUCKETS, 0);
+  histogram.sum = sum.load(std::memory_order_relaxed);
+}
+
+void LatencyRecorder::clear()
+{
+  for (int i = 0; i < LatencyHistogram::BUCKETS; i++)
+  	counts[i] = 0;
+  sum = 0;
+  usedBuckets = 0;
+}
+
+BufMetrics BufMetrics::since(const BufMetrics& earlier) const
+{
+  BufMetrics diff(*this);
+  diff.stats -= earlier.stats;
+  diff.readLatency -= earlier.readLatency;
+  diff.allocLatency -= earlier.allocLatency;
+  diff.flushLatency -= earlier.flushLatency;
+
+  // files first seen since the earlier snapshot keep all their counts
+  for (std::map<std::string, FileAccesses>::const_iterator it = earlier.files.begin(); it != earlier.files.end(); ++it)
+	{
+  	std::map<std::string, FileAccesses>::iterator counts = diff.files.find(it->first);
+  	if (counts == diff.files.end())
+  		continue;
+  	counts->second.hits -= it->second.hits;
+  	counts->second.misses -= it->second.misses;
+  	if (counts->second.hits == 0 && counts->second.misses == 0)
+  		diff.files.erase(counts);
+  }
+  return diff;
+}
+
+/**
+ * Print one line of latencies, in microseconds
+ */
+static void printLatency(std::ostream& out, const char* name, const LatencyHistogram& histogram)
+{
+  out << name << ": " << histogram.total << " calls timed";
+  if (histogram.total > 0)
+	{
+  	out << ", mean " << histogram.sum / 1000.0 / histogram.total << " us"
+  	    << ", p50 " << histogram.percentile(0.5) / 1000.0
+  	    << ", p99 " << histogram.percentile(0.99) / 1000.0
+  	    << ", max " << histogram.percentile(1.0) / 1000.0 << " us";
+  }
+  out << "\n";
+}
+
+/**
+ * Ratio of two counts as a percentage, or 0 if there is nothing to divide
+ */
+static double percent(const std::uint64_t part, const std::uint64_t whole)
+{
+  return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+void BufMetrics::print(std::ostream& out) const
+{
+  out << "accesses: " << stats.accesses << ", hits " << stats.hits << ", misses " << stats.misses
+      << ", hit ratio " << percent(stats.hits, stats.hits + stats.misses) << "%\n";
+  out << "disk: " << stats.diskreads << " reads (" << stats.readaheads << " read ahead), "
+      << stats.diskwrites << " writes (" << stats.writerwrites << " by the writer)\n";
+  out << "evictions: " << stats.cleanevictions << " clean, " << stats.dirtyevictions << " dirty\n";
+  out << "sweeps: " << stats.sweeps << ", mean length "
+      << (stats.sweeps > 0 ? static_cast<double>(stats.sweepframes) / stats.sweeps : 0.0)
+      << ", pinned frames passed over " << stats.pinwaits << "\n";
+  out << "page table: " << stats.hashlookups << " lookups, mean probe length "
+      << (stats.hashlookups > 0 ? static_cast<double>(stats.hashprobes) / stats.hashlookups : 0.0)
+      << ", hits through swips " << stats.swiphits << "\n";
+  printLatency(out, "readPage", readLatency);
+  printLatency(out, "allocPage", allocLatency);
+  printLatency(out, "flushFile", flushLatency);
+  for (std::map<std::string, FileAccesses>::const_iterator it = files.begin(); it != files.end(); ++it)
+  	out << "file " << it->first << ": hits " << it->second.hits << ", misses " << it->second.misses
+  	    << ", hit ratio " << percent(it->second.hits, it->second.hits + it->second.misses) << "%\n";
+}
+
 }
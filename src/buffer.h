@@ -9,7 +9,18 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "replacement.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,12 +29,180 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief Reader-writer latch guarding the contents of a frame. Latches are
+* held only while a page is being used, so waiting threads spin and yield
+* rather than sleep.
+*/
+class FrameLatch {
+ private:
+	/**
+   * -1 if held exclusive, otherwise the number of shared holders
+	 */
+  std::atomic<int> state;
+
+ public:
+	/**
+   * Constructor of FrameLatch class
+	 */
+  FrameLatch() : state(0) {}
+
+	/**
+   * Take the latch shared, waiting while it is held exclusive
+	 */
+  void lockShared()
+	{
+		for (;;)
+		{
+			int s = state.load();
+			if (s >= 0 && state.compare_exchange_weak(s, s + 1))
+				return;
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+   * Release a shared hold of the latch
+	 */
+  void unlockShared()
+	{
+		state.fetch_sub(1);
+  }
+
+	/**
+   * Take the latch exclusive, waiting while anyone else holds it
+	 */
+  void lock()
+	{
+		for (;;)
+		{
+			int s = 0;
+			if (state.compare_exchange_weak(s, -1))
+				return;
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+   * Release an exclusive hold of the latch
+	 */
+  void unlock()
+	{
+		state.store(0);
+  }
+};
+
+/**
+* @brief Holds a FrameLatch shared for as long as it exists.
+*/
+class SharedLatchGuard {
+ private:
+	/**
+   * Latch held
+	 */
+  FrameLatch& latch;
+
+ public:
+	/**
+   * Take the latch shared
+	 */
+  explicit SharedLatchGuard(FrameLatch& latch) : latch(latch)
+	{
+		latch.lockShared();
+  }
+
+	/**
+   * Release the latch
+	 */
+  ~SharedLatchGuard()
+	{
+		latch.unlockShared();
+  }
+};
+
+/**
+* @brief How the buffer pool treats the pages of one file, set with BufMgr::setFileQuota(). A file keeps minFrames of
+* its pages against other files, holds at most maxFrames, after which its pages replace each other, and its pages pass
+* priority more sweeps of the replacement policy before they are evicted. These give way only when no frame can be
+* found otherwise.
+*/
+struct FileQuota
+{
+	/**
+   * Frames the file's pages keep when other files need frames
+	 */
+  std::uint32_t minFrames;
+
+	/**
+   * Most frames the file's pages may hold, or 0 for no limit
+	 */
+  std::uint32_t maxFrames;
+
+	/**
+   * Number of times a page of the file is passed over as a victim after being read, or 0 to be replaced as usual
+	 */
+  std::uint32_t priority;
+
+	/**
+   * Constructor of FileQuota class
+	 */
+  FileQuota(const std::uint32_t minFrames = 0, const std::uint32_t maxFrames = 0, const std::uint32_t priority = 0)
+		: minFrames(minFrames), maxFrames(maxFrames), priority(priority)
+  {
+  }
+};
+
+
+/**
+* @brief The quota of a file and the number of frames its pages hold, kept by BufMgr.
+*/
+struct FileQuotaState
+{
+	/**
+   * Fields of FileQuota; they may change while the pool is in use
+	 */
+  std::atomic<std::uint32_t> minFrames;
+  std::atomic<std::uint32_t> maxFrames;
+  std::atomic<std::uint32_t> priority;
+
+	/**
+   * Number of frames holding pages of the file
+	 */
+  std::atomic<std::uint32_t> resident;
+
+	/**
+   * Constructor of FileQuotaState class
+	 */
+  FileQuotaState()
+		: minFrames(0), maxFrames(0), priority(0), resident(0)
+  {
+  }
+};
+
+
+/**
+* Number of swips kept for a page; a page holds at most this many page numbers
+*/
+const std::uint32_t SWIPSLOTS = Page::SIZE / sizeof(PageId);
+
+/**
+* Frame of a swip that refers to no frame
+*/
+const FrameId NOFRAME = UINT32_MAX;
+
+/**
+* Place of a frame that no swip refers to
+*/
+const std::uint64_t NOSWIP = UINT64_MAX;
+
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
 class BufDesc {
 
 	friend class BufMgr;
+	friend class ClockPolicy;
 
  private:
 	/**
@@ -42,24 +221,80 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. Pins are taken and dropped
+   * under the latch of the page's page table partition.
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
 	 */
-  bool valid;
+  std::atomic<bool> valid;
+
+	/**
+   * Has this buffer frame been reference recently. Only used by CLOCK replacement.
+	 */
+  std::atomic<bool> refbit;
+
+	/**
+   * True if the page was read ahead, and reading it is the signal to read the next pages of its stream ahead
+	 */
+  std::atomic<bool> readAheadMark;
+
+	/**
+   * Quota of the page's file, or NULL if it has none. Only changed while the frame is taken over.
+	 */
+  FileQuotaState* quota;
+
+	/**
+   * Number of times the page is still to be passed over as a victim, from the priority of its file's quota
+	 */
+  std::atomic<std::uint32_t> chances;
+
+	/**
+   * Swips of the pages this page refers to, by slot, or NULL if none was ever followed. Each holds the frame the
+   * page referred to from that slot was last found in, or NOFRAME. Deleted when the page leaves.
+	 */
+  std::atomic<std::atomic<FrameId>*> swips;
+
+	/**
+   * Frame of the page whose swip refers to this frame, in the high half, and the slot of that swip, or NOSWIP
+	 */
+  std::atomic<std::uint64_t> swizzledAt;
+
+	/**
+   * Set by the thread that is taking over the frame. Only that thread may
+   * change which page the frame holds, so file and pageNo are stable while
+   * it is set.
+	 */
+  std::atomic<bool> busy;
+
+	/**
+   * Latch guarding the contents of the frame
+	 */
+  FrameLatch latch;
+
+	/**
+   * Take over the frame, waiting while another thread has it
+	 */
+  void acquire()
+	{
+		while (busy.exchange(true))
+			std::this_thread::yield();
+  }
 
 	/**
-   * Has this buffer frame been reference recently
+   * Hand the frame back
 	 */
-  bool refbit;
+  void release()
+	{
+		busy = false;
+  }
 
 	/**
    * Initialize buffer frame for a new user
@@ -71,7 +306,12 @@ class BufDesc {
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
+		readAheadMark = false;
 		valid = false;
+		if (quota != NULL)
+			quota->resident--;
+		quota = NULL;
+		chances = 0;
   };
 
 	/**
@@ -80,15 +320,24 @@ class BufDesc {
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
+	 * @param fileQuota	Quota of the file, or NULL
 	 */
-  void Set(File* filePtr, PageId pageNum)
+  void Set(File* filePtr, PageId pageNum, FileQuotaState* fileQuota)
 	{ 
 		file = filePtr;
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
     valid = true;
-    refbit = true;
+    refbit = false;
+    readAheadMark = false;
+		quota = fileQuota;
+		chances = 0;
+		if (quota != NULL)
+		{
+			quota->resident++;
+			chances = quota->priority.load();
+		}
   }
 
   void Print()
@@ -111,184 +360,1388 @@ class BufDesc {
    * Constructor of BufDesc class 
 	 */
   BufDesc()
+		: quota(NULL), swips(NULL), swizzledAt(NOSWIP), busy(false)
 	{
   	Clear();
+  }
+
+	/**
+   * Destructor of BufDesc class; deletes the swip table
+	 */
+  ~BufDesc()
+	{
+  	delete [] swips.load();
   }
 };
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief Hits and misses on the pages of one file
 */
-struct BufStats
+struct FileAccesses
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Name of the file
 	 */
-  int accesses;
+  std::string name;
 
 	/**
-   * Number of pages read from disk (including allocs)
+   * Number of pages of the file found in the buffer pool
 	 */
-  int diskreads;
+  std::uint64_t hits;
 
 	/**
-   * Number of pages written back to disk
+   * Number of pages of the file read from disk on request
 	 */
-  int diskwrites;
+  std::uint64_t misses;
 
 	/**
-   * Clear all values 
-	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
-	/**
-   * Constructor of BufStats class 
+   * Constructor of FileAccesses class
 	 */
-  BufStats()
+  FileAccesses()
+		: hits(0), misses(0)
   {
-		clear();
   }
 };
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief One partition of the page table, and the latch guarding it
 */
-class BufMgr 
+struct BufPartition
 {
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Hash table mapping (File, page) to frame for the pages of this partition
 	 */
-  FrameId clockHand;
+  BufHashTbl *table;
 
 	/**
-   * Number of frames in the buffer pool
+   * Pages of this partition by file id, each mapping page number to frame, so that the pages of one file can be found
+   * without looking at every frame
 	 */
-  std::uint32_t numBufs;
-	
+  std::unordered_map<std::uint32_t, std::map<PageId, FrameId> > filePages;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hits and misses on the pages of this partition, by file id
 	 */
-  BufHashTbl *hashTable;
+  std::unordered_map<std::uint32_t, FileAccesses> fileAccesses;
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * File whose pages were last counted, and its entry in fileAccesses, or NULL
 	 */
-  BufDesc *bufDescTable;
+  std::uint32_t lastFileId;
+  FileAccesses* lastCounts;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Latch held while the table is used, and while pinning or unpinning one of
+   * its pages
 	 */
-  BufStats bufStats;
+  std::mutex latch;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Enter a page held by a frame; the latch must be held
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame holding the page
 	 */
-  void advanceClock()
+  void insert(const File* file, const PageId pageNo, const FrameId frameNo)
   {
-		clockHand = (clockHand + 1) % numBufs;
+		table->insert(file, pageNo, frameNo);
+		filePages[file->id()][pageNo] = frameNo;
   }
 
 	/**
-	 * Allocate a free frame.  
+   * Count a request for a page of a file; the latch must be held
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param file   	File object
+	 * @param hit  	True if the page was in the buffer pool
 	 */
-  void allocBuf(FrameId & frame);
+  void count(const File* file, const bool hit)
+  {
+		if (lastCounts == NULL || lastFileId != file->id())
+		{
+			lastFileId = file->id();
+			lastCounts = &fileAccesses[lastFileId];
+			if (lastCounts->name.empty())
+				lastCounts->name = file->filename();
+		}
+		if (hit)
+			lastCounts->hits++;
+		else
+			lastCounts->misses++;
+  }
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Forget the hits and misses counted; the latch must be held
 	 */
-  Page* bufPool;
+  void clearCounts()
+  {
+		fileAccesses.clear();
+		lastCounts = NULL;
+  }
 
 	/**
-   * Constructor of BufMgr class
-	 */
-  BufMgr(std::uint32_t bufs);
-	
-	/**
-   * Destructor of BufMgr class
+   * Constructor of BufPartition class
 	 */
-  ~BufMgr();
+  BufPartition()
+		: table(NULL), lastCounts(NULL)
+  {
+  }
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+   * Remove a page entered with insert(); the latch must be held
 	 *
 	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param pageNo  Page number in the file
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  void remove(const File* file, const PageId pageNo)
+  {
+		table->remove(file, pageNo);
+		std::unordered_map<std::uint32_t, std::map<PageId, FrameId> >::iterator pages = filePages.find(file->id());
+		pages->second.erase(pageNo);
+		if (pages->second.empty())
+			filePages.erase(pages);
+  }
+};
 
+
+/**
+* @brief Stream of page faults on one file that BufMgr watches to read pages ahead. Misses at a steady stride start
+* reading ahead; reading the first page of a window read ahead reads the next window, twice as large up to a limit.
+*/
+struct ReadAheadStream
+{
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Page of the last miss
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  PageId lastMiss;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Distance between the last two misses, in pages
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  std::int64_t stride;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Number of misses in a row at that stride
 	 */
-  void flushFile(const File* file);
+  std::uint32_t run;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Number of pages last read ahead, or 0 if not reading ahead
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  std::uint32_t window;
 
 	/**
-   * Print member variable values. 
+   * First page not read ahead yet
 	 */
-  void  printSelf();
+  PageId next;
 
 	/**
-   * Get buffer pool usage statistics
+   * Constructor of ReadAheadStream class
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
+  ReadAheadStream()
+		: lastMiss(Page::INVALID_NUMBER), stride(0), run(0), window(0), next(Page::INVALID_NUMBER)
+	{
   }
+};
+
+
+/**
+* @brief A small ring of frames through which a bulk reader, such as a sequential FileScan, reads its pages. Once the
+* ring is full, each page it misses on replaces the oldest page read through the ring, so a scan of any size only
+* ever evicts its own pages. A frame whose page someone else has pinned or used since is left to the pool, and the
+* ring takes another in its place. A ring is used by one thread at a time.
+*/
+class BufRing
+{
+	friend class BufMgr;
+
+ private:
+	/**
+   * Number of frames in the ring
+	 */
+  std::uint32_t size;
 
 	/**
-   * Clear buffer pool usage statistics
+   * Frame of each slot
 	 */
-  void clearBufStats() 
-  {
-		bufStats.clear();
+  std::vector<FrameId> frames;
+
+	/**
+   * File of the page the ring read into each slot, or NULL if the frame was not the ring's to fill
+	 */
+  std::vector<const File*> files;
+
+	/**
+   * Page the ring read into each slot
+	 */
+  std::vector<PageId> pageNos;
+
+	/**
+   * Slot to reuse next
+	 */
+  std::uint32_t next;
+
+ public:
+	/**
+   * Constructor of BufRing class
+	 *
+	 * @param size   	Number of frames in the ring
+	 */
+  explicit BufRing(std::uint32_t size)
+		: size(size), next(0)
+	{
   }
 };
 
+
+/**
+* @brief Class to maintain statistics of buffer usage. Counters are updated
+* by every thread using the buffer pool.
+*/
+struct BufStats
+{
+	/**
+   * Total number of accesses to buffer pool
+	 */
+  std::atomic<std::uint64_t> accesses;
+
+	/**
+   * Number of readPage(), readPages() and fetchChild() requests that found the page in the buffer pool; summed from
+   * the counts of each file
+	 */
+  std::atomic<std::uint64_t> hits;
+
+	/**
+   * Number of those requests that read the page from disk
+	 */
+  std::atomic<std::uint64_t> misses;
+
+	/**
+   * Number of hits that followed a swip to the page instead of looking it up in the page table
+	 */
+  std::atomic<std::uint64_t> swiphits;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  std::atomic<std::uint64_t> diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<std::uint64_t> diskwrites;
+
+	/**
+   * Number of those pages written back by the background writer
+	 */
+  std::atomic<std::uint64_t> writerwrites;
+
+	/**
+   * Number of pages read from disk ahead of a request
+	 */
+  std::atomic<std::uint64_t> readaheads;
+
+	/**
+   * Number of pages evicted unchanged
+	 */
+  std::atomic<std::uint64_t> cleanevictions;
+
+	/**
+   * Number of pages written back to be evicted
+	 */
+  std::atomic<std::uint64_t> dirtyevictions;
+
+	/**
+   * Number of searches for a frame to take over
+	 */
+  std::atomic<std::uint64_t> sweeps;
+
+	/**
+   * Number of frames those searches were offered; sweepframes / sweeps is the
+   * mean sweep length
+	 */
+  std::atomic<std::uint64_t> sweepframes;
+
+	/**
+   * Number of frames passed over by a search because they were pinned or in use
+	 */
+  std::atomic<std::uint64_t> pinwaits;
+
+	/**
+   * Number of page table lookups, inserts and removes
+	 */
+  std::atomic<std::uint64_t> hashlookups;
+
+	/**
+   * Number of page table buckets those examined; hashprobes / hashlookups is
+   * the mean probe length
+	 */
+  std::atomic<std::uint64_t> hashprobes;
+
+	/**
+   * Clear all values 
+	 */
+  void clear()
+  {
+		accesses = hits = misses = swiphits = 0;
+		diskreads = diskwrites = writerwrites = readaheads = 0;
+		cleanevictions = dirtyevictions = sweeps = sweepframes = pinwaits = 0;
+		hashlookups = hashprobes = 0;
+  }
+      
+	/**
+   * Constructor of BufStats class 
+	 */
+  BufStats()
+		: accesses(0), hits(0), misses(0), swiphits(0), diskreads(0), diskwrites(0), writerwrites(0), readaheads(0),
+		  cleanevictions(0), dirtyevictions(0), sweeps(0), sweepframes(0), pinwaits(0), hashlookups(0), hashprobes(0)
+  {
+  }
+
+	/**
+   * Copy constructor of BufStats class; takes a snapshot of the counters
+	 */
+  BufStats(const BufStats& other)
+  {
+		*this = other;
+  }
+
+	/**
+   * Assignment of BufStats class; takes a snapshot of the counters. Each counter is read on its own, without ordering
+   * against the others, so a snapshot taken while other threads run may be a few counts apart between counters.
+	 */
+  BufStats& operator=(const BufStats& other)
+  {
+		accesses.store(other.accesses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		hits.store(other.hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		misses.store(other.misses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		swiphits.store(other.swiphits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		diskreads.store(other.diskreads.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		diskwrites.store(other.diskwrites.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		writerwrites.store(other.writerwrites.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		readaheads.store(other.readaheads.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		cleanevictions.store(other.cleanevictions.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		dirtyevictions.store(other.dirtyevictions.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		sweeps.store(other.sweeps.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		sweepframes.store(other.sweepframes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		pinwaits.store(other.pinwaits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		hashlookups.store(other.hashlookups.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		hashprobes.store(other.hashprobes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+  }
+
+	/**
+   * Subtract the counters of an earlier snapshot, leaving what was counted since
+	 */
+  BufStats& operator-=(const BufStats& earlier)
+  {
+		accesses -= earlier.accesses;
+		hits -= earlier.hits;
+		misses -= earlier.misses;
+		swiphits -= earlier.swiphits;
+		diskreads -= earlier.diskreads;
+		diskwrites -= earlier.diskwrites;
+		writerwrites -= earlier.writerwrites;
+		readaheads -= earlier.readaheads;
+		cleanevictions -= earlier.cleanevictions;
+		dirtyevictions -= earlier.dirtyevictions;
+		sweeps -= earlier.sweeps;
+		sweepframes -= earlier.sweepframes;
+		pinwaits -= earlier.pinwaits;
+		hashlookups -= earlier.hashlookups;
+		hashprobes -= earlier.hashprobes;
+		return *this;
+  }
+};
+
+
+/**
+* @brief Log-linear histogram of latencies in nanoseconds. Each power of two is split into four buckets, so the bounds
+* of a bucket are within 25% of every latency it counts, and 252 buckets cover any 64-bit latency.
+*/
+struct LatencyHistogram
+{
+	/**
+   * Number of buckets
+	 */
+  static const int BUCKETS = 252;
+
+	/**
+   * Number of latencies in each bucket
+	 */
+  std::uint64_t counts[BUCKETS];
+
+	/**
+   * Number of latencies counted
+	 */
+  std::uint64_t total;
+
+	/**
+   * Sum of the latencies counted, in nanoseconds
+	 */
+  std::uint64_t sum;
+
+	/**
+   * Constructor of LatencyHistogram class; the histogram is empty
+	 */
+  LatencyHistogram();
+
+	/**
+   * Bucket counting a latency
+	 *
+	 * @param nanos	Latency in nanoseconds
+	 * @return  		Index of the bucket
+	 */
+  static int bucketOf(const std::uint64_t nanos)
+  {
+		if (nanos < 4)
+			return nanos;
+		const int log = 63 - __builtin_clzll(nanos);
+		return (log - 1) * 4 + ((nanos >> (log - 2)) & 3);
+  }
+
+	/**
+   * Largest latency a bucket counts
+	 *
+	 * @param bucket	Index of the bucket
+	 * @return  		Latency in nanoseconds
+	 */
+  static std::uint64_t bucketLimit(const int bucket);
+
+	/**
+   * Latency below which a fraction of the latencies counted fall, to the limit of the bucket it falls in
+	 *
+	 * @param fraction	Fraction of the latencies, from 0 to 1
+	 * @return  		Latency in nanoseconds, or 0 if the histogram is empty
+	 */
+  std::uint64_t percentile(const double fraction) const;
+
+	/**
+   * Subtract the counts of an earlier snapshot of the same histogram
+	 */
+  LatencyHistogram& operator-=(const LatencyHistogram& earlier);
+};
+
+
+/**
+* @brief Latencies of one BufMgr operation, counted by any number of threads at once without a latch.
+*/
+class LatencyRecorder
+{
+ private:
+	/**
+   * Number of latencies in each bucket of LatencyHistogram
+	 */
+  std::atomic<std::uint64_t> counts[LatencyHistogram::BUCKETS];
+
+	/**
+   * Sum of the latencies counted, in nanoseconds
+	 */
+  std::atomic<std::uint64_t> sum;
+
+	/**
+   * One past the highest bucket counted in, so that a snapshot reads only the buckets in use
+	 */
+  std::atomic<int> usedBuckets;
+
+ public:
+	/**
+   * Constructor of LatencyRecorder class
+	 */
+  LatencyRecorder()
+  {
+		clear();
+  }
+
+	/**
+   * Count a latency
+	 *
+	 * @param nanos	Latency in nanoseconds
+	 */
+  void record(const std::uint64_t nanos)
+  {
+		const int bucket = LatencyHistogram::bucketOf(nanos);
+		counts[bucket].fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(nanos, std::memory_order_relaxed);
+		int used = usedBuckets.load(std::memory_order_relaxed);
+		while (used <= bucket && !usedBuckets.compare_exchange_weak(used, bucket + 1, std::memory_order_relaxed))
+		{
+		}
+  }
+
+	/**
+   * Copy the latencies counted into a histogram
+	 */
+  void snapshot(LatencyHistogram& histogram) const;
+
+	/**
+   * Forget the latencies counted
+	 */
+  void clear();
+};
+
+
+/**
+* @brief Snapshot of the buffer pool metrics, returned by BufMgr::getMetrics(). Snapshots are plain values; the
+* difference of two is what happened between them.
+*/
+struct BufMetrics
+{
+	/**
+   * Buffer pool usage statistics
+	 */
+  BufStats stats;
+
+	/**
+   * Latencies of readPage(); only a sample of the calls is timed
+	 */
+  LatencyHistogram readLatency;
+
+	/**
+   * Latencies of a sample of allocPage() calls
+	 */
+  LatencyHistogram allocLatency;
+
+	/**
+   * Latencies of a sample of flushFile() calls
+	 */
+  LatencyHistogram flushLatency;
+
+	/**
+   * Hits and misses by file name
+	 */
+  std::map<std::string, FileAccesses> files;
+
+	/**
+   * What happened since an earlier snapshot
+	 *
+	 * @param earlier	Snapshot taken earlier from the same buffer manager
+	 * @return  		Counters of this snapshot less those of the earlier one
+	 */
+  BufMetrics since(const BufMetrics& earlier) const;
+
+	/**
+   * Print the metrics as text, one line per kind
+	 *
+	 * @param out	Stream printed to
+	 */
+  void print(std::ostream& out) const;
+};
+
+
+/**
+* @brief A pin on a page of the buffer pool, taken by BufMgr::fetchPage() and released when the guard is destroyed, is
+* assigned another pin, or release() is called. Guards are moved, never copied, so every pin has exactly one owner and is
+* released even when an exception unwinds past it. The page is unpinned dirty if markDirty() was called.
+*/
+class PageGuard
+{
+	friend class BufMgr;
+
+ private:
+	/**
+   * Buffer manager the page is pinned in, or NULL if the guard holds no page
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * File of the page
+	 */
+  File* file;
+
+	/**
+   * Page number of the page in the file
+	 */
+  PageId pageNum;
+
+	/**
+   * The pinned page
+	 */
+  Page* page;
+
+	/**
+   * True if the page is to be unpinned dirty
+	 */
+  bool dirty;
+
+  PageGuard(const PageGuard&) = delete;
+  PageGuard& operator=(const PageGuard&) = delete;
+
+ protected:
+	/**
+   * Constructor of PageGuard class, for a page just pinned
+	 */
+  PageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page, const bool dirty);
+
+ public:
+	/**
+   * Constructor of PageGuard class; the guard holds no page
+	 */
+  PageGuard();
+
+	/**
+   * Move constructor of PageGuard class; other is left holding no page
+	 */
+  PageGuard(PageGuard&& other);
+
+	/**
+   * Move assignment of PageGuard class; the page held before is unpinned, and other is left holding no page
+	 */
+  PageGuard& operator=(PageGuard&& other);
+
+	/**
+   * Destructor of PageGuard class; unpins the page
+	 */
+  ~PageGuard();
+
+	/**
+   * The pinned page, or NULL if the guard holds no page
+	 */
+  Page* get() const
+	{
+		return page;
+	}
+
+  Page* operator->() const
+	{
+		return page;
+	}
+
+  Page& operator*() const
+	{
+		return *page;
+	}
+
+	/**
+   * Page number of the pinned page, or Page::INVALID_NUMBER if the guard holds no page
+	 */
+  PageId pageNo() const
+	{
+		return pageNum;
+	}
+
+	/**
+   * True if the guard holds a page
+	 */
+  explicit operator bool() const
+	{
+		return page != NULL;
+	}
+
+	/**
+   * Have the page unpinned dirty
+	 */
+  void markDirty()
+	{
+		dirty = true;
+	}
+
+	/**
+   * Unpin the page now; the guard holds no page afterwards
+	 */
+  void release();
+};
+
+
+/**
+* @brief A PageGuard for a page that is changed: the page is always unpinned dirty.
+*/
+class WritePageGuard : public PageGuard
+{
+	friend class BufMgr;
+
+ private:
+	/**
+   * Constructor of WritePageGuard class, for a page just pinned
+	 */
+  WritePageGuard(BufMgr* bufMgr, File* file, const PageId pageNo, Page* page)
+		: PageGuard(bufMgr, file, pageNo, page, true)
+	{
+  }
+
+ public:
+	/**
+   * Constructor of WritePageGuard class; the guard holds no page
+	 */
+  WritePageGuard()
+	{
+  }
+
+	/**
+   * Move constructor of WritePageGuard class; other is left holding no page
+	 */
+  WritePageGuard(WritePageGuard&& other)
+		: PageGuard(std::move(other))
+	{
+  }
+
+	/**
+   * Move assignment of WritePageGuard class; the page held before is unpinned, and other is left holding no page
+	 */
+  WritePageGuard& operator=(WritePageGuard&& other)
+	{
+		PageGuard::operator=(std::move(other));
+		return *this;
+  }
+};
+
+
+/**
+* @brief Kind of memory pages the frames and their descriptors are mapped with
+*/
+enum PoolPages
+{
+	/**
+   * Base pages only
+	 */
+  SMALL_PAGES,
+
+	/**
+   * Base pages the kernel is asked to back with transparent huge pages (the default)
+	 */
+  TRANSPARENT_HUGE_PAGES,
+
+	/**
+   * Huge pages reserved by the administrator; transparent huge pages if not enough are free
+	 */
+  HUGE_PAGES
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file.
+* It may be shared by several threads. The page table is split into partitions, each with its own latch, and pin counts
+* are atomic. Threads that share a page guard its contents with latchPage(). Calls into a File are serialized by the
+* latch of its stream (File::ioLatch()), so threads using different files do not wait for each other. Which page to
+* evict is left to a ReplacementPolicy.
+*/
+class BufMgr 
+{
+	friend class PageGuard;
+
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+
+	/**
+   * Number of frames address space is reserved for; the pool can grow up to this
+	 */
+  std::uint32_t reservedBufs;
+
+	/**
+   * Kind of memory pages frames added to the pool are mapped with
+	 */
+  PoolPages pageKind;
+
+	/**
+   * True if frames added to the pool are interleaved over the NUMA nodes
+	 */
+  bool interleavePool;
+	
+	/**
+   * Held shared by every call that uses the frames, the page table or the replacement policy, and exclusive by
+   * resize(), which so waits until no such call is in progress. Calls may nest, as a shared hold never waits for
+   * another shared hold.
+	 */
+  FrameLatch resizeLatch;
+
+	/**
+   * Partitions of the page table mapping (File, page) to frame
+	 */
+  BufPartition *partitions;
+
+	/**
+   * Number of page table partitions, a power of two
+	 */
+  std::uint32_t numPartitions;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Bytes of address space reserved for bufDescTable
+	 */
+  std::size_t descTableBytes;
+
+	/**
+   * Bytes of address space reserved for bufPool
+	 */
+  std::size_t poolBytes;
+
+	/**
+   * Maintains Buffer pool usage statistics 
+	 */
+  BufStats bufStats;
+
+	/**
+   * Latencies of a sample of readPage(), allocPage() and flushFile() calls
+	 */
+  LatencyRecorder readLatency;
+  LatencyRecorder allocLatency;
+  LatencyRecorder flushLatency;
+
+	/**
+   * Decides which page to evict
+	 */
+  ReplacementPolicy *policy;
+
+	/**
+   * Background writer thread, if started
+	 */
+  std::thread writer;
+
+	/**
+   * Latch guarding writerStop, and waited on by the writer between rounds
+	 */
+  std::mutex writerLatch;
+
+	/**
+   * Signalled to wake the writer when it is to stop
+	 */
+  std::condition_variable writerWake;
+
+	/**
+   * True when the writer is to stop
+	 */
+  bool writerStop;
+
+	/**
+   * Quotas by file name. Entries are never removed, as frames point at them.
+	 */
+  std::map<std::string, FileQuotaState> fileQuotas;
+
+	/**
+   * Latch guarding fileQuotas
+	 */
+  std::mutex quotaLatch;
+
+	/**
+   * True once a quota has been set; until then no file name is looked up
+	 */
+  std::atomic<bool> hasQuotas;
+
+	/**
+   * Latch held while a frame unswizzles itself from the swip table of another frame, and while a frame's table is
+   * taken from it to be deleted, so that no table is deleted while it is written to
+	 */
+  std::mutex swipLatch;
+
+	/**
+   * Arguments the writer was last started with, to start it again after resize()
+	 */
+  std::uint32_t writerMaxPages;
+  std::uint32_t writerIntervalMs;
+
+	/**
+   * Page fault stream of each file, by file id
+	 */
+  std::unordered_map<std::uint32_t, ReadAheadStream> streams;
+
+	/**
+   * Latch guarding streams
+	 */
+  std::mutex streamLatch;
+
+	/**
+   * Most pages read ahead at once, or 0 not to read ahead
+	 */
+  std::atomic<std::uint32_t> maxReadAhead;
+
+	/**
+   * Partition of the page table holding (file, pageNo)
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  BufPartition& partitionOf(const File* file, const PageId pageNo)
+  {
+		return partitions[(BufHashTbl::mix(file->id(), pageNo) >> 32) & (numPartitions - 1)];
+  }
+
+	/**
+	 * Map memory for frames up to bufs, past the current end of the pool, and set them up empty.
+	 *
+	 * @param bufs   	New number of frames; at most reservedBufs
+	 * @throws std::bad_alloc If no memory can be mapped
+	 */
+  void addFrames(const std::uint32_t bufs);
+
+	/**
+	 * Drop the frames from bufs to the end of the pool, which hold no page, and unmap their memory.
+	 *
+	 * @param bufs   	New number of frames
+	 */
+  void removeFrames(const std::uint32_t bufs);
+
+	/**
+	 * Rebuild the table of each partition at a size fitting the number of frames, entering the pages it holds.
+	 */
+  void sizePageTable();
+
+	/**
+	 * Sum the page table and per-file counters of every partition into a snapshot, latching each partition once
+	 *
+	 * @param stats   Given the page table lookups and probes, hits and misses
+	 * @param files   If not NULL, given the hits and misses of each file
+	 */
+  void collectCounts(BufStats& stats, std::map<std::string, FileAccesses>* files);
+
+	/**
+	 * Which frames takeFrame() accepts
+	 */
+  enum FrameChoice
+  {
+  	/**
+  	 * Any frame that is not pinned
+  	 */
+  	ANY_FRAME,
+
+  	/**
+  	 * Frames that leave other files their reserved frames, and whose page has no chances left
+  	 */
+  	BY_QUOTA,
+
+  	/**
+  	 * Frames holding a page of the file the frame is for, which is at its most frames
+  	 */
+  	OWN_FRAME
+  };
+
+	/**
+	 * Allocate a free frame. The frame is returned taken over (its busy flag set) and invalid; the caller installs a page
+	 * in it and releases it.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocBuf(FrameId & frame, FileQuotaState* quota = NULL);
+
+	/**
+	 * Like allocBuf(), but only take a frame that is free or holds a clean page, so that no page is written to make
+	 * room.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @return  			False if no such frame could be found
+	 */
+  bool allocCleanBuf(FrameId & frame, FileQuotaState* quota = NULL);
+
+	/**
+	 * Which frames a file may take over under the quotas
+	 *
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @return  			ANY_FRAME if no quota is set, OWN_FRAME if the file is at its most frames, otherwise BY_QUOTA
+	 */
+  FrameChoice choiceFor(const FileQuotaState* quota);
+
+	/**
+	 * Ask the replacement policy for a frame to take over.
+	 *
+	 * @param frame   	Set to the frame taken over
+	 * @param cleanOnly	True to refuse a frame holding a dirty page
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @param choice	Which frames to accept
+	 * @return  			False if no frame could be taken over
+	 */
+  bool pickFrame(FrameId & frame, const bool cleanOnly, const FileQuotaState* quota, const FrameChoice choice);
+
+	/**
+	 * Take over a frame proposed by the replacement policy: if it holds no page, or a page that is not pinned, set its
+	 * busy flag and write the page back if dirty and remove it from the page table.
+	 *
+	 * @param frameNo Frame to take over
+	 * @param cleanOnly	True to refuse a frame holding a dirty page
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @param choice	Which frames to accept
+	 * @return  			True if the frame is now free and taken over
+	 */
+  bool takeFrame(const FrameId frameNo, const bool cleanOnly, const FileQuotaState* quota, const FrameChoice choice);
+
+	/**
+	 * Quota of a file
+	 *
+	 * @param file   	File object
+	 * @return  			The quota, or NULL if the file has none
+	 */
+  FileQuotaState* quotaOf(const File* file);
+
+	/**
+	 * Empty a frame this thread has taken over: if it holds a page nobody has pinned or used since it was last
+	 * considered, write the page back if dirty and remove it from the page table.
+	 *
+	 * @param frameNo Frame taken over
+	 * @return  			True if the frame is now free
+	 */
+  bool evictPage(const FrameId frameNo);
+
+	/**
+	 * Allocate a frame for a page read through a ring: the oldest frame of the ring if it can be reused, otherwise one
+	 * from the pool. Like allocBuf(), the frame is returned taken over and invalid.
+	 *
+	 * @param ring   	Ring
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param quota		Quota of the file the frame is for, or NULL
+	 * @return  			Slot of the ring the frame belongs to
+	 * @throws BufferExceededException If the ring needs a frame from the pool and none can be allocated
+	 */
+  std::uint32_t allocRingBuf(BufRing* ring, FrameId & frame, FileQuotaState* quota = NULL);
+
+	/**
+	 * Make a frame taken over by allocBuf() hold a page, pinned once, and enter it in the page table. If another thread
+	 * entered the same page meanwhile, that frame is pinned instead and this one is left free.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame taken over by allocBuf(); set to the frame that holds the page
+	 * @param cold		True if a bulk reader is loading the page
+	 * @param quota		Quota of the file, or NULL
+	 */
+  void installPage(File* file, const PageId pageNo, FrameId &frameNo, const bool cold, FileQuotaState* quota);
+
+	/**
+	 * Pin a page in the frame a swip or hint gives, without a page table lookup, if the frame still holds it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame the page was last found in
+	 * @return  			True if the page was pinned
+	 */
+  bool pinFrame(File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Tell the replacement policy and the page's quota of a page found in the buffer pool, and read ahead if the page
+	 * was marked by readAhead().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame holding the page, pinned
+	 * @param ring  	Ring the page is read through, or NULL
+	 */
+  void pageHit(File* file, const PageId pageNo, const FrameId frameNo, BufRing* ring);
+
+	/**
+	 * Make a swip of a page refer to the frame of the page it refers to from that slot.
+	 *
+	 * @param parentNo	Frame of the page holding the swip, pinned
+	 * @param slot		Slot of the swip, less than SWIPSLOTS
+	 * @param frameNo Frame of the page referred to, pinned
+	 */
+  void swizzle(const FrameId parentNo, const std::uint32_t slot, const FrameId frameNo);
+
+	/**
+	 * Unswizzle the swip that refers to a frame, and delete the swip table of the frame. Called while the frame is
+	 * taken over, before its page leaves the pool.
+	 *
+	 * @param frameNo Frame whose page is leaving
+	 */
+  void dropSwips(const FrameId frameNo);
+
+	/**
+	 * Unpin a page held by a PageGuard, found from its frame rather than the page table.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page		The pinned page
+	 * @param dirty		True if the page is to be marked dirty
+   * @throws  PageNotPinnedException If the page is not pinned
+	 */
+  void unPinFrame(File* file, const PageId pageNo, const Page* page, const bool dirty);
+
+	/**
+	 * Note a miss on a page, or a read of a page marked by readAhead(), in the file's stream, and decide which pages to
+	 * read ahead.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number missed or read
+	 * @param miss		True on a miss, false on reading a marked page
+	 * @param ring  	Ring the page is read through, or NULL; a ring reads at most half its size ahead
+	 * @param first		Set to the first page to read ahead
+	 * @param stride	Set to the distance between pages to read ahead
+	 * @param count		Set to the number of pages to read ahead
+	 * @return  			True if pages are to be read ahead
+	 */
+  bool nextReadAhead(const File* file, const PageId pageNo, const bool miss, const BufRing* ring, PageId& first,
+                     std::int64_t& stride, std::uint32_t& count);
+
+	/**
+	 * Read pages that are not in the buffer pool ahead of their request, into free or clean frames, or through a ring.
+	 * Consecutive pages are read with one call to File::readPages(). The pages are left unpinned, cold if read through a
+	 * ring, and the first one is marked so that reading it reads the next window ahead. Stops early at the end of the
+	 * file or when no frame is to be had.
+	 *
+	 * @param file   	File object
+	 * @param first		First page to read
+	 * @param stride	Distance between pages
+	 * @param count		Number of pages
+	 * @param ring  	Ring to read through, or NULL
+	 */
+  void readAhead(File* file, const PageId first, const std::int64_t stride, const std::uint32_t count, BufRing* ring);
+
+	/**
+	 * Body of the background writer: every interval, write back up to maxPages dirty pages among those the replacement
+	 * policy would evict next, until stopWriter() is called.
+	 *
+	 * @param maxPages	Largest number of pages written per round
+	 * @param intervalMs	Milliseconds between rounds
+	 */
+  void runWriter(const std::uint32_t maxPages, const std::uint32_t intervalMs);
+
+ public:
+	/**
+   * Called by readPages() with the index of each page requested, and the page, once it is pinned
+	 */
+  typedef std::function<void(std::size_t, Page*)> PageArrived;
+
+	/**
+   * Actual buffer pool from which frames are allocated. Frames are aligned to the memory page size, as direct I/O
+   * requires.
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames in the buffer pool; address space is reserved for at least 2^20 frames, so
+	 *								that resize() can grow the pool in place
+	 * @param replacement	Page replacement policy
+	 * @param pages		Kind of memory pages to map the buffer pool with
+	 * @param interleave	True to spread the buffer pool over all NUMA nodes the process may use, rather than place it
+	 *								on the node of the thread that first touches it
+	 */
+  BufMgr(std::uint32_t bufs, const Replacement replacement = CLOCK, const PoolPages pages = TRANSPARENT_HUGE_PAGES,
+         const bool interleave = false);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * When the misses on a file follow a steady stride, the next pages of the stride are read ahead.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	If not NULL, a page that is not in the buffer pool is read through this ring, and a page that is
+	 *								does not count as used again
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufRing* ring = NULL);
+
+	/**
+	 * Reads and pins several pages of a file, as if by readPage() for each in turn. The pages in the buffer pool are
+	 * pinned first; the others are read in page number order, each run of consecutive pages with one read. A page
+	 * requested twice is pinned twice. If an exception is thrown, every page this call pinned is unpinned again.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers in the file to be read
+	 * @param n				Number of pages
+	 * @param pages		Array of n page pointers. The page read for each page number is returned at the same index.
+	 * @param arrived	If set, called for each page as soon as it is pinned, hits first
+	 * @throws BufferExceededException If the buffer pool cannot hold all the pages pinned at once
+	 */
+  void readPages(File* file, const PageId* pageNos, const std::size_t n, Page** pages,
+                 const PageArrived& arrived = PageArrived());
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Reads a page as readPage() does, pinned until the guard returned lets it go.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param ring  	As for readPage()
+	 * @return  			Guard holding the page, unpinned clean unless marked dirty
+	 */
+  PageGuard fetchPage(File* file, const PageId pageNo, BufRing* ring = NULL);
+
+	/**
+	 * Reads a page as fetchPage() does, trying first the frame it was last found in.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param hint		Frame the page was last found in, or NOFRAME; set to the frame it is found in
+	 * @return  			Guard holding the page, unpinned clean unless marked dirty
+	 */
+  PageGuard fetchPageAt(File* file, const PageId pageNo, FrameId& hint);
+
+	/**
+	 * Reads a page that a pinned page refers to, as fetchPage() does. Once the page has been read, the swip of the
+	 * slot it is referred to from holds its frame, and while it stays in the buffer pool it is pinned from there without
+	 * a page table lookup. The swip is unswizzled when the page is evicted. A swip is checked against the page before
+	 * it is followed, so one left behind when the reference moved to another slot or page only costs a lookup.
+	 *
+	 * @param parent	Guard holding the page that refers to the page
+	 * @param slot		Slot of the reference in the parent; slots from SWIPSLOTS on are looked up every time
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file the slot refers to
+	 * @return  			Guard holding the page, unpinned clean unless marked dirty
+	 */
+  PageGuard fetchChild(const PageGuard& parent, const std::uint32_t slot, File* file, const PageId pageNo);
+
+	/**
+	 * Reads a page to change it, as readPage() does, pinned until the guard returned lets it go.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @return  			Guard holding the page, unpinned dirty
+	 */
+  WritePageGuard fetchPageForWrite(File* file, const PageId pageNo);
+
+	/**
+	 * Allocates a new page as allocPage() does, pinned until the guard returned lets it go.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  The number assigned to the page in the file is returned via this reference
+	 * @return  			Guard holding the page, unpinned dirty
+	 */
+  WritePageGuard newPage(File* file, PageId &pageNo);
+
+	/**
+	 * Writes out all dirty pages of the file to disk, in page number order, and frees their frames. Only the frames
+	 * holding pages of the file are visited.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * Write back, without evicting them, up to maxPages dirty and unpinned pages among the half of the pool the
+	 * replacement policy would evict next, so that page faults find clean victims. Frames busy or pinned are skipped.
+	 *
+	 * @param maxPages	Largest number of pages to write
+	 * @return  			Number of pages written
+	 */
+  std::uint32_t writeAhead(const std::uint32_t maxPages);
+
+	/**
+	 * Start a thread that calls writeAhead() every intervalMs milliseconds. The writer is stopped by stopWriter() or
+	 * by the destructor.
+	 *
+	 * The writer is opt-in because it only moves writes, it does not save any: each page it writes is still written
+	 * once, by another thread. That pays off when the foreground leaves a CPU idle between requests or writes wait on
+	 * a slow device, so faults find clean victims and return sooner. When the foreground keeps every CPU busy, the
+	 * writer's rounds compete with it, and pages changed again after being written cost a second write.
+	 *
+	 * @param maxPages	Largest number of pages written per round; bounds the writer's I/O to maxPages per interval
+	 * @param intervalMs	Milliseconds between rounds
+	 */
+  void startWriter(const std::uint32_t maxPages, const std::uint32_t intervalMs);
+
+	/**
+	 * Stop the background writer, if running, and wait for it to finish its round.
+	 */
+  void stopWriter();
+
+	/**
+	 * Set the quota of a file, or of every file opened under its name, replacing any quota set before. Pages of the file
+	 * already in the buffer pool count towards it from now on.
+	 *
+	 * @param filename	Name of the file
+	 * @param quota		Reserved frames, most frames and priority of the file's pages; FileQuota() to treat the file
+	 *								like any other
+	 */
+  void setFileQuota(const std::string& filename, const FileQuota& quota);
+
+	/**
+	 * Grow or shrink the buffer pool. Frames are added or removed at the end of the pool, so pages in the frames kept
+	 * stay where they are, pinned or not. Pages in removed frames are evicted, written back first if dirty. The page
+	 * table is rebuilt for the new size; the number of partitions stays as set at construction, and so does the
+	 * limit on reading ahead. A running background writer is stopped for the resize and started again.
+	 *
+	 * Other threads may use the buffer manager meanwhile: the resize waits until no call is in progress and holds new
+	 * calls back until it is done. Pages they keep pinned between calls stay where they are if their frames are kept.
+	 *
+	 * @param bufs   	New number of frames
+	 * @throws BufferExceededException If bufs is 0, or more than the larger of the initial size and 2^20 frames
+	 * @throws PagePinnedException If a page in a frame to remove is pinned; nothing is evicted then
+	 */
+  void resize(const std::uint32_t bufs);
+
+	/**
+	 * Set how many pages at most are read ahead at once. By default, 32 or an eighth of the buffer pool, whichever is
+	 * smaller.
+	 *
+	 * @param pages		Most pages read ahead at once, or 0 not to read ahead
+	 */
+  void setMaxReadAhead(const std::uint32_t pages);
+
+	/**
+	 * Latch the contents of a pinned page, shared to read it or exclusive to change it. Only needed when other threads
+	 * may use the page at the same time.
+	 *
+	 * @param page  	Page returned by readPage() or allocPage()
+	 * @param exclusive	True to take the latch exclusive
+	 */
+  void latchPage(const Page* page, const bool exclusive);
+
+	/**
+	 * Release a latch taken with latchPage().
+	 *
+	 * @param page  	Page passed to latchPage()
+	 * @param exclusive	True if the latch was taken exclusive
+	 */
+  void unlatchPage(const Page* page, const bool exclusive);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+   * Get buffer pool usage statistics
+	 */
+  BufStats & getBufStats();
+
+	/**
+   * Take a snapshot of the buffer pool usage statistics, the operation latencies and the hits and misses of each file
+	 */
+  BufMetrics getMetrics();
+
+	/**
+   * Clear buffer pool usage statistics, latencies and per-file counts
+	 */
+  void clearBufStats();
+};
+
 }
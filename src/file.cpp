@@ -13,6 +13,7 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <algorithm>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -24,7 +25,9 @@
 namespace badgerdb {
 
 File::StreamMap File::open_streams_;
+File::LatchMap File::open_latches_;
 File::CountMap File::open_counts_;
+std::uint32_t File::next_id_ = 1;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -64,7 +67,8 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+File::File(const std::string& name, const bool create_new)
+    : filename_(name), id_(next_id_++) {
   openIfNeeded(create_new);
 
   if (create_new) {
@@ -79,6 +83,7 @@ void File::openIfNeeded(const bool create_new) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    latch_ = open_latches_[filename_];
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -98,6 +103,8 @@ void File::openIfNeeded(const bool create_new) {
     }
     stream_.reset(new std::fstream(filename_, mode));
     open_streams_[filename_] = stream_;
+    latch_.reset(new std::mutex);
+    open_latches_[filename_] = latch_;
     open_counts_[filename_] = 1;
   }
 }
@@ -107,10 +114,12 @@ void File::close() {
   	--open_counts_[filename_];
 
   stream_.reset();
+  latch_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
+    open_latches_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
@@ -257,6 +266,26 @@ Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   return page;
 }
 
+std::uint32_t PageFile::readPages(const PageId first_page_number,
+                                  const std::uint32_t count,
+                                  Page* pages) const {
+  FileHeader header = readHeader();
+  if (first_page_number >= header.num_pages) {
+    return 0;
+  }
+
+  std::uint32_t available =
+      std::min<std::uint32_t>(count, header.num_pages - first_page_number);
+  stream_->seekg(pagePosition(first_page_number), std::ios::beg);
+  stream_->read(reinterpret_cast<char*>(pages), available * Page::SIZE);
+
+  std::uint32_t num_read = 0;
+  while (num_read < available && pages[num_read].isUsed()) {
+    ++num_read;
+  }
+  return num_read;
+}
+
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
@@ -385,6 +414,17 @@ Page BlobFile::readPage(const PageId page_number) const {
 	return page;
 }
 
+std::uint32_t BlobFile::readPages(const PageId first_page_number,
+                                  const std::uint32_t count,
+                                  Page* pages) const {
+	stream_->seekg(pagePosition(first_page_number), std::ios::beg);
+	stream_->read(reinterpret_cast<char*>(pages), count * Page::SIZE);
+	std::uint32_t num_read = stream_->gcount() / Page::SIZE;
+	// a short read at the end of the file leaves the stream failed
+	stream_->clear();
+	return num_read;
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
 	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
 	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
@@ -7,10 +7,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "page.h"
 
@@ -134,6 +136,19 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads consecutive pages from the file with a single read.  Reading stops
+   * early at the end of the file, or at the first page not currently used.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of at least count pages to read into.
+   * @return  The number of pages read.
+   */
+  virtual std::uint32_t readPages(const PageId first_page_number,
+                                  const std::uint32_t count,
+                                  Page* pages) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -157,6 +172,24 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns a small number identifying this File object for as long as it
+   * exists. Copies of a File get their own id. Unlike the object's address,
+   * ids are handed out densely, so they hash the same way from run to run.
+   *
+   * @return Id of this File object, never 0.
+   */
+  std::uint32_t id() const { return id_; }
+
+  /**
+   * Returns the latch that serializes I/O on the underlying stream. File
+   * objects for the same filesystem file share the stream, and so the latch.
+   * Callers that use the file from several threads hold it around each call.
+   *
+   * @return Latch of the underlying stream.
+   */
+  std::mutex& ioLatch() const { return *latch_; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -211,6 +244,7 @@ class File {
   void writeHeader(const FileHeader& header);
 
   typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  typedef std::map<std::string, std::shared_ptr<std::mutex> > LatchMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
@@ -218,11 +252,21 @@ class File {
    */
   static StreamMap open_streams_;
 
+  /**
+   * I/O latches for opened files, one per stream.
+   */
+  static LatchMap open_latches_;
+
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Id given to the next File object constructed.
+   */
+  static std::uint32_t next_id_;
+
   /**
    * Name of the file this object represents.
    */
@@ -233,6 +277,16 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Latch for I/O on stream_.
+   */
+  std::shared_ptr<std::mutex> latch_;
+
+  /**
+   * Id of this File object.
+   */
+  std::uint32_t id_;
+
   friend class FileIterator;
 };
 
@@ -310,6 +364,19 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads consecutive pages from the file with a single read.  Reading stops
+   * early at the end of the file, or at the first page not currently used.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of at least count pages to read into.
+   * @return  The number of pages read.
+   */
+  std::uint32_t readPages(const PageId first_page_number,
+                          const std::uint32_t count,
+                          Page* pages) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -458,6 +525,19 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads consecutive pages from the file with a single read.  Reading stops
+   * early at the end of the file, or at the first page not currently used.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of at least count pages to read into.
+   * @return  The number of pages read.
+   */
+  std::uint32_t readPages(const PageId first_page_number,
+                          const std::uint32_t count,
+                          Page* pages) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -18,7 +18,14 @@
 namespace badgerdb {
 
 /**
- * @brief This class is used to sequentially scan records in a relation.
+ * @brief Number of frames a FileScan reads its pages through.
+ */
+const std::uint32_t FILESCANRINGSIZE = 16;
+
+/**
+ * @brief This class is used to sequentially scan records in a relation. Pages
+ * are read through a small BufRing, so a scan of any size leaves the rest of
+ * the buffer pool alone.
  */
 class FileScan
 {
@@ -49,17 +56,17 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Current page being scanned, and whether it has been updated.
    */
-  Page*         curPage;
-
-  FileIterator  filePageIter;
-  PageIterator  pageRecordIter;
+  PageGuard     curPage;
 
   /**
-   * True if page has been updated
+   * Frames the scan reads its pages through.
    */
-  bool  	      curDirtyFlag;
+  BufRing       ring;
+
+  FileIterator  filePageIter;
+  PageIterator  pageRecordIter;
 };
 
 }
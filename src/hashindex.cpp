@@ -0,0 +1,424 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "hashindex.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <sstream>
+
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+#include "filescan.h"
+
+namespace badgerdb {
+
+// -----------------------------------------------------------------------------
+// HashIndex::HashIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+HashIndex::HashIndex(const std::string &relationName,
+                     std::string &outIndexName, BufMgr *bufMgrIn,
+                     const int attrByteOffset, const Datatype attrType) {
+  std::ostringstream idxStr;
+  idxStr << relationName << '.' << attrByteOffset << ".hash";
+  outIndexName = idxStr.str();
+
+  if (attrType != INTEGER && attrType != DOUBLE) {
+    throw BadIndexInfoException(outIndexName);
+  }
+
+  this->bufMgr = bufMgrIn;
+  this->attributeType = attrType;
+  this->attrByteOffset = attrByteOffset;
+
+  // Scanning related members
+  this->scanExecuting = false;
+  this->scanKey = 0;
+  this->nextEntry = INT_MAX;
+  this->currentPageNum = Page::INVALID_NUMBER;
+  this->currentPageData = nullptr;
+
+  try {
+    this->file = new BlobFile(outIndexName, false);
+    this->headerPageNum = file->getFirstPageNo();
+
+    badgerdb::Page *metaPage;
+    this->bufMgr->readPage(file, this->headerPageNum, metaPage);
+    HashIndexMetaInfo *meta = reinterpret_cast<HashIndexMetaInfo *>(metaPage);
+
+    bool matches =
+        strncmp(meta->relationName, relationName.c_str(),
+                sizeof(meta->relationName) - 1) == 0 &&
+        meta->attrByteOffset == attrByteOffset && meta->attrType == attrType;
+
+    this->globalDepth = meta->globalDepth;
+    this->directoryPages.assign(
+        meta->directoryPageNo, meta->directoryPageNo + meta->directoryPageCount);
+    this->bufMgr->unPinPage(file, this->headerPageNum, false);
+
+    if (!matches) {
+      delete this->file;
+      throw BadIndexInfoException(outIndexName);
+    }
+
+    // Load the directory
+    this->directory.resize(std::size_t(1) << this->globalDepth);
+    for (std::size_t first = 0; first < this->directory.size();
+         first += HASHDIRECTORYPAGESIZE) {
+      PageId dirPageNo = this->directoryPages[first / HASHDIRECTORYPAGESIZE];
+      Page *dirPage;
+      this->bufMgr->readPage(file, dirPageNo, dirPage);
+      const PageId *entries = reinterpret_cast<const PageId *>(dirPage);
+      std::size_t last = std::min(this->directory.size(),
+                                  first + HASHDIRECTORYPAGESIZE);
+      std::copy(entries, entries + (last - first),
+                this->directory.begin() + first);
+      this->bufMgr->unPinPage(file, dirPageNo, false);
+    }
+  } catch (const badgerdb::FileNotFoundException &e) {
+    // build the index
+    this->file = new BlobFile(outIndexName, true);
+
+    Page *headPage;
+    this->bufMgr->allocPage(file, this->headerPageNum, headPage);
+    HashIndexMetaInfo *metaInfo =
+        reinterpret_cast<HashIndexMetaInfo *>(headPage);
+    strncpy(metaInfo->relationName, relationName.c_str(),
+            sizeof(metaInfo->relationName) - 1);
+    metaInfo->relationName[sizeof(metaInfo->relationName) - 1] = '\0';
+    metaInfo->attrByteOffset = attrByteOffset;
+    metaInfo->attrType = attrType;
+    metaInfo->globalDepth = 0;
+    metaInfo->directoryPageCount = 0;
+    this->bufMgr->unPinPage(this->file, this->headerPageNum, true);
+
+    // Start with a single empty bucket
+    PageId bucketPageNo;
+    Page *bucketPage;
+    this->bufMgr->allocPage(file, bucketPageNo, bucketPage);
+    HashBucket *bucket = reinterpret_cast<HashBucket *>(bucketPage);
+    bucket->localDepth = 0;
+    bucket->count = 0;
+    bucket->overflowPageNo = Page::INVALID_NUMBER;
+    this->bufMgr->unPinPage(this->file, bucketPageNo, true);
+
+    this->globalDepth = 0;
+    this->directory.assign(1, bucketPageNo);
+    writeDirectory(0, 1);
+    writeMeta();
+
+    // Insert an entry for every record of the relation
+    FileScan scanner(relationName, this->bufMgr);
+    try {
+      RecordId rid;
+      while (1) {
+        scanner.scanNext(rid);
+        std::string recordStr = scanner.getRecord();
+        this->insertEntry(recordStr.c_str() + attrByteOffset, rid);
+      }
+    } catch (const EndOfFileException &e) {
+      // Finish inserting all the records
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::~HashIndex -- destructor
+// -----------------------------------------------------------------------------
+
+HashIndex::~HashIndex() {
+  try {
+    if (scanExecuting) {
+      endScan();
+    }
+    this->bufMgr->flushFile(this->file);
+  } catch (const BadgerDbException &e) {
+    // Destructor must not throw
+  }
+  delete this->file;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void HashIndex::insertEntry(const void *key, const RecordId rid) {
+  NormalizedKey normKey = normalizeKey(key, this->attributeType);
+  std::uint64_t hash = hashNormalizedKey(normKey);
+
+  while (true) {
+    PageId pageNo = this->directory[hash & (this->directory.size() - 1)];
+    Page *page;
+    this->bufMgr->readPage(this->file, pageNo, page);
+    HashBucket *bucket = reinterpret_cast<HashBucket *>(page);
+
+    if (bucket->count < HASHBUCKETSIZE) {
+      bucket->keyArray[bucket->count] = normKey;
+      bucket->ridArray[bucket->count] = rid;
+      bucket->count++;
+      this->bufMgr->unPinPage(this->file, pageNo, true);
+      break;
+    }
+
+    // A bucket full of one key cannot be split apart, and the directory
+    // stops growing at the largest depth
+    bool oneKey = std::count(bucket->keyArray, bucket->keyArray + bucket->count,
+                             normKey) == bucket->count;
+    if (oneKey || bucket->localDepth == HASHMAXGLOBALDEPTH) {
+      this->bufMgr->unPinPage(this->file, pageNo, false);
+      insertOverflow(pageNo, normKey, rid);
+      break;
+    }
+
+    if (bucket->localDepth == this->globalDepth) {
+      doubleDirectory();
+    }
+    splitBucket(pageNo, bucket);
+    this->bufMgr->unPinPage(this->file, pageNo, true);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::insertOverflow
+// -----------------------------------------------------------------------------
+
+void HashIndex::insertOverflow(PageId pageNo, NormalizedKey key,
+                               const RecordId &rid) {
+  while (true) {
+    Page *page;
+    this->bufMgr->readPage(this->file, pageNo, page);
+    HashBucket *bucket = reinterpret_cast<HashBucket *>(page);
+
+    if (bucket->count < HASHBUCKETSIZE) {
+      bucket->keyArray[bucket->count] = key;
+      bucket->ridArray[bucket->count] = rid;
+      bucket->count++;
+      this->bufMgr->unPinPage(this->file, pageNo, true);
+      return;
+    }
+
+    if (bucket->overflowPageNo == Page::INVALID_NUMBER) {
+      PageId newPageNo;
+      Page *newPage;
+      this->bufMgr->allocPage(this->file, newPageNo, newPage);
+      HashBucket *overflow = reinterpret_cast<HashBucket *>(newPage);
+      overflow->localDepth = bucket->localDepth;
+      overflow->count = 1;
+      overflow->overflowPageNo = Page::INVALID_NUMBER;
+      overflow->keyArray[0] = key;
+      overflow->ridArray[0] = rid;
+      bucket->overflowPageNo = newPageNo;
+      this->bufMgr->unPinPage(this->file, newPageNo, true);
+      this->bufMgr->unPinPage(this->file, pageNo, true);
+      return;
+    }
+
+    PageId nextPageNo = bucket->overflowPageNo;
+    this->bufMgr->unPinPage(this->file, pageNo, false);
+    pageNo = nextPageNo;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::splitBucket
+// -----------------------------------------------------------------------------
+
+void HashIndex::splitBucket(PageId pageNo, HashBucket *bucket) {
+  std::uint64_t bit = std::uint64_t(1) << bucket->localDepth;
+  // Hash bits shared by every directory entry pointing to the bucket
+  std::uint64_t prefix = hashNormalizedKey(bucket->keyArray[0]) & (bit - 1);
+
+  PageId newPageNo;
+  Page *newPage;
+  this->bufMgr->allocPage(this->file, newPageNo, newPage);
+  HashBucket *newBucket = reinterpret_cast<HashBucket *>(newPage);
+  bucket->localDepth++;
+  newBucket->localDepth = bucket->localDepth;
+  newBucket->count = 0;
+  newBucket->overflowPageNo = Page::INVALID_NUMBER;
+
+  int kept = 0;
+  for (int i = 0; i < bucket->count; i++) {
+    if (hashNormalizedKey(bucket->keyArray[i]) & bit) {
+      newBucket->keyArray[newBucket->count] = bucket->keyArray[i];
+      newBucket->ridArray[newBucket->count] = bucket->ridArray[i];
+      newBucket->count++;
+    } else {
+      bucket->keyArray[kept] = bucket->keyArray[i];
+      bucket->ridArray[kept] = bucket->ridArray[i];
+      kept++;
+    }
+  }
+  bucket->count = kept;
+
+  // Only a bucket of one key has overflow pages; they follow the key
+  if (kept == 0) {
+    newBucket->overflowPageNo = bucket->overflowPageNo;
+    bucket->overflowPageNo = Page::INVALID_NUMBER;
+  }
+  this->bufMgr->unPinPage(this->file, newPageNo, true);
+
+  for (std::size_t idx = prefix | bit; idx < this->directory.size();
+       idx += 2 * bit) {
+    this->directory[idx] = newPageNo;
+    writeDirectory(idx, idx + 1);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::doubleDirectory
+// -----------------------------------------------------------------------------
+
+void HashIndex::doubleDirectory() {
+  std::size_t oldSize = this->directory.size();
+  this->directory.resize(2 * oldSize);
+  std::copy(this->directory.begin(), this->directory.begin() + oldSize,
+            this->directory.begin() + oldSize);
+  this->globalDepth++;
+
+  writeDirectory(oldSize, 2 * oldSize);
+  writeMeta();
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::writeDirectory
+// -----------------------------------------------------------------------------
+
+void HashIndex::writeDirectory(std::size_t first, std::size_t last) {
+  while (first < last) {
+    std::size_t pageIdx = first / HASHDIRECTORYPAGESIZE;
+    std::size_t pageEnd =
+        std::min(last, (pageIdx + 1) * HASHDIRECTORYPAGESIZE);
+
+    PageId dirPageNo;
+    Page *dirPage;
+    if (pageIdx < this->directoryPages.size()) {
+      dirPageNo = this->directoryPages[pageIdx];
+      this->bufMgr->readPage(this->file, dirPageNo, dirPage);
+    } else {
+      this->bufMgr->allocPage(this->file, dirPageNo, dirPage);
+      this->directoryPages.push_back(dirPageNo);
+    }
+
+    PageId *entries = reinterpret_cast<PageId *>(dirPage);
+    std::copy(this->directory.begin() + first,
+              this->directory.begin() + pageEnd,
+              entries + first % HASHDIRECTORYPAGESIZE);
+    this->bufMgr->unPinPage(this->file, dirPageNo, true);
+    first = pageEnd;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::writeMeta
+// -----------------------------------------------------------------------------
+
+void HashIndex::writeMeta() {
+  Page *metaPage;
+  this->bufMgr->readPage(this->file, this->headerPageNum, metaPage);
+  HashIndexMetaInfo *meta = reinterpret_cast<HashIndexMetaInfo *>(metaPage);
+  meta->globalDepth = this->globalDepth;
+  meta->directoryPageCount = this->directoryPages.size();
+  std::copy(this->directoryPages.begin(), this->directoryPages.end(),
+            meta->directoryPageNo);
+  this->bufMgr->unPinPage(this->file, this->headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::startScan
+// -----------------------------------------------------------------------------
+
+void HashIndex::startScan(const void *key) {
+  if (scanExecuting) {
+    endScan();
+  }
+
+  scanKey = normalizeKey(key, this->attributeType);
+  currentPageNum =
+      directory[hashNormalizedKey(scanKey) & (directory.size() - 1)];
+  bufMgr->readPage(file, currentPageNum, currentPageData);
+  nextEntry = 0;
+
+  if (!seekKey()) {
+    bufMgr->unPinPage(file, currentPageNum, false);
+    currentPageData = nullptr;
+    currentPageNum = Page::INVALID_NUMBER;
+    throw NoSuchKeyFoundException();
+  }
+  scanExecuting = true;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::seekKey
+// -----------------------------------------------------------------------------
+
+bool HashIndex::seekKey() {
+  while (true) {
+    HashBucket *bucket = reinterpret_cast<HashBucket *>(currentPageData);
+    for (; nextEntry < bucket->count; nextEntry++) {
+      if (bucket->keyArray[nextEntry] == scanKey) {
+        return true;
+      }
+    }
+
+    PageId nextPageNo = bucket->overflowPageNo;
+    if (nextPageNo == Page::INVALID_NUMBER) {
+      return false;
+    }
+    Page *nextPage;
+    bufMgr->readPage(file, nextPageNo, nextPage);
+    bufMgr->unPinPage(file, currentPageNum, false);
+    currentPageNum = nextPageNo;
+    currentPageData = nextPage;
+    nextEntry = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void HashIndex::scanNext(RecordId &outRid) {
+  if (scanExecuting == false) {
+    throw ScanNotInitializedException();
+  }
+
+  if (!seekKey()) {
+    throw IndexScanCompletedException();
+  }
+
+  HashBucket *bucket = reinterpret_cast<HashBucket *>(currentPageData);
+  outRid = bucket->ridArray[nextEntry];
+  nextEntry++;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::endScan
+// -----------------------------------------------------------------------------
+
+void HashIndex::endScan() {
+  if (scanExecuting == false) {
+    throw ScanNotInitializedException();
+  }
+
+  scanExecuting = false;
+  bufMgr->unPinPage(file, currentPageNum, false);
+
+  scanKey = 0;
+  nextEntry = -1;
+  currentPageData = nullptr;
+  currentPageNum = Page::INVALID_NUMBER;
+}
+
+}  // namespace badgerdb
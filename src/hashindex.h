@@ -0,0 +1,325 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Number of directory entries held by one directory page.
+ */
+const int HASHDIRECTORYPAGESIZE = Page::SIZE / sizeof(PageId);
+
+/**
+ * @brief Maximum number of directory pages, and so the largest directory.
+ */
+const int HASHMAXDIRECTORYPAGES = 256;
+
+/**
+ * @brief Largest global depth: the directory never grows past
+ * HASHMAXDIRECTORYPAGES pages. Buckets that are still full at this depth get
+ * overflow pages.
+ */
+const int HASHMAXGLOBALDEPTH = 19;
+
+static_assert((1 << HASHMAXGLOBALDEPTH) <=
+                  HASHMAXDIRECTORYPAGES * HASHDIRECTORYPAGESIZE,
+              "Largest directory must fit in its pages.");
+
+/**
+ * @brief Number of entry slots in a hash bucket page.
+ */
+//                                          localDepth, count
+//                                          overflow ptr, padding
+const int HASHBUCKETSIZE =
+    (Page::SIZE - 2 * sizeof(int) - 2 * sizeof(PageId)) /
+    (sizeof(NormalizedKey) + sizeof(RecordId));
+
+/**
+ * @brief The meta page of a hash index file. It is the first page of the
+ * file and, like IndexMetaInfo for a B+ tree, identifies the relation and
+ * attribute the index was built over. It also lists the pages holding the
+ * directory.
+ */
+struct HashIndexMetaInfo {
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored
+   * in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Number of hash bits the directory is indexed by. The directory has
+   * 2^globalDepth entries.
+   */
+  int globalDepth;
+
+  /**
+   * Number of pages allocated to the directory.
+   */
+  int directoryPageCount;
+
+  /**
+   * Page numbers of the directory pages, in order.
+   */
+  PageId directoryPageNo[HASHMAXDIRECTORYPAGES];
+};
+
+/**
+ * @brief Structure of a bucket page. Entries are kept unordered. Entries of
+ * one key can outgrow a bucket, as no split separates them; they continue in
+ * a chain of overflow pages with the same layout.
+ */
+struct HashBucket {
+  /**
+   * Number of hash bits shared by every key in the bucket. The bucket is
+   * pointed to by 2^(globalDepth - localDepth) directory entries.
+   */
+  int localDepth;
+
+  /**
+   * Number of entries in the page.
+   */
+  int count;
+
+  /**
+   * Page number of the next overflow page, or Page::INVALID_NUMBER.
+   */
+  PageId overflowPageNo;
+
+  /**
+   * Stores normalized keys.
+   */
+  NormalizedKey keyArray[HASHBUCKETSIZE];
+
+  /**
+   * Stores RecordIds.
+   */
+  RecordId ridArray[HASHBUCKETSIZE];
+};
+
+static_assert(sizeof(HashIndexMetaInfo) <= Page::SIZE,
+              "Hash index meta info must fit in a page.");
+static_assert(sizeof(HashBucket) <= Page::SIZE,
+              "Hash bucket must fit in a page.");
+
+/**
+ * @brief HashIndex class. It implements an extendible hash index on a single
+ * attribute of a relation, for attributes that are only probed by equality.
+ * The directory is kept in memory while the index is open, so a probe reads
+ * a single bucket page. A full bucket is split in two and, when it was
+ * pointed to by a single directory entry, the directory is doubled first;
+ * no other bucket is touched. This index supports only one scan at a time.
+ */
+class HashIndex {
+ private:
+  /**
+   * File object for the index file.
+   */
+  File* file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr* bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+  PageId headerPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+  int attrByteOffset;
+
+  /**
+   * Number of hash bits the directory is indexed by.
+   */
+  int globalDepth;
+
+  /**
+   * In-memory copy of the directory: bucket page number by hash prefix.
+   */
+  std::vector<PageId> directory;
+
+  /**
+   * Page numbers of the directory pages.
+   */
+  std::vector<PageId> directoryPages;
+
+  // MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * True if a probe has been started.
+   */
+  bool scanExecuting;
+
+  /**
+   * Normalized key being probed for.
+   */
+  NormalizedKey scanKey;
+
+  /**
+   * Index of next entry to be examined in the current page.
+   */
+  int nextEntry;
+
+  /**
+   * Page number of the bucket or overflow page being scanned.
+   */
+  PageId currentPageNum;
+
+  /**
+   * Bucket or overflow page being scanned.
+   */
+  Page* currentPageData;
+
+  /**
+   * Add an entry to the end of a bucket's overflow chain, adding an overflow
+   * page if the chain is full.
+   *
+   * @param pageNo      Page number of the bucket
+   * @param key         Normalized key
+   * @param rid         Record id
+   */
+  void insertOverflow(PageId pageNo, NormalizedKey key, const RecordId& rid);
+
+  /**
+   * Split a full bucket on its next hash bit, moving the entries with that
+   * bit set to a new bucket and pointing half of the bucket's directory
+   * entries at it.
+   *
+   * @param pageNo      Page number of the bucket
+   * @param bucket      Bucket, pinned by the caller
+   */
+  void splitBucket(PageId pageNo, HashBucket* bucket);
+
+  /**
+   * Double the directory. The new half is a copy of the old one, so only
+   * directory pages are written.
+   */
+  void doubleDirectory();
+
+  /**
+   * Write a range of directory entries back to their directory pages.
+   *
+   * @param first       First entry to write
+   * @param last        One past the last entry to write
+   */
+  void writeDirectory(std::size_t first, std::size_t last);
+
+  /**
+   * Record the global depth and the directory pages in the meta page.
+   */
+  void writeMeta();
+
+  /**
+   * Find the next entry of the probed key, from nextEntry in the current page
+   * on along the overflow chain.
+   *
+   * @return  False if there are no more entries of the key
+   */
+  bool seekKey();
+
+ public:
+  /**
+   * HashIndex Constructor.
+   * Check to see if the corresponding index file exists. If so, open the
+   *file. If not, create it and insert entries for every tuple in the base
+   *relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is
+   * to be built, in the record
+   * @param attrType						Datatype of
+   * attribute over which index is built
+   * @throws  BadIndexInfoException     If the index file already exists for
+   * the corresponding attribute, but values in metapage(relationName,
+   * attribute byte offset, attribute type etc.) do not match with values
+   * received through constructor parameters, or if the attribute is a STRING.
+   * Buckets keep only the normalized key, which for a STRING is a prefix, so
+   * probes could not tell keys sharing that prefix apart.
+   */
+  HashIndex(const std::string& relationName, std::string& outIndexName,
+            BufMgr* bufMgrIn, const int attrByteOffset,
+            const Datatype attrType);
+
+  /**
+   * HashIndex Destructor.
+   * End any initialized probe, flush index file, after unpinning any pinned
+   * pages, from the buffer manager and delete file instance thereby closing
+   * the index file.
+   * */
+  ~HashIndex();
+
+  /**
+   * Insert a new entry using the pair <value,rid>. The index file is only
+   * flushed when the index is closed.
+   * @param key			Key to insert, pointer to integer/double/char
+   *string
+   * @param rid			Record ID of a record whose entry is getting
+   *inserted into the index.
+   **/
+  void insertEntry(const void* key, const RecordId rid);
+
+  /**
+   * Begin an equality probe of the index. If another probe is already
+   *executing, that needs to be ended here. The page holding the first match
+   *is kept pinned in the buffer pool.
+   * @param key			Key to look for, pointer to integer/double/char
+   *string
+   * @throws  NoSuchKeyFoundException If the key is not in the index.
+   **/
+  void startScan(const void* key);
+
+  /**
+   * Fetch the record id of the next entry of the probed key.
+   * @param outRid	RecordId of next matching entry returned in this
+   * @throws ScanNotInitializedException If no probe has been initialized.
+   * @throws IndexScanCompletedException If no more entries of the key are
+   *left.
+   **/
+  void scanNext(RecordId& outRid);
+
+  /**
+   * Terminate the current probe. Unpin any pinned pages. Reset probe specific
+   *variables.
+   * @throws ScanNotInitializedException If no probe has been initialized.
+   **/
+  void endScan();
+};
+
+}  // namespace badgerdb
@@ -6,19 +6,26 @@
  * of Wisconsin-Madison.
  */
 
+#include <fstream>
 #include <vector>
 
 #include "btree.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_page_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "file_iterator.h"
 #include "filescan.h"
+#include "hashindex.h"
 #include "page.h"
 #include "page_iterator.h"
 
@@ -46,6 +53,7 @@ const std::string relationName = "relA";
 // the scan, else tests will erroneously be reported to have failed.
 const int relationSize = 5000;
 std::string intIndexName, doubleIndexName, stringIndexName;
+std::string intHashIndexName;
 
 // This is the structure for tuples in the base relation
 
@@ -70,12 +78,37 @@ void createRelationForward();
 void createRelationBackward();
 void createRelationRandom();
 void createRelationSparse();
+void createRelationSharedPrefix();
 void initReopenExistingIndex();
 void intTestsSparse();
+void intTestsLeafFilter();
+void intTestsDeltaBuffer();
+void intTestsMessageBuffers();
+void intTestsHash();
+void intTestsLearnedLayer();
+void intTestsCompressedLeaves();
+void intTestsSwizzled();
+long indexFileSize(const std::string &indexName);
+int hashProbe(HashIndex *index, int key);
+int intProbe(BTreeIndex *index, int key);
 void intTestsOutOfRange();
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
             Operator highOp);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp);
+void stringTests();
+void stringTestsSharedPrefix();
+int sharedPrefixScan(BTreeIndex *index, int lowVal, Operator lowOp,
+                     int highVal, Operator highOp);
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+               Operator highOp);
+int scanResults(BTreeIndex *index);
+int intRangeScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+                 Operator highOp);
+int multiScan(BTreeIndex *index, const std::vector<ScanRange> &ranges);
+int intInListScan(BTreeIndex *index, int first, int last, int step);
 void indexTests();
 void indexTestsSparse();
 void reopenExistingIndexTest();
@@ -88,6 +121,12 @@ void additionTest2();
 void additionTest3();
 void additionTest4();
 void errorTests();
+void fillBufferFile(BufMgr *pool, File *file, const int numPages,
+                    std::vector<PageId> &pageNos, std::vector<RecordId> &rids,
+                    std::vector<std::string> &contents);
+void readPagesTests();
+void resizeTests();
+void quotaTests();
 void deleteRelation();
 
 int main(int argc, char **argv) {
@@ -145,7 +184,11 @@ int main(int argc, char **argv) {
   additionTest1();
   additionTest2();
   additionTest3();
+  additionTest4();
   errorTests();
+  readPagesTests();
+  resizeTests();
+  quotaTests();
 
   delete bufMgr;
 
@@ -212,6 +255,18 @@ void additionTest3() {
   deleteRelation();
 }
 
+void additionTest4() {
+  // String keys that differ only after the first eight characters
+  std::cout << "--------------------" << std::endl;
+  std::cout << "createRelationSharedPrefix" << std::endl;
+  createRelationSharedPrefix();
+  stringTestsSharedPrefix();
+  try {
+    File::remove(stringIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  deleteRelation();
+}
 
 // -----------------------------------------------------------------------------
 // createRelationForward
@@ -372,7 +427,7 @@ void createRelationSparse() {
   // set sparse records in sparse.
   std::vector<int> intvec(relationSize);
   for (int i = 0; i < relationSize; i++) {
-    intvec[i] = i + 10;
+    intvec[i] = i * 10;
   }
 
   // Insert a bunch of tuples into the relation.
@@ -397,6 +452,45 @@ void createRelationSparse() {
   file1->writePage(new_page_number, new_page);
 }
 
+// -----------------------------------------------------------------------------
+// createRelationSharedPrefix
+// -----------------------------------------------------------------------------
+
+void createRelationSharedPrefix() {
+  // destroy any old copies of relation file
+  try {
+    File::remove(relationName);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Every key starts with the same eight characters
+  for (int i = 0; i < relationSize; i++) {
+    sprintf(record1.s, "shared prefix %05d", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char *>(&record1), sizeof(record1));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (const InsufficientSpaceException &e) {
+        file1->writePage(new_page_number, new_page);
+        new_page = file1->allocatePage(new_page_number);
+      }
+    }
+  }
+
+  file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
 // indexTests
 // -----------------------------------------------------------------------------
@@ -407,6 +501,46 @@ void indexTests() {
     File::remove(intIndexName);
   } catch (const FileNotFoundException &e) {
   }
+  intTestsDeltaBuffer();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  intTestsMessageBuffers();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  intTestsLearnedLayer();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  intTestsCompressedLeaves();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  intTestsSwizzled();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  doubleTests();
+  try {
+    File::remove(doubleIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  stringTests();
+  try {
+    File::remove(stringIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
+  intTestsHash();
+  try {
+    File::remove(intHashIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -419,6 +553,11 @@ void indexTestsSparse() {
     File::remove(intIndexName);
   } catch (const FileNotFoundException &e) {
   }
+  intTestsLeafFilter();
+  try {
+    File::remove(intIndexName);
+  } catch (const FileNotFoundException &e) {
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -459,6 +598,165 @@ void intTests() {
   checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
   checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
   checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+
+  // run the same ranges as one multi-range scan, and an IN-list
+  int bounds[] = {25, 40, 300, 400, 3000, 4000};
+  std::vector<ScanRange> ranges = {{&bounds[0], GT, &bounds[1], LT},
+                                   {&bounds[2], GT, &bounds[3], LT},
+                                   {&bounds[4], GTE, &bounds[5], LT}};
+  checkPassFail(multiScan(&index, ranges), 1113);
+  checkPassFail(intInListScan(&index, -50, 5995, 5), 1000);
+
+  // and through the iterator interface
+  checkPassFail(intRangeScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(intRangeScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(intRangeScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(intRangeScan(&index, 3000, GTE, 4000, LT), 1000);
+  int numResults = 0;
+  for (RecordId rid : index.range(ranges)) {
+    (void)rid;
+    numResults++;
+  }
+  checkPassFail(numResults, 1113);
+
+  // Leaving the loop early ends the scan
+  int low = 100;
+  int high = 199;
+  numResults = 0;
+  for (RecordId rid : index.range(&low, &high)) {
+    (void)rid;
+    if (++numResults == 10) {
+      break;
+    }
+  }
+  bool scanEnded = false;
+  try {
+    index.endScan();
+  } catch (const ScanNotInitializedException &e) {
+    scanEnded = true;
+  }
+  checkPassFail(scanEnded, true);
+  checkPassFail(intScan(&index, 100, GTE, 199, LTE), 100);
+
+  // Another scan takes over the cursor. The first one notices instead of
+  // returning the other's entries, and leaves it running when destroyed.
+  bool scanLost = false;
+  {
+    IndexScan first = index.range(&low, &high);
+    IndexScan::iterator it = first.begin();
+    ++it;
+    int otherLow = 300;
+    int otherHigh = 309;
+    index.startScan(&otherLow, GTE, &otherHigh, LTE);
+    try {
+      ++it;
+    } catch (const ScanNotInitializedException &e) {
+      scanLost = true;
+    }
+  }
+  checkPassFail(scanLost, true);
+  checkPassFail(scanResults(&index), 10);
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests() {
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple, d),
+                   DOUBLE);
+
+  // run some tests
+  checkPassFail(doubleScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(doubleScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(doubleScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(doubleScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(doubleScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(doubleScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(doubleScan(&index, 3000, GTE, 4000, LT), 1000);
+  checkPassFail(doubleScan(&index, -0.0, GTE, 0.0, LTE), 1);
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests() {
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple, s),
+                   STRING);
+
+  // run some tests
+  checkPassFail(stringScan(&index, 10, GT, 20, LT), 9);
+  checkPassFail(stringScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(stringScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(stringScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(stringScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(stringScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(stringScan(&index, 3000, GTE, 4000, LT), 1000);
+}
+
+// -----------------------------------------------------------------------------
+// stringTestsSharedPrefix
+// -----------------------------------------------------------------------------
+
+void stringTestsSharedPrefix() {
+  std::cout << "Create a B+ Tree index on string keys sharing a prefix"
+            << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple, s),
+                   STRING);
+
+  checkPassFail(sharedPrefixScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(sharedPrefixScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(sharedPrefixScan(&index, 100, GT, 200, LTE), 100);
+  checkPassFail(sharedPrefixScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(sharedPrefixScan(&index, 42, GTE, 42, LTE), 1);
+  checkPassFail(sharedPrefixScan(&index, 3000, GTE, 4000, LT), 1000);
+
+  // Ranges meeting at a bound, and a bound shorter than the prefix
+  char bounds[4][64];
+  sprintf(bounds[0], "shared prefix %05d", 50);
+  sprintf(bounds[1], "shared prefix %05d", 60);
+  sprintf(bounds[2], "shared prefix %05d", 70);
+  sprintf(bounds[3], "shared");
+  std::vector<ScanRange> ranges = {{bounds[0], GTE, bounds[1], LT},
+                                   {bounds[1], GTE, bounds[2], LTE}};
+  checkPassFail(multiScan(&index, ranges), 21);
+  ranges = {{bounds[3], GT, bounds[0], LT}};
+  checkPassFail(multiScan(&index, ranges), 50);
+
+  int numResults = 0;
+  for (RecordId rid : index.range(bounds[0], GT, bounds[1], LTE)) {
+    (void)rid;
+    numResults++;
+  }
+  checkPassFail(numResults, 10);
+
+  // The rest of each key moves with its entry when others are deleted
+  std::vector<RecordId> deleted;
+  for (RecordId rid : index.range(bounds[0], GTE, bounds[1], LT)) {
+    deleted.push_back(rid);
+  }
+  for (std::size_t i = 0; i < deleted.size(); i++) {
+    index.deleteEntry(bounds[0], deleted[i]);
+  }
+  checkPassFail(sharedPrefixScan(&index, 45, GTE, 65, LT), 10);
+  checkPassFail(sharedPrefixScan(&index, 49, GT, 61, LTE), 2);
+
+  // Only the leaves keep the rest of a key, so options that keep entries
+  // elsewhere are refused
+  BTreeOptions options;
+  options.compressLeaves = true;
+  std::string compressedIndexName;
+  int rejected = 0;
+  try {
+    BTreeIndex compressed(relationName, compressedIndexName, bufMgr,
+                          offsetof(tuple, s), STRING, options);
+  } catch (const BadIndexInfoException &e) {
+    rejected = 1;
+  }
+  checkPassFail(rejected, 1);
 }
 
 // -----------------------------------------------------------------------------
@@ -495,6 +793,444 @@ void intTestsSparse() {
   checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 100);
 }
 
+// -----------------------------------------------------------------------------
+// intTestsLeafFilter
+// -----------------------------------------------------------------------------
+
+void intTestsLeafFilter() {
+  BTreeOptions options;
+  options.useLeafFilters = true;
+  {
+    std::cout << "Create a B+ Tree index with leaf filters on the integer field"
+              << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, options);
+
+    // Equality probes where only every tenth key is present
+    int found = 0;
+    for (int key = -100; key <= 1000; key++) {
+      found += intProbe(&index, key);
+    }
+    checkPassFail(found, 101);
+    checkPassFail(intInListScan(&index, -100, 1000, 1), 101);
+
+    // Range scans are unaffected by the filters
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 1);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 100);
+
+    // Spread copies of one key over several leaves, delete all but the first
+    // few, then split the leaf right of them. The rebuilt filters do not hold
+    // the key, which is still in a leaf further left.
+    int key = 500;
+    RecordId copyRid;
+    copyRid.page_number = 10000;
+    for (int i = 0; i < 600; i++) {
+      copyRid.slot_number = i;
+      index.insertEntry(&key, copyRid);
+    }
+    for (int i = 5; i < 600; i++) {
+      copyRid.slot_number = i;
+      index.deleteEntry(&key, copyRid);
+    }
+    int other = 505;
+    for (int i = 0; i < 600; i++) {
+      copyRid.slot_number = i;
+      index.insertEntry(&other, copyRid);
+    }
+    checkPassFail(intProbe(&index, key), 6);
+    checkPassFail(intProbe(&index, other), 600);
+    checkPassFail(intProbe(&index, 502), 0);
+  }
+
+  // The filters are rebuilt when the index is reopened, so a probe for an
+  // absent key stops above the leaves even before any scan has read them
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER, options);
+  BufStats before = bufMgr->getBufStats();
+  checkPassFail(intProbe(&index, 20005), 0);
+  BufStats absent = bufMgr->getBufStats();
+  absent -= before;
+  checkPassFail(intProbe(&index, 25000), 1);
+  BufStats present = bufMgr->getBufStats();
+  present -= before;
+  present -= absent;
+  bool fewerAccesses = absent.accesses < present.accesses;
+  checkPassFail(fewerAccesses, true);
+  checkPassFail(intProbe(&index, 500), 6);
+  checkPassFail(intProbe(&index, 505), 600);
+}
+
+int intProbe(BTreeIndex *index, int key) {
+  try {
+    index->startScan(&key, GTE, &key, LTE);
+  } catch (const NoSuchKeyFoundException &e) {
+    return 0;
+  }
+
+  RecordId scanRid;
+  int numResults = 0;
+  try {
+    while (1) {
+      index->scanNext(scanRid);
+      numResults++;
+    }
+  } catch (const IndexScanCompletedException &e) {
+  }
+  index->endScan();
+  return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// intTestsDeltaBuffer
+// -----------------------------------------------------------------------------
+
+void intTestsDeltaBuffer() {
+  std::cout << "Create a B+ Tree index with a delta buffer on the integer field"
+            << std::endl;
+  {
+    BTreeOptions options;
+    options.deltaBufferCapacity = 1000;
+    options.logDeltaBuffer = true;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, options);
+
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+
+    // Index the records with keys 100..199 a second time. The buffer is not
+    // full, so the new entries stay in memory and scans merge them in.
+    FileScan scanner(relationName, bufMgr);
+    try {
+      RecordId rid;
+      while (1) {
+        scanner.scanNext(rid);
+        std::string recordStr = scanner.getRecord();
+        const char *record = recordStr.c_str();
+        int key = *((int *)(record + offsetof(tuple, i)));
+        if (key >= 100 && key < 200) {
+          index.insertEntry(record + offsetof(tuple, i), rid);
+        }
+      }
+    } catch (const EndOfFileException &e) {
+    }
+
+    checkPassFail(intScan(&index, 99, GT, 200, LT), 200);
+    checkPassFail(intScan(&index, 150, GTE, 150, LTE), 2);
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+    checkPassFail(intInListScan(&index, 0, 4995, 5), 1020);
+  }
+
+  // The destructor drained the buffer into the tree
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+  checkPassFail(intScan(&index, 99, GT, 200, LT), 200);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+}
+
+// -----------------------------------------------------------------------------
+// intTestsMessageBuffers
+// -----------------------------------------------------------------------------
+
+void intTestsMessageBuffers() {
+  std::cout << "Create a B+ Tree index with message buffers on the integer field"
+            << std::endl;
+  {
+    BTreeOptions options;
+    options.useMessageBuffers = true;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, options);
+
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+    checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
+    checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
+    checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
+    checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
+    checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+
+    // Delete the even keys in 100..199 and index the odd ones a second time.
+    // Some of these changes are still queued in the non-leaf nodes.
+    FileScan scanner(relationName, bufMgr);
+    try {
+      RecordId rid;
+      while (1) {
+        scanner.scanNext(rid);
+        std::string recordStr = scanner.getRecord();
+        const char *record = recordStr.c_str();
+        int key = *((int *)(record + offsetof(tuple, i)));
+        if (key >= 100 && key < 200) {
+          if (key % 2 == 0) {
+            index.deleteEntry(record + offsetof(tuple, i), rid);
+          } else {
+            index.insertEntry(record + offsetof(tuple, i), rid);
+          }
+        }
+      }
+    } catch (const EndOfFileException &e) {
+    }
+
+    checkPassFail(intScan(&index, 99, GT, 200, LT), 100);
+    checkPassFail(intScan(&index, 150, GTE, 150, LTE), 0);
+    checkPassFail(intScan(&index, 151, GTE, 151, LTE), 2);
+    checkPassFail(intInListScan(&index, 0, 4995, 5), 1000);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  }
+
+  // The index keeps its node format, and its queued messages, when reopened
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 99, GT, 200, LT), 100);
+    checkPassFail(intScan(&index, -1000, GT, 6000, LT), 5000);
+  }
+  File::remove(intIndexName);
+
+  // Compressed leaves split before they take a flushed insert, which then has
+  // to be applied again after the node above has split
+  BTreeOptions options;
+  options.useMessageBuffers = true;
+  options.compressLeaves = true;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER, options);
+  checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  checkPassFail(intInListScan(&index, 0, 4995, 5), 1000);
+  checkPassFail(intScan(&index, -1000, GT, 6000, LT), 5000);
+}
+
+// -----------------------------------------------------------------------------
+// intTestsLearnedLayer
+// -----------------------------------------------------------------------------
+
+void intTestsLearnedLayer() {
+  std::cout << "Create a B+ Tree index with a learned layer on the integer field"
+            << std::endl;
+  BTreeOptions options;
+  options.useLearnedLayer = true;
+  options.learnedLayerMaxError = 4;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER, options);
+
+  // Dense keys are linear within a leaf
+  LearnedLayerStats stats = index.learnedLayerStats();
+  checkPassFail((stats.segments > 0), true);
+  checkPassFail(stats.validSegments, stats.segments);
+  checkPassFail((stats.maxError <= stats.errorBound), true);
+
+  checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  checkPassFail(intInListScan(&index, -50, 5995, 5), 1000);
+  stats = index.learnedLayerStats();
+  checkPassFail((stats.predictions > 0), true);
+
+  // Inserts invalidate the segments of the leaves they change, and scans
+  // around them go through the tree until the layer is retrained
+  RecordId extraRid;
+  extraRid.page_number = 1;
+  extraRid.slot_number = 1;
+  for (int key = 2000; key < 2100; key++) {
+    index.insertEntry(&key, extraRid);
+  }
+  stats = index.learnedLayerStats();
+  checkPassFail((stats.validSegments < stats.segments), true);
+  checkPassFail(intScan(&index, 1999, GTE, 2100, LTE), 202);
+  checkPassFail(intInListScan(&index, 1900, 2195, 5), 80);
+  checkPassFail((index.learnedLayerStats().fallbacks > 0), true);
+
+  index.trainLearnedLayer();
+  stats = index.learnedLayerStats();
+  checkPassFail(stats.validSegments, stats.segments);
+  checkPassFail(intScan(&index, 1999, GTE, 2100, LTE), 202);
+  checkPassFail(intScan(&index, -1000, GT, 6000, LT), 5100);
+}
+
+// -----------------------------------------------------------------------------
+// intTestsCompressedLeaves
+// -----------------------------------------------------------------------------
+
+void intTestsCompressedLeaves() {
+  long plainSize;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  plainSize = indexFileSize(intIndexName);
+  File::remove(intIndexName);
+
+  std::cout << "Create a B+ Tree index with compressed leaves on the integer "
+               "field"
+            << std::endl;
+  {
+    BTreeOptions options;
+    options.compressLeaves = true;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, options);
+
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+    checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
+    checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
+    checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
+    checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
+    checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
+    checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+    checkPassFail(intInListScan(&index, -50, 5995, 5), 1000);
+
+    // A key far from the rest widens the key field of its leaf, which then
+    // has to split
+    RecordId farRid;
+    farRid.page_number = 1;
+    farRid.slot_number = 1;
+    for (int key = 2000; key < 2100; key++) {
+      index.insertEntry(&key, farRid);
+    }
+    int farKey = 1000000000;
+    index.insertEntry(&farKey, farRid);
+    for (int key = 2000; key < 2100; key += 2) {
+      index.deleteEntry(&key, farRid);
+    }
+    checkPassFail(intScan(&index, 1999, GTE, 2100, LTE), 152);
+    checkPassFail(intScan(&index, -1000, GT, farKey, LTE), 5051);
+  }
+  checkPassFail((indexFileSize(intIndexName) * 2 < plainSize), true);
+
+  std::cout << "Read from the existing index with compressed leaves"
+            << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+  checkPassFail(intScan(&index, 1999, GTE, 2100, LTE), 152);
+  checkPassFail(intScan(&index, -1000, GT, 6000, LT), 5050);
+}
+
+// -----------------------------------------------------------------------------
+// intTestsSwizzled
+// -----------------------------------------------------------------------------
+
+void intTestsSwizzled() {
+  std::cout << "Create a B+ Tree index with swizzled child references on the "
+               "integer field"
+            << std::endl;
+  BTreeOptions options;
+  options.swizzleChildren = true;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER, options);
+
+  checkPassFail(intScan(&index, 25, GT, 40, LT), 14);
+  checkPassFail(intScan(&index, 20, GTE, 35, LTE), 16);
+  checkPassFail(intScan(&index, -3, GT, 3, LT), 3);
+  checkPassFail(intScan(&index, 996, GT, 1001, LT), 4);
+  checkPassFail(intScan(&index, 0, GT, 1, LT), 0);
+  checkPassFail(intScan(&index, 300, GT, 400, LT), 99);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 1000);
+  checkPassFail(intInListScan(&index, -50, 5995, 5), 1000);
+
+  // Once the path to a key has been followed, following it again takes no
+  // page table lookups
+  int key = 3000;
+  checkPassFail(intScan(&index, key, GTE, key, LTE), 1);
+  BufStats probe = bufMgr->getBufStats();
+  RecordId rid;
+  index.startScan(&key, GTE, &key, LTE);
+  index.scanNext(rid);
+  index.endScan();
+  BufStats after = bufMgr->getBufStats();
+  after -= probe;
+  checkPassFail(after.hashlookups, 0);
+  checkPassFail((after.swiphits > 0), true);
+
+  // Every insert writes the index out, unswizzling the references to its
+  // pages, and splits move children to other slots and nodes
+  RecordId extraRid;
+  extraRid.page_number = 1;
+  extraRid.slot_number = 1;
+  for (int extraKey = 2000; extraKey < 4000; extraKey++) {
+    index.insertEntry(&extraKey, extraRid);
+  }
+  checkPassFail(intScan(&index, 1999, GTE, 2100, LTE), 203);
+  checkPassFail(intScan(&index, 3000, GTE, 4000, LT), 2000);
+  checkPassFail(intInListScan(&index, -50, 5995, 5), 1400);
+  checkPassFail(intScan(&index, -1000, GT, 6000, LT), 7000);
+}
+
+long indexFileSize(const std::string &indexName) {
+  std::ifstream in(indexName.c_str(), std::ios::in | std::ios::binary);
+  in.seekg(0, std::ios::end);
+  return static_cast<long>(in.tellg());
+}
+
+// -----------------------------------------------------------------------------
+// intTestsHash
+// -----------------------------------------------------------------------------
+
+void intTestsHash() {
+  std::cout << "Create a hash index on the integer field" << std::endl;
+  {
+    HashIndex index(relationName, intHashIndexName, bufMgr, offsetof(tuple, i),
+                    INTEGER);
+
+    int found = 0;
+    for (int key = -100; key < relationSize + 100; key++) {
+      found += hashProbe(&index, key);
+    }
+    checkPassFail(found, relationSize);
+
+    // Index one key often enough to overflow its bucket
+    RecordId dupRid;
+    dupRid.page_number = 1;
+    dupRid.slot_number = 1;
+    int dupKey = 42;
+    for (int n = 0; n < 1200; n++) {
+      index.insertEntry(&dupKey, dupRid);
+    }
+    checkPassFail(hashProbe(&index, 42), 1201);
+    checkPassFail(hashProbe(&index, 43), 1);
+  }
+
+  std::cout << "Read from the existing hash index" << std::endl;
+  HashIndex index(relationName, intHashIndexName, bufMgr, offsetof(tuple, i),
+                  INTEGER);
+  checkPassFail(hashProbe(&index, 42), 1201);
+  checkPassFail(hashProbe(&index, relationSize - 1), 1);
+  checkPassFail(hashProbe(&index, relationSize), 0);
+
+  // Only the prefix of a string key would be kept, so a string attribute is
+  // refused
+  std::string stringHashIndexName;
+  int rejected = 0;
+  try {
+    HashIndex stringIndex(relationName, stringHashIndexName, bufMgr,
+                          offsetof(tuple, s), STRING);
+  } catch (const BadIndexInfoException &e) {
+    rejected = 1;
+  }
+  checkPassFail(rejected, 1);
+  checkPassFail(File::exists(stringHashIndexName), false);
+}
+
+int hashProbe(HashIndex *index, int key) {
+  try {
+    index->startScan(&key);
+  } catch (const NoSuchKeyFoundException &e) {
+    return 0;
+  }
+
+  RecordId scanRid;
+  int numResults = 0;
+  try {
+    while (1) {
+      index->scanNext(scanRid);
+      numResults++;
+    }
+  } catch (const IndexScanCompletedException &e) {
+  }
+  index->endScan();
+  return numResults;
+}
+
 void initReopenExistingIndex() {
   std::cout << "Create a B+ Tree index on the integer field" << std::endl;
   BTreeIndex preIndex(relationName, intIndexName, bufMgr, offsetof(tuple, i),
@@ -516,9 +1252,6 @@ void initReopenExistingIndex() {
 
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
             Operator highOp) {
-  RecordId scanRid;
-  Page *curPage;
-
   std::cout << "Scan for ";
   if (lowOp == GT) {
     std::cout << "(";
@@ -533,7 +1266,31 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
   }
   std::cout << std::endl;
 
-  int numResults = 0;
+  try {
+    index->startScan(&lowVal, lowOp, &highVal, highOp);
+  } catch (const NoSuchKeyFoundException &e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  return scanResults(index);
+}
+
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp) {
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowVal << "," << highVal;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
 
   try {
     index->startScan(&lowVal, lowOp, &highVal, highOp);
@@ -542,13 +1299,75 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
     return 0;
   }
 
+  return scanResults(index);
+}
+
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+               Operator highOp) {
+  char lowValStr[100];
+  sprintf(lowValStr, "%05d string record", lowVal);
+  char highValStr[100];
+  sprintf(highValStr, "%05d string record", highVal);
+
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowValStr << "," << highValStr;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
+
+  try {
+    index->startScan(lowValStr, lowOp, highValStr, highOp);
+  } catch (const NoSuchKeyFoundException &e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  return scanResults(index);
+}
+
+int sharedPrefixScan(BTreeIndex *index, int lowVal, Operator lowOp,
+                     int highVal, Operator highOp) {
+  char lowValStr[100];
+  sprintf(lowValStr, "shared prefix %05d", lowVal);
+  char highValStr[100];
+  sprintf(highValStr, "shared prefix %05d", highVal);
+
+  std::cout << "Scan for " << (lowOp == GT ? "(" : "[") << lowValStr << ","
+            << highValStr << (highOp == LT ? ")" : "]") << std::endl;
+
+  try {
+    index->startScan(lowValStr, lowOp, highValStr, highOp);
+  } catch (const NoSuchKeyFoundException &e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  return scanResults(index);
+}
+
+// Drain a started scan, printing the first few records it returns, then end
+// the scan.
+int scanResults(BTreeIndex *index) {
+  RecordId scanRid;
+  int numResults = 0;
+
   while (1) {
     try {
       index->scanNext(scanRid);
-      bufMgr->readPage(file1, scanRid.page_number, curPage);
-      RECORD myRec = *(
-          reinterpret_cast<const RECORD *>(curPage->getRecord(scanRid).data()));
-      bufMgr->unPinPage(file1, scanRid.page_number, false);
+      RECORD myRec;
+      {
+        PageGuard curPage = bufMgr->fetchPage(file1, scanRid.page_number);
+        myRec = *(reinterpret_cast<const RECORD *>(
+            curPage->getRecord(scanRid).data()));
+      }
 
       if (numResults < 5) {
         std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
@@ -573,6 +1392,63 @@ int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
   return numResults;
 }
 
+// Count the entries of a range through the iterator interface, checking that
+// each record's key lies in the range.
+int intRangeScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal,
+                 Operator highOp) {
+  std::cout << "Iterate over " << (lowOp == GT ? "(" : "[") << lowVal << ","
+            << highVal << (highOp == LT ? ")" : "]") << std::endl;
+
+  int numResults = 0;
+  for (RecordId rid : index->range(&lowVal, lowOp, &highVal, highOp)) {
+    RECORD myRec;
+    {
+      PageGuard curPage = bufMgr->fetchPage(file1, rid.page_number);
+      myRec =
+          *(reinterpret_cast<const RECORD *>(curPage->getRecord(rid).data()));
+    }
+
+    bool inRange = (lowOp == GT ? myRec.i > lowVal : myRec.i >= lowVal) &&
+                   (highOp == LT ? myRec.i < highVal : myRec.i <= highVal);
+    if (!inRange) {
+      std::cout << "Record " << myRec.i << " is out of range" << std::endl;
+      return -1;
+    }
+    numResults++;
+  }
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+  return numResults;
+}
+
+int multiScan(BTreeIndex *index, const std::vector<ScanRange> &ranges) {
+  std::cout << "Scan for " << ranges.size() << " ranges" << std::endl;
+
+  try {
+    index->startScan(ranges);
+  } catch (const NoSuchKeyFoundException &e) {
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+    return 0;
+  }
+
+  return scanResults(index);
+}
+
+int intInListScan(BTreeIndex *index, int first, int last, int step) {
+  std::vector<int> keys;
+  for (int key = first; key <= last; key += step) {
+    keys.push_back(key);
+  }
+
+  std::vector<ScanRange> ranges(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ranges[i].lowVal = &keys[i];
+    ranges[i].lowOp = GTE;
+    ranges[i].highVal = &keys[i];
+    ranges[i].highOp = LTE;
+  }
+  return multiScan(index, ranges);
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -663,6 +1539,16 @@ void errorTests() {
       std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
     }
 
+    std::cout << "Multi-range scan with overlapping ranges" << std::endl;
+    try {
+      std::vector<ScanRange> ranges = {{&int2, GTE, &int5, LTE},
+                                       {&int2, GT, &int5, LT}};
+      index.startScan(ranges);
+      std::cout << "BadScanrangeException Test 2 Failed." << std::endl;
+    } catch (const BadScanrangeException &e) {
+      std::cout << "BadScanrangeException Test 2 Passed." << std::endl;
+    }
+
     deleteRelation();
   }
 
@@ -672,6 +1558,245 @@ void errorTests() {
   }
 }
 
+// -----------------------------------------------------------------------------
+// fillBufferFile
+// -----------------------------------------------------------------------------
+
+// Allocate pages in a file through a buffer pool, each holding one record
+// that names it, and write them out.
+void fillBufferFile(BufMgr *pool, File *file, const int numPages,
+                    std::vector<PageId> &pageNos, std::vector<RecordId> &rids,
+                    std::vector<std::string> &contents) {
+  for (int i = 0; i < numPages; i++) {
+    PageId pageNo;
+    WritePageGuard page = pool->newPage(file, pageNo);
+    char data[32];
+    sprintf(data, "buffer page %d", i);
+    rids.push_back(page->insertRecord(data));
+    pageNos.push_back(pageNo);
+    contents.push_back(data);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// readPagesTests
+// -----------------------------------------------------------------------------
+
+void readPagesTests() {
+  std::cout << "readPages tests" << std::endl;
+  std::cout << "---------------" << std::endl;
+  const std::string bufFileName = relationName + ".buf";
+  try {
+    File::remove(bufFileName);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    PageFile bufFile(bufFileName, true);
+    BufMgr pool(20);
+    pool.setMaxReadAhead(0);
+    std::vector<PageId> pageNos;
+    std::vector<RecordId> rids;
+    std::vector<std::string> contents;
+    fillBufferFile(&pool, &bufFile, 20, pageNos, rids, contents);
+    pool.flushFile(&bufFile);
+
+    // A page requested twice is pinned twice, whether it was in the pool or
+    // not
+    {
+      PageGuard hit = pool.fetchPage(&bufFile, pageNos[5]);
+    }
+    PageId dupNos[5] = {pageNos[3], pageNos[5], pageNos[3], pageNos[5],
+                        pageNos[4]};
+    Page *pages[6];
+    pool.readPages(&bufFile, dupNos, 5, pages);
+    bool sameFrame = pages[0] == pages[2] && pages[1] == pages[3];
+    checkPassFail(sameFrame, true);
+    bool sameRecord = pages[1]->getRecord(rids[5]) == contents[5];
+    checkPassFail(sameRecord, true);
+    bool pinnedTwice = true;
+    try {
+      for (int i = 0; i < 5; i++) {
+        pool.unPinPage(&bufFile, dupNos[i], false);
+      }
+    } catch (const PageNotPinnedException &e) {
+      pinnedTwice = false;
+    }
+    checkPassFail(pinnedTwice, true);
+
+    // A run that ends at an unused page throws, and every page the call
+    // pinned, hits included, is unpinned again
+    pool.flushFile(&bufFile);
+    bufFile.deletePage(pageNos[19]);
+    {
+      PageGuard hit = pool.fetchPage(&bufFile, pageNos[2]);
+    }
+    PageId runNos[4] = {pageNos[2], pageNos[17], pageNos[18], pageNos[19]};
+    bool invalidPage = false;
+    try {
+      pool.readPages(&bufFile, runNos, 4, pages);
+    } catch (const InvalidPageException &e) {
+      invalidPage = true;
+    }
+    checkPassFail(invalidPage, true);
+    bool allUnpinned = true;
+    try {
+      pool.flushFile(&bufFile);
+    } catch (const PagePinnedException &e) {
+      allUnpinned = false;
+    }
+    checkPassFail(allUnpinned, true);
+
+    // So is every page when the pool cannot hold them all
+    BufMgr small(4);
+    bool exceeded = false;
+    try {
+      small.readPages(&bufFile, &pageNos[0], 6, pages);
+    } catch (const BufferExceededException &e) {
+      exceeded = true;
+    }
+    checkPassFail(exceeded, true);
+    small.readPages(&bufFile, &pageNos[0], 4, pages);
+    for (int i = 0; i < 4; i++) {
+      small.unPinPage(&bufFile, pageNos[i], false);
+    }
+    small.flushFile(&bufFile);
+  }
+  File::remove(bufFileName);
+}
+
+// -----------------------------------------------------------------------------
+// resizeTests
+// -----------------------------------------------------------------------------
+
+void resizeTests() {
+  std::cout << "resize tests" << std::endl;
+  std::cout << "------------" << std::endl;
+  const std::string bufFileName = relationName + ".buf";
+  try {
+    File::remove(bufFileName);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    PageFile bufFile(bufFileName, true);
+    BufMgr pool(20);
+    pool.setMaxReadAhead(0);
+    std::vector<PageId> pageNos;
+    std::vector<RecordId> rids;
+    std::vector<std::string> contents;
+    fillBufferFile(&pool, &bufFile, 20, pageNos, rids, contents);
+
+    // Shrinking the pool writes back the dirty pages in the frames it removes
+    pool.clearBufStats();
+    pool.resize(5);
+    checkPassFail(pool.getBufStats().dirtyevictions.load(), 15);
+    int readBack = 0;
+    for (int i = 0; i < 20; i++) {
+      PageGuard page = pool.fetchPage(&bufFile, pageNos[i]);
+      if (page->getRecord(rids[i]) == contents[i]) {
+        readBack++;
+      }
+    }
+    checkPassFail(readBack, 20);
+
+    // A pinned page in a frame to remove stops the resize before anything is
+    // evicted: every page stays in the pool, and dirty
+    pool.flushFile(&bufFile);
+    pool.resize(10);
+    std::vector<RecordId> dirtyRids(10);
+    {
+      std::vector<PageGuard> pinned;
+      for (int i = 0; i < 10; i++) {
+        pinned.push_back(pool.fetchPage(&bufFile, pageNos[i]));
+      }
+      for (int i = 2; i < 10; i++) {
+        dirtyRids[i] = pinned[i]->insertRecord(contents[i] + " changed");
+        pinned[i].markDirty();
+        pinned[i].release();
+      }
+      pool.clearBufStats();
+      bool resizeRefused = false;
+      try {
+        pool.resize(1);
+      } catch (const PagePinnedException &e) {
+        resizeRefused = true;
+      }
+      checkPassFail(resizeRefused, true);
+      checkPassFail(pool.getBufStats().diskwrites.load(), 0);
+    }
+    for (int i = 0; i < 10; i++) {
+      PageGuard page = pool.fetchPage(&bufFile, pageNos[i]);
+    }
+    checkPassFail(pool.getBufStats().diskreads.load(), 0);
+    pool.flushFile(&bufFile);
+    int changed = 0;
+    for (int i = 2; i < 10; i++) {
+      Page page = bufFile.readPage(pageNos[i]);
+      if (page.getRecord(dirtyRids[i]) == contents[i] + " changed") {
+        changed++;
+      }
+    }
+    checkPassFail(changed, 8);
+  }
+  File::remove(bufFileName);
+}
+
+// -----------------------------------------------------------------------------
+// quotaTests
+// -----------------------------------------------------------------------------
+
+void quotaTests() {
+  std::cout << "quota tests" << std::endl;
+  std::cout << "-----------" << std::endl;
+  const std::string bufFileName = relationName + ".buf";
+  try {
+    File::remove(bufFileName);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  // A file keeps its reserved frames while a scan larger than the pool goes
+  // through it; the scan's ring has fewer frames than it asks for
+  createRelationForward();
+  {
+    PageFile bufFile(bufFileName, true);
+    BufMgr pool(12);
+    pool.setMaxReadAhead(0);
+    pool.setFileQuota(bufFileName, FileQuota(5));
+    std::vector<PageId> pageNos;
+    std::vector<RecordId> rids;
+    std::vector<std::string> contents;
+    fillBufferFile(&pool, &bufFile, 5, pageNos, rids, contents);
+    pool.flushFile(&bufFile);
+    for (int i = 0; i < 5; i++) {
+      pool.fetchPage(&bufFile, pageNos[i]);
+    }
+
+    {
+      FileScan scanner(relationName, &pool);
+      int scanned = 0;
+      try {
+        RecordId scanRid;
+        while (1) {
+          scanner.scanNext(scanRid);
+          scanned++;
+        }
+      } catch (const EndOfFileException &e) {
+      }
+      checkPassFail(scanned, relationSize);
+    }
+
+    pool.clearBufStats();
+    for (int i = 0; i < 5; i++) {
+      pool.fetchPage(&bufFile, pageNos[i]);
+    }
+    checkPassFail(pool.getBufStats().diskreads.load(), 0);
+    pool.flushFile(&bufFile);
+  }
+  deleteRelation();
+  File::remove(bufFileName);
+}
+
 void deleteRelation() {
   if (file1) {
     bufMgr->flushFile(file1);
@@ -0,0 +1,468 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacement.h"
+
+#include <algorithm>
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(Replacement kind,
+                                             std::uint32_t numFrames,
+                                             BufDesc* descs) {
+  switch (kind) {
+    case LRU2:
+      return new Lru2Policy(numFrames);
+    case TWOQ:
+      return new TwoQPolicy(numFrames);
+    case ARC:
+      return new ArcPolicy(numFrames);
+    case CLOCK:
+    default:
+      return new ClockPolicy(numFrames, descs);
+  }
+}
+
+//----------------------------------------
+// CLOCK
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(std::uint32_t numFrames, BufDesc* descs)
+    : clockHand(numFrames - 1), numFrames(numFrames), descs(descs) {}
+
+void ClockPolicy::loaded(FrameId frameNo, const File* file, PageId pageNo,
+                         bool cold) {
+  descs[frameNo].refbit = !cold;
+}
+
+void ClockPolicy::accessed(FrameId frameNo) {
+  descs[frameNo].refbit = true;
+}
+
+void ClockPolicy::freed(FrameId frameNo) {}
+
+void ClockPolicy::taken(FrameId frameNo) {}
+
+bool ClockPolicy::pickVictim(const TakeFrame& take, FrameId& frameNo) {
+  // Need to scan twice: the first pass may only clear reference bits
+  for (std::uint32_t numScanned = 0; numScanned < 2 * numFrames;
+       numScanned++) {
+    FrameId candidate = advanceClock();
+
+    // has been referenced, clear the bit
+    if (descs[candidate].valid && descs[candidate].refbit) {
+      descs[candidate].refbit = false;
+      continue;
+    }
+
+    if (take(candidate)) {
+      frameNo = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockPolicy::peekVictims(std::size_t count,
+                              std::vector<FrameId>& frames) {
+  // frames ahead of the hand whose reference bit is already clear
+  FrameId candidate = clockHand.load() % numFrames;
+  for (std::uint32_t i = 0; i < numFrames && frames.size() < count; i++) {
+    candidate = (candidate + 1) % numFrames;
+    if (descs[candidate].valid && !descs[candidate].refbit) {
+      frames.push_back(candidate);
+    }
+  }
+}
+
+void ClockPolicy::resize(std::uint32_t newFrames) {
+  clockHand = clockHand.load() % newFrames;
+  numFrames = newFrames;
+}
+
+//----------------------------------------
+// Frame lists
+//----------------------------------------
+
+ListPolicy::ListPolicy(std::uint32_t numFrames)
+    : numFrames(numFrames), frameKey(numFrames), resident(numFrames, false) {
+  // hand out the lowest frames first
+  for (FrameId i = numFrames; i > 0; i--) {
+    freeFrames.push_back(i - 1);
+  }
+}
+
+void ListPolicy::loaded(FrameId frameNo, const File* file, PageId pageNo,
+                        bool cold) {
+  std::lock_guard<std::mutex> guard(latch);
+  frameKey[frameNo] = pageKey(file, pageNo);
+  resident[frameNo] = true;
+  loadResident(frameNo, cold);
+}
+
+void ListPolicy::accessed(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  // the page may have been disposed of while pinned
+  if (resident[frameNo]) {
+    accessResident(frameNo);
+  }
+}
+
+void ListPolicy::freed(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (resident[frameNo]) {
+    removeResident(frameNo);
+    resident[frameNo] = false;
+  }
+  freeFrames.push_back(frameNo);
+}
+
+void ListPolicy::taken(FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (resident[frameNo]) {
+    removeResident(frameNo);
+    resident[frameNo] = false;
+  }
+}
+
+bool ListPolicy::pickVictim(const TakeFrame& take, FrameId& frameNo) {
+  std::lock_guard<std::mutex> guard(latch);
+
+  // A free frame can only be refused while flushFile() looks at it
+  for (std::size_t i = freeFrames.size(); i > 0; i--) {
+    if (take(freeFrames[i - 1])) {
+      frameNo = freeFrames[i - 1];
+      freeFrames.erase(freeFrames.begin() + (i - 1));
+      return true;
+    }
+  }
+
+  if (!evictResident(take, frameNo)) {
+    return false;
+  }
+  resident[frameNo] = false;
+  return true;
+}
+
+void ListPolicy::peekVictims(std::size_t count,
+                             std::vector<FrameId>& frames) {
+  std::lock_guard<std::mutex> guard(latch);
+  peekResident(count, frames);
+}
+
+void ListPolicy::resize(std::uint32_t newFrames) {
+  std::lock_guard<std::mutex> guard(latch);
+
+  // removed frames are all free; added frames are handed out after those
+  // free already, lowest first
+  std::vector<FrameId> frames;
+  for (FrameId i = newFrames; i > numFrames; i--) {
+    frames.push_back(i - 1);
+  }
+  for (std::size_t i = 0; i < freeFrames.size(); i++) {
+    if (freeFrames[i] < newFrames) {
+      frames.push_back(freeFrames[i]);
+    }
+  }
+  freeFrames.swap(frames);
+
+  numFrames = newFrames;
+  frameKey.resize(numFrames);
+  resident.resize(numFrames, false);
+  resizeResident();
+}
+
+/**
+ * Append frames of a list to frames, from its back, up to count in all.
+ */
+static void peekFromBack(const std::list<FrameId>& list, std::size_t count,
+                         std::vector<FrameId>& frames) {
+  for (std::list<FrameId>::const_reverse_iterator it = list.rbegin();
+       it != list.rend() && frames.size() < count; ++it) {
+    frames.push_back(*it);
+  }
+}
+
+//----------------------------------------
+// LRU-2
+//----------------------------------------
+
+Lru2Policy::Lru2Policy(std::uint32_t numFrames)
+    : ListPolicy(numFrames), now(0), frameHistory(numFrames) {}
+
+void Lru2Policy::loadResident(FrameId frameNo, bool cold) {
+  // a cold page goes before any page with an access time
+  History history(0, cold ? 0 : ++now);
+  std::unordered_map<std::uint64_t, History>::iterator old =
+      evicted.find(frameKey[frameNo]);
+  if (old != evicted.end()) {
+    if (!cold) {
+      history.first = old->second.second;
+    }
+    evicted.erase(old);
+  }
+
+  frameHistory[frameNo] = history;
+  order.insert(std::make_pair(history, frameNo));
+}
+
+void Lru2Policy::accessResident(FrameId frameNo) {
+  History& history = frameHistory[frameNo];
+  order.erase(std::make_pair(history, frameNo));
+  history.first = history.second;
+  history.second = ++now;
+  order.insert(std::make_pair(history, frameNo));
+}
+
+void Lru2Policy::removeResident(FrameId frameNo) {
+  order.erase(std::make_pair(frameHistory[frameNo], frameNo));
+}
+
+bool Lru2Policy::evictResident(const TakeFrame& take, FrameId& frameNo) {
+  for (std::set<std::pair<History, FrameId> >::iterator it = order.begin();
+       it != order.end(); ++it) {
+    if (!take(it->second)) {
+      continue;
+    }
+    frameNo = it->second;
+    order.erase(it);
+
+    // remember the history, forgetting the oldest beyond one page per frame
+    std::uint64_t key = frameKey[frameNo];
+    evicted[key] = frameHistory[frameNo];
+    evictedOrder.push_back(std::make_pair(key, frameHistory[frameNo].second));
+    while (evictedOrder.size() > numFrames) {
+      std::unordered_map<std::uint64_t, History>::iterator old =
+          evicted.find(evictedOrder.front().first);
+      if (old != evicted.end() &&
+          old->second.second == evictedOrder.front().second) {
+        evicted.erase(old);
+      }
+      evictedOrder.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void Lru2Policy::peekResident(std::size_t count,
+                              std::vector<FrameId>& frames) {
+  for (std::set<std::pair<History, FrameId> >::iterator it = order.begin();
+       it != order.end() && frames.size() < count; ++it) {
+    frames.push_back(it->second);
+  }
+}
+
+void Lru2Policy::resizeResident() {
+  frameHistory.resize(numFrames);
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(std::uint32_t numFrames)
+    : ListPolicy(numFrames),
+      maxIn(std::max<std::size_t>(1, numFrames / 4)),
+      maxOut(std::max<std::size_t>(1, numFrames / 2)),
+      position(numFrames),
+      inAm(numFrames, false) {}
+
+void TwoQPolicy::loadResident(FrameId frameNo, bool cold) {
+  std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator>::iterator
+      ghost = a1outPosition.find(frameKey[frameNo]);
+  if (cold) {
+    // at the old end of A1in
+    a1in.push_back(frameNo);
+    position[frameNo] = --a1in.end();
+    inAm[frameNo] = false;
+  } else if (ghost != a1outPosition.end()) {
+    // accessed again since it left A1in: a hot page
+    a1out.erase(ghost->second);
+    a1outPosition.erase(ghost);
+    am.push_front(frameNo);
+    position[frameNo] = am.begin();
+    inAm[frameNo] = true;
+  } else {
+    a1in.push_front(frameNo);
+    position[frameNo] = a1in.begin();
+    inAm[frameNo] = false;
+  }
+}
+
+void TwoQPolicy::accessResident(FrameId frameNo) {
+  // accesses to pages in A1in are taken to be correlated with the first
+  if (inAm[frameNo]) {
+    am.splice(am.begin(), am, position[frameNo]);
+  }
+}
+
+void TwoQPolicy::removeResident(FrameId frameNo) {
+  (inAm[frameNo] ? am : a1in).erase(position[frameNo]);
+}
+
+bool TwoQPolicy::evictFrom(std::list<FrameId>& queue, const TakeFrame& take,
+                           FrameId& frameNo) {
+  for (std::list<FrameId>::reverse_iterator it = queue.rbegin();
+       it != queue.rend(); ++it) {
+    if (!take(*it)) {
+      continue;
+    }
+    frameNo = *it;
+    queue.erase(position[frameNo]);
+
+    if (!inAm[frameNo]) {
+      std::uint64_t key = frameKey[frameNo];
+      a1out.push_front(key);
+      a1outPosition[key] = a1out.begin();
+      while (a1out.size() > maxOut) {
+        a1outPosition.erase(a1out.back());
+        a1out.pop_back();
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+bool TwoQPolicy::evictResident(const TakeFrame& take, FrameId& frameNo) {
+  if (a1in.size() > maxIn) {
+    return evictFrom(a1in, take, frameNo) || evictFrom(am, take, frameNo);
+  }
+  return evictFrom(am, take, frameNo) || evictFrom(a1in, take, frameNo);
+}
+
+void TwoQPolicy::peekResident(std::size_t count,
+                              std::vector<FrameId>& frames) {
+  bool inFirst = a1in.size() > maxIn;
+  peekFromBack(inFirst ? a1in : am, count, frames);
+  peekFromBack(inFirst ? am : a1in, count, frames);
+}
+
+void TwoQPolicy::resizeResident() {
+  maxIn = std::max<std::size_t>(1, numFrames / 4);
+  maxOut = std::max<std::size_t>(1, numFrames / 2);
+  while (a1out.size() > maxOut) {
+    a1outPosition.erase(a1out.back());
+    a1out.pop_back();
+  }
+  position.resize(numFrames);
+  inAm.resize(numFrames, false);
+}
+
+//----------------------------------------
+// ARC
+//----------------------------------------
+
+ArcPolicy::ArcPolicy(std::uint32_t numFrames)
+    : ListPolicy(numFrames),
+      target(0),
+      position(numFrames),
+      inT2(numFrames, false) {}
+
+void ArcPolicy::loadResident(FrameId frameNo, bool cold) {
+  std::unordered_map<std::uint64_t,
+                     std::pair<std::list<std::uint64_t>::iterator, bool> >::
+      iterator ghost = ghostPosition.find(frameKey[frameNo]);
+  if (cold) {
+    // at the least recently used end of T1, leaving the target alone
+    t1.push_back(frameNo);
+    position[frameNo] = --t1.end();
+    inT2[frameNo] = false;
+    trimGhosts();
+  } else if (ghost != ghostPosition.end()) {
+    // a miss on a recently evicted page: favour the list it was evicted from
+    if (!ghost->second.second) {
+      std::size_t delta = std::max<std::size_t>(1, b2.size() / b1.size());
+      target = std::min<std::size_t>(numFrames, target + delta);
+      b1.erase(ghost->second.first);
+    } else {
+      std::size_t delta = std::max<std::size_t>(1, b1.size() / b2.size());
+      target -= std::min(target, delta);
+      b2.erase(ghost->second.first);
+    }
+    ghostPosition.erase(ghost);
+
+    t2.push_front(frameNo);
+    position[frameNo] = t2.begin();
+    inT2[frameNo] = true;
+  } else {
+    t1.push_front(frameNo);
+    position[frameNo] = t1.begin();
+    inT2[frameNo] = false;
+    trimGhosts();
+  }
+}
+
+void ArcPolicy::accessResident(FrameId frameNo) {
+  t2.splice(t2.begin(), inT2[frameNo] ? t2 : t1, position[frameNo]);
+  inT2[frameNo] = true;
+}
+
+void ArcPolicy::removeResident(FrameId frameNo) {
+  (inT2[frameNo] ? t2 : t1).erase(position[frameNo]);
+}
+
+bool ArcPolicy::evictFrom(std::list<FrameId>& list,
+                          std::list<std::uint64_t>& ghosts,
+                          const TakeFrame& take, FrameId& frameNo) {
+  for (std::list<FrameId>::reverse_iterator it = list.rbegin();
+       it != list.rend(); ++it) {
+    if (!take(*it)) {
+      continue;
+    }
+    frameNo = *it;
+    list.erase(position[frameNo]);
+
+    std::uint64_t key = frameKey[frameNo];
+    ghosts.push_front(key);
+    ghostPosition[key] = std::make_pair(ghosts.begin(), &ghosts == &b2);
+    trimGhosts();
+    return true;
+  }
+  return false;
+}
+
+void ArcPolicy::trimGhosts() {
+  while (t1.size() + b1.size() > numFrames && !b1.empty()) {
+    ghostPosition.erase(b1.back());
+    b1.pop_back();
+  }
+  while (t1.size() + t2.size() + b1.size() + b2.size() > 2 * numFrames &&
+         !b2.empty()) {
+    ghostPosition.erase(b2.back());
+    b2.pop_back();
+  }
+}
+
+bool ArcPolicy::evictResident(const TakeFrame& take, FrameId& frameNo) {
+  // The victim is chosen before the page to load is known, so the case of a
+  // miss on a page in B2 with T1 exactly at its target falls to T2
+  if (!t1.empty() && (t1.size() > target || t2.empty())) {
+    return evictFrom(t1, b1, take, frameNo) ||
+           evictFrom(t2, b2, take, frameNo);
+  }
+  return evictFrom(t2, b2, take, frameNo) || evictFrom(t1, b1, take, frameNo);
+}
+
+void ArcPolicy::peekResident(std::size_t count,
+                             std::vector<FrameId>& frames) {
+  bool fromT1 = !t1.empty() && (t1.size() > target || t2.empty());
+  peekFromBack(fromT1 ? t1 : t2, count, frames);
+  peekFromBack(fromT1 ? t2 : t1, count, frames);
+}
+
+void ArcPolicy::resizeResident() {
+  target = std::min<std::size_t>(target, numFrames);
+  position.resize(numFrames);
+  inT2.resize(numFrames, false);
+  trimGhosts();
+}
+
+}
@@ -0,0 +1,504 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufDesc;
+
+/**
+ * @brief Page replacement policies a BufMgr can be built with.
+ */
+enum Replacement {
+  /**
+   * Second chance over a circular sweep of the frames (the default).
+   */
+  CLOCK,
+
+  /**
+   * LRU-2: evict the page whose second most recent access is oldest.
+   */
+  LRU2,
+
+  /**
+   * 2Q: pages seen once wait in a FIFO queue and only pages accessed again
+   * after leaving it enter the main LRU queue.
+   */
+  TWOQ,
+
+  /**
+   * Adaptive Replacement Cache: balances a recency and a frequency list,
+   * adapting their sizes to misses on recently evicted pages.
+   */
+  ARC
+};
+
+/**
+ * @brief Decides which frame of the buffer pool to reuse. The buffer manager
+ * reports every page it loads into a frame, every access to a resident page
+ * and every frame it frees, and asks for a victim when it needs a frame.
+ *
+ * Implementations must be safe to call from several threads. Apart from
+ * pickVictim(), calls come in while the caller has the frame taken over, or
+ * holds a pin on it, but no other buffer manager latch.
+ */
+class ReplacementPolicy {
+ public:
+  /**
+   * Function with which the buffer manager takes over a proposed victim. It
+   * returns true if the frame is now free and owned by the caller, and false
+   * if it is pinned or in use by another thread.
+   */
+  typedef std::function<bool(FrameId)> TakeFrame;
+
+  /**
+   * Destructor of ReplacementPolicy class.
+   */
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * A page was loaded into a frame.
+   *
+   * @param frameNo   Frame the page is in
+   * @param file      File of the page
+   * @param pageNo    Page number in the file
+   * @param cold      True if a bulk reader loaded the page, and it should be
+   *                  among the first victims
+   */
+  virtual void loaded(FrameId frameNo, const File* file, PageId pageNo,
+                      bool cold) = 0;
+
+  /**
+   * The page in a frame was accessed again.
+   *
+   * @param frameNo   Frame of the page
+   */
+  virtual void accessed(FrameId frameNo) = 0;
+
+  /**
+   * The page in a frame was dropped (its file was flushed or it was
+   * disposed), or a frame returned by pickVictim() was not used.
+   *
+   * @param frameNo   Frame that is now free
+   */
+  virtual void freed(FrameId frameNo) = 0;
+
+  /**
+   * The buffer manager took over a frame without asking for a victim, to
+   * reuse it for another page.
+   *
+   * @param frameNo   Frame taken over
+   */
+  virtual void taken(FrameId frameNo) = 0;
+
+  /**
+   * Offer frames, best victim first, to take until it accepts one.
+   *
+   * @param take      Takes over a frame if it can be reused
+   * @param frameNo   Set to the frame taken
+   * @return  False if no frame could be taken
+   */
+  virtual bool pickVictim(const TakeFrame& take, FrameId& frameNo) = 0;
+
+  /**
+   * List the frames pickVictim() would offer next, best victim first,
+   * without changing any state. Frames holding no page are left out.
+   *
+   * @param count     Largest number of frames to list
+   * @param frames    Frames are appended to this
+   */
+  virtual void peekVictims(std::size_t count, std::vector<FrameId>& frames) = 0;
+
+  /**
+   * The buffer pool was resized. Frames are added or removed at the end;
+   * removed frames were freed first. No other call is made meanwhile.
+   *
+   * @param numFrames New number of frames in the buffer pool
+   */
+  virtual void resize(std::uint32_t numFrames) = 0;
+
+  /**
+   * Create a policy.
+   *
+   * @param kind      Policy to create
+   * @param numFrames Number of frames in the buffer pool
+   * @param descs     Descriptors of the frames
+   * @return  The policy; the caller deletes it
+   */
+  static ReplacementPolicy* create(Replacement kind, std::uint32_t numFrames,
+                                   BufDesc* descs);
+
+ protected:
+  /**
+   * Key identifying a page among those of every file.
+   */
+  static std::uint64_t pageKey(const File* file, PageId pageNo) {
+    return ((std::uint64_t)file->id() << 32) | pageNo;
+  }
+};
+
+/**
+ * @brief CLOCK replacement. The reference bit of each frame lives in its
+ * BufDesc; a hit sets it and the sweep clears it, giving the page a second
+ * chance. Nothing is latched, so threads sweep concurrently.
+ */
+class ClockPolicy : public ReplacementPolicy {
+ private:
+  /**
+   * Current position of clockhand in our buffer pool. It only ever moves
+   * forward; the frame is this modulo numFrames.
+   */
+  std::atomic<std::uint32_t> clockHand;
+
+  /**
+   * Number of frames in the buffer pool.
+   */
+  std::uint32_t numFrames;
+
+  /**
+   * Descriptors of the frames.
+   */
+  BufDesc* descs;
+
+  /**
+   * Advance clock to next frame in the buffer pool.
+   *
+   * @return  Frame the clock now points at
+   */
+  FrameId advanceClock() {
+    return (clockHand.fetch_add(1) + 1) % numFrames;
+  }
+
+ public:
+  /**
+   * Constructor of ClockPolicy class.
+   *
+   * @param numFrames Number of frames in the buffer pool
+   * @param descs     Descriptors of the frames
+   */
+  ClockPolicy(std::uint32_t numFrames, BufDesc* descs);
+
+  void loaded(FrameId frameNo, const File* file, PageId pageNo, bool cold);
+  void accessed(FrameId frameNo);
+  void freed(FrameId frameNo);
+  void taken(FrameId frameNo);
+  bool pickVictim(const TakeFrame& take, FrameId& frameNo);
+  void peekVictims(std::size_t count, std::vector<FrameId>& frames);
+  void resize(std::uint32_t numFrames);
+};
+
+/**
+ * @brief Base of the policies that order frames in lists. Those lists are
+ * guarded by one latch, and free frames are handed out before any page is
+ * evicted. Subclasses keep track of the resident pages.
+ */
+class ListPolicy : public ReplacementPolicy {
+ protected:
+  /**
+   * Latch guarding the policy's state.
+   */
+  std::mutex latch;
+
+  /**
+   * Number of frames in the buffer pool.
+   */
+  std::uint32_t numFrames;
+
+  /**
+   * Frames holding no page.
+   */
+  std::vector<FrameId> freeFrames;
+
+  /**
+   * Key of the page in each frame.
+   */
+  std::vector<std::uint64_t> frameKey;
+
+  /**
+   * True for frames whose page the subclass is keeping track of.
+   */
+  std::vector<bool> resident;
+
+  /**
+   * Start keeping track of the page just loaded into a frame.
+   *
+   * @param frameNo   Frame of the page; frameKey holds its key
+   * @param cold      True if the page should be among the first victims
+   */
+  virtual void loadResident(FrameId frameNo, bool cold) = 0;
+
+  /**
+   * Note an access to a resident page.
+   *
+   * @param frameNo   Frame of the page
+   */
+  virtual void accessResident(FrameId frameNo) = 0;
+
+  /**
+   * Stop keeping track of a resident page, without remembering it.
+   *
+   * @param frameNo   Frame of the page
+   */
+  virtual void removeResident(FrameId frameNo) = 0;
+
+  /**
+   * Offer resident pages, best victim first, to take until it accepts one,
+   * and stop keeping track of that one.
+   *
+   * @param take      Takes over a frame if it can be reused
+   * @param frameNo   Set to the frame taken
+   * @return  False if no frame could be taken
+   */
+  virtual bool evictResident(const TakeFrame& take, FrameId& frameNo) = 0;
+
+  /**
+   * List resident pages in the order evictResident() would offer them.
+   *
+   * @param count     Largest number of frames to list
+   * @param frames    Frames are appended to this
+   */
+  virtual void peekResident(std::size_t count,
+                            std::vector<FrameId>& frames) = 0;
+
+  /**
+   * Resize the per-frame state of the policy to numFrames, which has been
+   * set already.
+   */
+  virtual void resizeResident() = 0;
+
+ public:
+  /**
+   * Constructor of ListPolicy class. Every frame starts free.
+   *
+   * @param numFrames Number of frames in the buffer pool
+   */
+  explicit ListPolicy(std::uint32_t numFrames);
+
+  void loaded(FrameId frameNo, const File* file, PageId pageNo, bool cold);
+  void accessed(FrameId frameNo);
+  void freed(FrameId frameNo);
+  void taken(FrameId frameNo);
+  bool pickVictim(const TakeFrame& take, FrameId& frameNo);
+  void peekVictims(std::size_t count, std::vector<FrameId>& frames);
+  void resize(std::uint32_t numFrames);
+};
+
+/**
+ * @brief LRU-2 replacement. The victim is the page whose second most recent
+ * access is oldest; pages accessed only once go first, oldest first. The
+ * last two access times of evicted pages are remembered for as many pages as
+ * there are frames, so a page that comes back soon keeps its history.
+ */
+class Lru2Policy : public ListPolicy {
+ private:
+  /**
+   * Last two access times of a page, older first; 0 if none.
+   */
+  typedef std::pair<std::uint64_t, std::uint64_t> History;
+
+  /**
+   * Logical clock, advanced on every access.
+   */
+  std::uint64_t now;
+
+  /**
+   * History of the page in each frame.
+   */
+  std::vector<History> frameHistory;
+
+  /**
+   * Resident frames ordered by history, best victim first.
+   */
+  std::set<std::pair<History, FrameId> > order;
+
+  /**
+   * History of recently evicted pages, by page key.
+   */
+  std::unordered_map<std::uint64_t, History> evicted;
+
+  /**
+   * Keys of evicted pages with their last access time, oldest first, to
+   * forget them in order.
+   */
+  std::list<std::pair<std::uint64_t, std::uint64_t> > evictedOrder;
+
+ protected:
+  void loadResident(FrameId frameNo, bool cold);
+  void accessResident(FrameId frameNo);
+  void removeResident(FrameId frameNo);
+  bool evictResident(const TakeFrame& take, FrameId& frameNo);
+  void peekResident(std::size_t count, std::vector<FrameId>& frames);
+  void resizeResident();
+
+ public:
+  /**
+   * Constructor of Lru2Policy class.
+   *
+   * @param numFrames Number of frames in the buffer pool
+   */
+  explicit Lru2Policy(std::uint32_t numFrames);
+};
+
+/**
+ * @brief 2Q replacement. A page loaded for the first time enters the FIFO
+ * queue A1in, sized to a quarter of the frames; accesses there do not count.
+ * When it is evicted from A1in, its key is remembered in A1out for half as
+ * many pages as there are frames. A page loaded while in A1out enters the
+ * main LRU queue Am. A single scan thus only ever cycles through A1in.
+ */
+class TwoQPolicy : public ListPolicy {
+ private:
+  /**
+   * Target size of A1in.
+   */
+  std::size_t maxIn;
+
+  /**
+   * Size of A1out.
+   */
+  std::size_t maxOut;
+
+  /**
+   * Frames of pages seen once, newest first.
+   */
+  std::list<FrameId> a1in;
+
+  /**
+   * Frames of hot pages, most recently used first.
+   */
+  std::list<FrameId> am;
+
+  /**
+   * Position of each resident frame in a1in or am.
+   */
+  std::vector<std::list<FrameId>::iterator> position;
+
+  /**
+   * True for frames in am, false for frames in a1in.
+   */
+  std::vector<bool> inAm;
+
+  /**
+   * Keys of pages recently evicted from A1in, newest first.
+   */
+  std::list<std::uint64_t> a1out;
+
+  /**
+   * Position of each key in a1out.
+   */
+  std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator>
+      a1outPosition;
+
+  /**
+   * Offer the frames of a queue, oldest first, to take.
+   */
+  bool evictFrom(std::list<FrameId>& queue, const TakeFrame& take,
+                 FrameId& frameNo);
+
+ protected:
+  void loadResident(FrameId frameNo, bool cold);
+  void accessResident(FrameId frameNo);
+  void removeResident(FrameId frameNo);
+  bool evictResident(const TakeFrame& take, FrameId& frameNo);
+  void peekResident(std::size_t count, std::vector<FrameId>& frames);
+  void resizeResident();
+
+ public:
+  /**
+   * Constructor of TwoQPolicy class.
+   *
+   * @param numFrames Number of frames in the buffer pool
+   */
+  explicit TwoQPolicy(std::uint32_t numFrames);
+};
+
+/**
+ * @brief ARC replacement. T1 holds pages accessed once recently and T2 pages
+ * accessed at least twice, each in LRU order. B1 and B2 remember the keys of
+ * pages evicted from T1 and T2. A miss on a page in B1 grows the target size
+ * of T1, a miss on a page in B2 shrinks it, and victims come from T1 while it
+ * is larger than its target.
+ */
+class ArcPolicy : public ListPolicy {
+ private:
+  /**
+   * Target size of T1.
+   */
+  std::size_t target;
+
+  /**
+   * Frames in T1 and T2, most recently used first.
+   */
+  std::list<FrameId> t1, t2;
+
+  /**
+   * Position of each resident frame in t1 or t2.
+   */
+  std::vector<std::list<FrameId>::iterator> position;
+
+  /**
+   * True for frames in t2, false for frames in t1.
+   */
+  std::vector<bool> inT2;
+
+  /**
+   * Keys of pages evicted from T1 and T2, newest first.
+   */
+  std::list<std::uint64_t> b1, b2;
+
+  /**
+   * Position of each key in b1 or b2, and true if it is in b2.
+   */
+  std::unordered_map<std::uint64_t,
+                     std::pair<std::list<std::uint64_t>::iterator, bool> >
+      ghostPosition;
+
+  /**
+   * Offer the frames of a list, least recently used first, to take, and
+   * remember the key of the page taken in ghosts.
+   */
+  bool evictFrom(std::list<FrameId>& list, std::list<std::uint64_t>& ghosts,
+                 const TakeFrame& take, FrameId& frameNo);
+
+  /**
+   * Forget the oldest ghosts so that T1 and B1 hold at most as many pages as
+   * there are frames, and all four lists at most twice as many.
+   */
+  void trimGhosts();
+
+ protected:
+  void loadResident(FrameId frameNo, bool cold);
+  void accessResident(FrameId frameNo);
+  void removeResident(FrameId frameNo);
+  bool evictResident(const TakeFrame& take, FrameId& frameNo);
+  void peekResident(std::size_t count, std::vector<FrameId>& frames);
+  void resizeResident();
+
+ public:
+  /**
+   * Constructor of ArcPolicy class.
+   *
+   * @param numFrames Number of frames in the buffer pool
+   */
+  explicit ArcPolicy(std::uint32_t numFrames);
+};
+
+}